@@ -0,0 +1,256 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Microbenchmarks of the
+ *               packet codec, time reads and offset aggregation.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// Qt includes
+
+#include <QList>
+#include <QThread>
+#include <QtTest>
+
+// Local includes
+
+#include "ntpaggregator.h"
+#include "ntppackage.h"
+#include "ntptimestamp.h"
+
+#define BENCH_THREAD_READS          100000
+
+using namespace QtSampleCodes;
+
+/**
+ * Read the network time in a loop, as a busy consumer thread.
+ */
+class NTPBenchReader : public QThread
+{
+
+public:
+
+    explicit NTPBenchReader()
+        : m_sum(0)
+    {
+    }
+
+    qint64 sum() const
+    {
+        return m_sum;
+    }
+
+protected:
+
+    void run() Q_DECL_OVERRIDE
+    {
+        NTPTimeStamp* const timestamp = NTPTimeStamp::instance();
+        qint64              sum       = 0;
+
+        for (int i = 0 ; i < BENCH_THREAD_READS ; ++i)
+        {
+            sum += timestamp->currentMSTimestamp();
+        }
+
+        // Keep the reads from being optimized out.
+
+        m_sum = sum;
+    }
+
+private:
+
+    qint64 m_sum;
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Run with the QTest options for machine-readable results, as "bench_ntpclient -csv"
+ * or "bench_ntpclient -o results.xml,xml", and -callgrind or -perf for other counters.
+ */
+class NTPClientBench : public QObject
+{
+    Q_OBJECT
+
+private:
+
+    /**
+     * A server response to request, with all timestamps set to its transmit timestamp.
+     */
+    QByteArray response(const QByteArray& request) const
+    {
+        QByteArray bytes = request;
+
+        bytes[0]         = char((0 << 6) | (3 << 3) | 4);
+        bytes[1]         = char(2);
+        bytes.replace(24, 8, request.mid(40, 8));
+        bytes.replace(32, 8, request.mid(40, 8));
+
+        return bytes;
+    }
+
+private Q_SLOTS:
+
+    void initTestCase()
+    {
+        // Create the instance before the reader threads.
+
+        NTPTimeStamp::instance();
+    }
+
+    void benchToByteArray()
+    {
+        NTPPackage package;
+        QByteArray bytes;
+
+        QBENCHMARK
+        {
+            bytes = package.toByteArray();
+        }
+
+        QCOMPARE(bytes.size(), 48);
+    }
+
+    void benchParseByByteArray()
+    {
+        NTPPackage request;
+        NTPPackage package;
+        QByteArray bytes = response(request.toByteArray());
+
+        QBENCHMARK
+        {
+            package.parseByByteArray(bytes);
+        }
+
+        QCOMPARE(int(package.m_mode), 4);
+    }
+
+    void benchCalcOffset()
+    {
+        NTPPackage request;
+        NTPPackage package;
+        qint64     offset = 0;
+
+        package.parseByByteArray(response(request.toByteArray()));
+
+        QBENCHMARK
+        {
+            offset += package.calcOffset();
+        }
+
+        Q_UNUSED(offset);
+    }
+
+    void benchCurrentMSTimestamp()
+    {
+        NTPTimeStamp* const timestamp = NTPTimeStamp::instance();
+        qint64              current   = 0;
+
+        QBENCHMARK
+        {
+            current = timestamp->currentMSTimestamp();
+        }
+
+        QVERIFY(current > 0);
+    }
+
+    void benchCurrentMSTimestampThreads_data()
+    {
+        QTest::addColumn<int>("threads");
+
+        QTest::newRow("2")  << 2;
+        QTest::newRow("4")  << 4;
+        QTest::newRow("8")  << 8;
+    }
+
+    /**
+     * One iteration is BENCH_THREAD_READS reads by each thread, all threads at the same time.
+     */
+    void benchCurrentMSTimestampThreads()
+    {
+        QFETCH(int, threads);
+
+        qint64 sum = 0;
+
+        QBENCHMARK
+        {
+            QList<NTPBenchReader*> readers;
+
+            for (int i = 0 ; i < threads ; ++i)
+            {
+                readers << new NTPBenchReader();
+                readers.last()->start();
+            }
+
+            foreach (NTPBenchReader* const reader, readers)
+            {
+                reader->wait();
+                sum += reader->sum();
+            }
+
+            qDeleteAll(readers);
+        }
+
+        QVERIFY(sum != 0);
+    }
+
+    void benchAggregation_data()
+    {
+        QTest::addColumn<QString>("aggregator");
+        QTest::addColumn<int>("sources");
+
+        foreach (const QString& name, NTPAggregator::names())
+        {
+            foreach (int sources, QList<int>() << 1 << 10 << 100 << 1000)
+            {
+                QTest::newRow(qPrintable(QString::fromLatin1("%1/%2").arg(name).arg(sources))) << name << sources;
+            }
+        }
+    }
+
+    /**
+     * One iteration is the work of NTPTimeStamp for each answer: store the server offset, and combine all offsets.
+     */
+    void benchAggregation()
+    {
+        QFETCH(QString, aggregator);
+        QFETCH(int,     sources);
+
+        QScopedPointer<NTPAggregator> algorithm(NTPAggregator::create(aggregator));
+        QVERIFY(!algorithm.isNull());
+
+        for (int i = 0 ; i < sources ; ++i)
+        {
+            algorithm->addSample(i, (i % 7 - 3) * 1000000LL);
+        }
+
+        int    source = 0;
+        qint64 offset = 0;
+
+        QBENCHMARK
+        {
+            algorithm->addSample(source, (source % 7 - 3) * 1000000LL);
+            offset += algorithm->offset();
+            source  = (source + 1) % sources;
+        }
+
+        Q_UNUSED(offset);
+    }
+};
+
+QTEST_GUILESS_MAIN(NTPClientBench)
+
+#include "bench_ntpclient.moc"
@@ -0,0 +1,131 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Combine offsets from several servers
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpaggregator.h"
+
+// Local includes
+
+#include "ntpcore.h"
+
+namespace QtSampleCodes
+{
+
+NTPAggregator::~NTPAggregator()
+{
+}
+
+NTPAggregator* NTPAggregator::create(const QString& name)
+{
+    if (name == QLatin1String("trimmed-mean"))
+    {
+        return new NTPTrimmedMeanAggregator();
+    }
+
+    if (name == QLatin1String("median"))
+    {
+        return new NTPMedianAggregator();
+    }
+
+    return nullptr;
+}
+
+QStringList NTPAggregator::names()
+{
+    return (QStringList() << QLatin1String("trimmed-mean")
+                          << QLatin1String("median"));
+}
+
+// ---------------------------------------------------------------------
+
+NTPTrimmedMeanAggregator::NTPTrimmedMeanAggregator()
+{
+}
+
+NTPTrimmedMeanAggregator::~NTPTrimmedMeanAggregator()
+{
+}
+
+QString NTPTrimmedMeanAggregator::name() const
+{
+    return QLatin1String("trimmed-mean");
+}
+
+void NTPTrimmedMeanAggregator::reset()
+{
+    m_offsets.clear();
+}
+
+void NTPTrimmedMeanAggregator::addSample(int source, qint64 offsetNs)
+{
+    m_offsets[source] = offsetNs;
+}
+
+qint64 NTPTrimmedMeanAggregator::offset() const
+{
+    m_values.resize(0);
+
+    for (QHash<int, qint64>::const_iterator it = m_offsets.constBegin() ; it != m_offsets.constEnd() ; ++it)
+    {
+        m_values.append(it.value());
+    }
+
+    // Remove the maximum value and remove the minimum value before taking the average. If 10 are full, there are 8 left.
+
+    return ntpCoreTrimmedMean(m_values.data(), size_t(m_values.size()));
+}
+
+// ---------------------------------------------------------------------
+
+NTPMedianAggregator::NTPMedianAggregator()
+{
+}
+
+NTPMedianAggregator::~NTPMedianAggregator()
+{
+}
+
+QString NTPMedianAggregator::name() const
+{
+    return QLatin1String("median");
+}
+
+void NTPMedianAggregator::reset()
+{
+    m_offsets.clear();
+}
+
+void NTPMedianAggregator::addSample(int source, qint64 offsetNs)
+{
+    m_offsets[source] = offsetNs;
+}
+
+qint64 NTPMedianAggregator::offset() const
+{
+    m_sorted.resize(0);
+
+    for (QHash<int, qint64>::const_iterator it = m_offsets.constBegin() ; it != m_offsets.constEnd() ; ++it)
+    {
+        m_sorted.append(it.value());
+    }
+
+    return ntpCoreMedian(m_sorted.data(), size_t(m_sorted.size()));
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,125 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Combine offsets from several servers
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_AGGREGATOR_H
+#define NTP_AGGREGATOR_H
+
+// C++ includes
+
+#include <cstdint>
+
+// Qt includes
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace QtSampleCodes
+{
+
+/**
+ * Algorithm combining the last offset of each server into one network offset.
+ * Used by NTPTimeStamp, and by the replay tool to compare algorithms on recorded traces.
+ */
+class NTPAggregator
+{
+
+public:
+
+    virtual ~NTPAggregator();
+
+    virtual QString name()                          const = 0;
+
+    /**
+     * Forget all samples, when a new synchronization round starts.
+     */
+    virtual void    reset()                               = 0;
+
+    /**
+     * Store the last offset measured with server source, in nano-seconds.
+     */
+    virtual void    addSample(int source, qint64 offsetNs) = 0;
+
+    /**
+     * Combined offset in nano-seconds, 0 without sample.
+     */
+    virtual qint64  offset()                        const = 0;
+
+public:
+
+    /**
+     * Create an aggregator by name, nullptr if name is unknown.
+     */
+    static NTPAggregator* create(const QString& name);
+    static QStringList    names();
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Average of offsets, without the min and max values if there are more than two servers.
+ */
+class NTPTrimmedMeanAggregator : public NTPAggregator
+{
+
+public:
+
+    explicit NTPTrimmedMeanAggregator();
+    ~NTPTrimmedMeanAggregator();
+
+    QString name()                           const Q_DECL_OVERRIDE;
+    void    reset()                                Q_DECL_OVERRIDE;
+    void    addSample(int source, qint64 offsetNs) Q_DECL_OVERRIDE;
+    qint64  offset()                         const Q_DECL_OVERRIDE;
+
+private:
+
+    QHash<int, qint64>       m_offsets;
+    mutable QVector<int64_t> m_values;
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Median of offsets, robust to a minority of false tickers.
+ */
+class NTPMedianAggregator : public NTPAggregator
+{
+
+public:
+
+    explicit NTPMedianAggregator();
+    ~NTPMedianAggregator();
+
+    QString name()                           const Q_DECL_OVERRIDE;
+    void    reset()                                Q_DECL_OVERRIDE;
+    void    addSample(int source, qint64 offsetNs) Q_DECL_OVERRIDE;
+    qint64  offset()                         const Q_DECL_OVERRIDE;
+
+private:
+
+    QHash<int, qint64>       m_offsets;
+    mutable QVector<int64_t> m_sorted;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_AGGREGATOR_H
@@ -0,0 +1,386 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - High rate request generator
+ *               measuring request/response latency of a Ntp server.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostInfo>
+#include <QThread>
+#include <QUdpSocket>
+#include <QtEndian>
+
+// Local includes
+
+#include "ntppackage.h"
+#include "ntphistogram.h"
+
+#define MS_JAN_1970                 0x20251FE2400L
+
+using namespace QtSampleCodes;
+
+/**
+ * Client settings shared by all generator threads.
+ */
+struct NTPBenchSettings
+{
+    QHostAddress address;
+    quint16      port;
+    double       rate;              ///< Total requests per second, for all threads.
+    qint64       durationMs;
+    qint64       drainMs;           ///< Time to wait for late replies after the last request.
+    int          threads;
+    int          sockets;           ///< Source ports used by each thread.
+};
+
+/**
+ * Open-loop request generator. Requests are sent at a fixed pace even if replies are late,
+ * to not hide server latency behind the generator (coordinated omission).
+ */
+class NTPBenchWorker : public QThread
+{
+public:
+
+    explicit NTPBenchWorker(const NTPBenchSettings& settings, int index)
+        : QThread(nullptr),
+          m_sent(0),
+          m_received(0),
+          m_unmatched(0),
+          m_lost(0),
+          m_elapsedNs(0),
+          m_settings(settings),
+          m_index(index)
+    {
+    }
+
+    NTPHistogram m_latency;         ///< Request/response latency in nano-seconds.
+    quint64      m_sent;
+    quint64      m_received;
+    quint64      m_unmatched;       ///< Replies with an origin timestamp not sent by this thread, or duplicated.
+    quint64      m_lost;
+    qint64       m_elapsedNs;
+
+protected:
+
+    void run() Q_DECL_OVERRIDE
+    {
+        QVector<QUdpSocket*>              sockets;
+        QVector<QHash<quint64, qint64> >  pending(m_settings.sockets);
+
+        for (int i = 0 ; i < m_settings.sockets ; ++i)
+        {
+            QUdpSocket* const socket = new QUdpSocket;
+
+            if (!socket->bind((m_settings.address.protocol() == QAbstractSocket::IPv6Protocol) ? QHostAddress::AnyIPv6
+                                                                                               : QHostAddress::AnyIPv4, 0))
+            {
+                qWarning() << "NTPBenchWorker: cannot bind source port:" << socket->errorString();
+                delete socket;
+                continue;
+            }
+
+            sockets << socket;
+        }
+
+        if (sockets.isEmpty())
+        {
+            return;
+        }
+
+        const qint64 intervalNs = qint64(1.0e9 * m_settings.threads / m_settings.rate);
+        const qint64 durationNs = m_settings.durationMs * 1000000L;
+        const qint64 endNs      = durationNs + m_settings.drainMs * 1000000L;
+        quint16      sequence   = quint16(m_index << 12);
+        qint64       nextSendNs = intervalNs * m_index / m_settings.threads;  // Spread threads over the interval
+        int          next       = 0;
+        char         buffer[512];
+
+        QElapsedTimer timer;
+        timer.start();
+
+        forever
+        {
+            qint64 now  = timer.nsecsElapsed();
+            bool   busy = false;
+
+            if ((now >= endNs) || ((now >= durationNs) && (m_sent == m_received)))
+            {
+                break;
+            }
+
+            if ((now < durationNs) && (now >= nextSendNs))
+            {
+                NTPPackage pk;
+                QByteArray bytes = pk.toByteArray();
+
+                // The transmit timestamp only has a milli-second resolution: stamp a sequence in the
+                // lowest fraction bits (~15 micro-seconds) to keep the origin timestamp unique.
+
+                bytes[46]        = char(bytes[46] ^ (sequence >> 8));
+                bytes[47]        = char(bytes[47] ^ (sequence & 0xff));
+                sequence++;
+
+                const quint64 key = qFromBigEndian<quint64>(reinterpret_cast<const uchar*>(bytes.constData() + 40));
+
+                now               = timer.nsecsElapsed();
+
+                if (sockets[next]->writeDatagram(bytes, m_settings.address, m_settings.port) == 48)
+                {
+                    pending[next].insert(key, now);
+                    m_sent++;
+                }
+
+                next        = (next + 1) % sockets.size();
+                nextSendNs += intervalNs;
+                busy        = true;
+            }
+
+            for (int i = 0 ; i < sockets.size() ; ++i)
+            {
+                while (sockets[i]->hasPendingDatagrams())
+                {
+                    qint64 size = sockets[i]->readDatagram(buffer, sizeof(buffer));
+                    qint64 recv = timer.nsecsElapsed();
+                    busy        = true;
+
+                    if (size < 48)
+                    {
+                        m_unmatched++;
+                        continue;
+                    }
+
+                    // The server copies our transmit timestamp in the origin timestamp field.
+
+                    const quint64 key                      = qFromBigEndian<quint64>(reinterpret_cast<const uchar*>(buffer + 24));
+                    QHash<quint64, qint64>::iterator it    = pending[i].find(key);
+
+                    if (it == pending[i].end())
+                    {
+                        m_unmatched++;
+                        continue;
+                    }
+
+                    m_latency.record(recv - it.value());
+                    m_received++;
+                    pending[i].erase(it);
+                }
+            }
+
+            if (!busy && (nextSendNs - timer.nsecsElapsed() > 200000L))
+            {
+                QThread::usleep(50);
+            }
+        }
+
+        m_elapsedNs = qMin(timer.nsecsElapsed(), durationNs);
+
+        for (int i = 0 ; i < pending.size() ; ++i)
+        {
+            m_lost += pending[i].size();
+        }
+
+        qDeleteAll(sockets);
+    }
+
+private:
+
+    const NTPBenchSettings m_settings;
+    const int              m_index;
+};
+
+// ---------------------------------------------------------------------
+
+QByteArray s_currentNtpTimestampBytes()
+{
+    const qint64  ms     = MS_JAN_1970 + QDateTime::currentMSecsSinceEpoch();
+    const quint64 second = quint64(ms / 1000);
+    const quint64 frac   = quint64(ms % 1000) * (quint64(1) << 32) / 1000;
+
+    QByteArray result(8, 0);
+    qToBigEndian<quint32>(quint32(second), reinterpret_cast<uchar*>(result.data()));
+    qToBigEndian<quint32>(quint32(frac),   reinterpret_cast<uchar*>(result.data() + 4));
+
+    return result;
+}
+
+/**
+ * Minimal stratum 1 server answering with the local clock, to benchmark on a host without network.
+ */
+int s_serve(quint16 port)
+{
+    QUdpSocket socket;
+
+    if (!socket.bind(QHostAddress::Any, port))
+    {
+        qWarning() << "Cannot listen on port" << port << ":" << socket.errorString();
+
+        return -1;
+    }
+
+    qInfo() << "=== Answering Ntp requests on port" << port;
+
+    char         request[512];
+    QHostAddress sender;
+    quint16      senderPort = 0;
+
+    forever
+    {
+        if (!socket.waitForReadyRead(1000))
+        {
+            continue;
+        }
+
+        while (socket.hasPendingDatagrams())
+        {
+            qint64 size = socket.readDatagram(request, sizeof(request), &sender, &senderPort);
+
+            if (size < 48)
+            {
+                continue;
+            }
+
+            QByteArray received = s_currentNtpTimestampBytes();
+            QByteArray reply(48, 0);
+            reply[0]            = char((0 << 6) | (request[0] & 0x38) | 4);  // LI: no warning, client version, mode: server
+            reply[1]            = char(1);                                  // Stratum
+            reply[2]            = request[2];
+            reply[3]            = char(-20);
+            reply.replace(12, 4, "LOCL", 4);
+            reply.replace(16, 8, received);
+            reply.replace(24, 8, request + 40, 8);
+            reply.replace(32, 8, received);
+            reply.replace(40, 8, s_currentNtpTimestampBytes());
+
+            socket.writeDatagram(reply, sender, senderPort);
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("Ntp request/response load generator"));
+    parser.addHelpOption();
+
+    QCommandLineOption hostOpt(QLatin1String("host"),         QLatin1String("Ntp server host."),                           QLatin1String("host"),  QLatin1String("127.0.0.1"));
+    QCommandLineOption portOpt(QLatin1String("port"),         QLatin1String("Ntp server port."),                           QLatin1String("port"),  QLatin1String("123"));
+    QCommandLineOption rateOpt(QLatin1String("rate"),         QLatin1String("Requests per second, for all threads."),      QLatin1String("pps"),   QLatin1String("1000"));
+    QCommandLineOption timeOpt(QLatin1String("duration"),     QLatin1String("Sending duration in seconds."),               QLatin1String("s"),     QLatin1String("10"));
+    QCommandLineOption thrdOpt(QLatin1String("threads"),      QLatin1String("Number of sending threads."),                 QLatin1String("n"),     QLatin1String("1"));
+    QCommandLineOption sockOpt(QLatin1String("sockets"),      QLatin1String("Number of source ports per thread."),         QLatin1String("n"),     QLatin1String("4"));
+    QCommandLineOption drnOpt (QLatin1String("drain"),        QLatin1String("Time to wait for late replies, in ms."),      QLatin1String("ms"),    QLatin1String("1000"));
+    QCommandLineOption srvOpt (QLatin1String("serve"),        QLatin1String("Answer Ntp requests on --port instead of sending them."));
+
+    parser.addOption(hostOpt);
+    parser.addOption(portOpt);
+    parser.addOption(rateOpt);
+    parser.addOption(timeOpt);
+    parser.addOption(thrdOpt);
+    parser.addOption(sockOpt);
+    parser.addOption(drnOpt);
+    parser.addOption(srvOpt);
+    parser.process(app);
+
+    NTPBenchSettings settings;
+    settings.port       = quint16(parser.value(portOpt).toUInt());
+    settings.rate       = qMax(1.0, parser.value(rateOpt).toDouble());
+    settings.durationMs = qint64(parser.value(timeOpt).toDouble() * 1000.0);
+    settings.drainMs    = parser.value(drnOpt).toLongLong();
+    settings.threads    = qMax(1, parser.value(thrdOpt).toInt());
+    settings.sockets    = qMax(1, parser.value(sockOpt).toInt());
+
+    if (parser.isSet(srvOpt))
+    {
+        return s_serve(settings.port);
+    }
+
+    if (!settings.address.setAddress(parser.value(hostOpt)))
+    {
+        QHostInfo info = QHostInfo::fromName(parser.value(hostOpt));
+
+        if (info.addresses().isEmpty())
+        {
+            qWarning() << "Cannot resolve" << parser.value(hostOpt) << ":" << info.errorString();
+
+            return -1;
+        }
+
+        settings.address = info.addresses().first();
+    }
+
+    qInfo().noquote() << QString::fromLatin1("=== Sending %1 req/s to %2:%3 for %4 ms from %5 thread(s) x %6 port(s)")
+                         .arg(settings.rate).arg(settings.address.toString()).arg(settings.port)
+                         .arg(settings.durationMs).arg(settings.threads).arg(settings.sockets);
+
+    QList<NTPBenchWorker*> workers;
+
+    for (int i = 0 ; i < settings.threads ; ++i)
+    {
+        NTPBenchWorker* const worker = new NTPBenchWorker(settings, i);
+        workers << worker;
+        worker->start();
+    }
+
+    NTPHistogram latency;
+    quint64      sent      = 0;
+    quint64      received  = 0;
+    quint64      unmatched = 0;
+    quint64      lost      = 0;
+    qint64       elapsedNs = 0;
+
+    foreach (NTPBenchWorker* const worker, workers)
+    {
+        worker->wait();
+
+        latency.merge(worker->m_latency);
+        sent      += worker->m_sent;
+        received  += worker->m_received;
+        unmatched += worker->m_unmatched;
+        lost      += worker->m_lost;
+        elapsedNs  = qMax(elapsedNs, worker->m_elapsedNs);
+    }
+
+    qDeleteAll(workers);
+
+    const double seconds = qMax(1.0e-9, double(elapsedNs) / 1.0e9);
+
+    qInfo().noquote() << "=== Benchmark is complete!";
+    qInfo().noquote() << "> Requests sent            :" << sent      << QString::fromLatin1("(%1 req/s)").arg(double(sent)     / seconds, 0, 'f', 1);
+    qInfo().noquote() << "> Replies matched          :" << received  << QString::fromLatin1("(%1 rep/s)").arg(double(received) / seconds, 0, 'f', 1);
+    qInfo().noquote() << "> Replies unmatched        :" << unmatched;
+    qInfo().noquote() << "> Requests lost            :" << lost      << QString::fromLatin1("(%1 %)").arg((sent > 0) ? (100.0 * double(lost) / double(sent)) : 0.0, 0, 'f', 3);
+    qInfo().noquote() << "> Latency min        (us)  :" << double(latency.min())                    / 1000.0;
+    qInfo().noquote() << "> Latency mean       (us)  :" << latency.mean()                           / 1000.0;
+    qInfo().noquote() << "> Latency p50        (us)  :" << double(latency.valueAtPercentile(50.0))  / 1000.0;
+    qInfo().noquote() << "> Latency p99        (us)  :" << double(latency.valueAtPercentile(99.0))  / 1000.0;
+    qInfo().noquote() << "> Latency p99.9      (us)  :" << double(latency.valueAtPercentile(99.9))  / 1000.0;
+    qInfo().noquote() << "> Latency max        (us)  :" << double(latency.max())                    / 1000.0;
+
+    return ((received > 0) ? 0 : -1);
+}
@@ -0,0 +1,39 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Network time as
+ *               a std::chrono clock.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpchrono.h"
+
+namespace QtSampleCodes
+{
+
+// Zero initialized before any dynamic initialization: readable from static constructors.
+
+NTPClockState ntpClockState;
+
+constexpr bool ntp_clock::is_steady;
+
+void ntpClockPublish(int64_t offsetNs, bool synchronized)
+{
+    ntpClockState.offsetNs.store(synchronized ? offsetNs : 0, std::memory_order_relaxed);
+    ntpClockState.synchronized.store(synchronized, std::memory_order_release);
+}
+
+} // namespace QtSampleCodes
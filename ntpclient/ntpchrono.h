@@ -0,0 +1,105 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Network time as
+ *               a std::chrono clock.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_CHRONO_H
+#define NTP_CHRONO_H
+
+// C++ includes
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace QtSampleCodes
+{
+
+/**
+ * Offset of the network time to the system clock, published by NTPTimeStamp and NTPCoreSync
+ * each time they compute a new one: whichever synchronizes the process. 0 when not synchronized.
+ */
+struct NTPClockState
+{
+    std::atomic<int64_t> offsetNs;
+    std::atomic<bool>    synchronized;
+};
+
+extern NTPClockState ntpClockState;
+
+void ntpClockPublish(int64_t offsetNs, bool synchronized);
+
+// ---------------------------------------------------------------------
+
+/**
+ * Network time as a TrivialClock: system clock corrected with the published offset, in
+ * nano-seconds since Epoch. now() is inline, one relaxed atomic load over system_clock::now(),
+ * so templated code parameterized on the clock type gets corrected time without indirection.
+ *
+ * Not steady: the time jumps when a new offset is published. It follows the system clock,
+ * not NTPClock: the virtual clock of simulations is not seen here.
+ */
+struct ntp_clock
+{
+    typedef std::chrono::nanoseconds                duration;
+    typedef duration::rep                           rep;
+    typedef duration::period                        period;
+    typedef std::chrono::time_point<ntp_clock>      time_point;
+
+    static constexpr bool is_steady = false;
+
+    static time_point now() noexcept
+    {
+        return time_point(std::chrono::duration_cast<duration>(std::chrono::system_clock::now().time_since_epoch()) +
+                          duration(ntpClockState.offsetNs.load(std::memory_order_relaxed)));
+    }
+
+    static bool synchronized() noexcept
+    {
+        return ntpClockState.synchronized.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Conversions with system clock time points and time_t, for formatting.
+     */
+    static std::chrono::system_clock::time_point to_sys(const time_point& t) noexcept
+    {
+        return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(t.time_since_epoch()));
+    }
+
+    static time_point from_sys(const std::chrono::system_clock::time_point& t) noexcept
+    {
+        return time_point(std::chrono::duration_cast<duration>(t.time_since_epoch()));
+    }
+
+    static std::time_t to_time_t(const time_point& t) noexcept
+    {
+        return std::chrono::system_clock::to_time_t(to_sys(t));
+    }
+
+    static time_point from_time_t(std::time_t t) noexcept
+    {
+        return from_sys(std::chrono::system_clock::from_time_t(t));
+    }
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_CHRONO_H
@@ -20,41 +20,27 @@
 
 #include "ntpclient.h"
 
-// Qt includes
-
-#include <QDateTime>
-#include <QTimer>
-
 // Local includes
 
+#include "ntpclock.h"
 #include "ntppackage.h"
+#include "ntptrace.h"
+#include "ntptransport.h"
 
 namespace QtSampleCodes
 {
 
-const qint32 s_delayResendIntervals[UDP_RESEND_INTERVAL_COUNT] =
-{
-    2000,
-    5000,
-    10000,
-    15000,
-    20000,
-    30000
-};
-
-// ----------------------------------------------------------------------
-
 NTPClient::NTPClient(const QString& host, quint16 port)
     : QObject(nullptr),
       m_ntpServerHost(host),
       m_ntpServerPort(port),
-      m_done(false),
-      m_originTimestampByte(),
-      m_offset(0),
-      m_failedTimes(0),
-      m_udpsocket(nullptr),
+      m_exchange(),
+      m_transport(nullptr),
+      m_ring(),
       m_socketTimerID(0),
-      m_delayResnedTimerID(0)
+      m_delayResnedTimerID(0),
+      m_discarded(0),
+      m_trace(nullptr)
 {
     connect(this, SIGNAL(signalNtpStart()),
             this, SLOT(slotNTPStart()));
@@ -70,97 +56,103 @@ void NTPClient::start()
     emit signalNtpStart();
 }
 
+void NTPClient::stop()
+{
+    cancel();
+}
+
+void NTPClient::setTimeoutBounds(qint64 floorMs, qint64 ceilingMs)
+{
+    m_exchange.setTimeoutBounds(floorMs, ceilingMs);
+}
+
 bool NTPClient::done() const
 {
-    return m_done;
+    return m_exchange.done();
 }
 
 qint64 NTPClient::offset() const
 {
-    return m_offset;
+    return (offsetNs() / 1000000LL);
 }
 
-void NTPClient::initSocket()
+qint64 NTPClient::offsetNs() const
 {
-    m_udpsocket = new QUdpSocket(this);
+    return (m_exchange.done() ? m_exchange.offsetNs() : 0);
+}
 
-    connect(m_udpsocket, SIGNAL(connected()),
-            this, SLOT(slotNtpConnected()));
+qint64 NTPClient::delayNs() const
+{
+    return (m_exchange.done() ? m_exchange.delayNs() : 0);
+}
 
-    connect(m_udpsocket, SIGNAL(error(QAbstractSocket::SocketError)),
-            this, SLOT(slotNtpError(QAbstractSocket::SocketError)));
+int NTPClient::stratum() const
+{
+    return m_exchange.stratum();
+}
 
-    connect(m_udpsocket, SLOT(readyRead()),
-            this, SLOT(slotNtpReadyRead()));
+quint32 NTPClient::discarded() const
+{
+    return m_discarded;
 }
 
-QByteArray NTPClient::readSocket()
+QString NTPClient::host() const
 {
-    QByteArray data;
+    return m_ntpServerHost;
+}
 
-    if (!m_udpsocket)
-    {
-        return data;
-    }
+void NTPClient::setTraceWriter(NTPTraceWriter* const trace)
+{
+    m_trace = trace;
+}
 
-    while (m_udpsocket->hasPendingDatagrams())
-    {
-        data.clear();
-        data.resize(int(m_udpsocket->pendingDatagramSize()));
-        m_udpsocket->readDatagram(data.data(), data.size());
-    }
+void NTPClient::initSocket()
+{
+    m_transport = NTPNetwork::instance()->createTransport(this);
+
+    connect(m_transport, SIGNAL(signalConnected()),
+            this, SLOT(slotNtpConnected()));
+
+    connect(m_transport, SIGNAL(signalError(QAbstractSocket::SocketError)),
+            this, SLOT(slotNtpError(QAbstractSocket::SocketError)));
 
-    return data;
+    connect(m_transport, SIGNAL(signalReadyRead()),
+            this, SLOT(slotNtpReadyRead()));
 }
 
 void NTPClient::releaseSocket()
 {
-    if (m_udpsocket)
+    if (m_transport)
     {
-        m_udpsocket->disconnectFromHost();
-        m_udpsocket->close();
-        m_udpsocket->deleteLater();
-        m_udpsocket = nullptr;
+        m_transport->close();
+        m_transport->deleteLater();
+        m_transport = nullptr;
     }
 
+    m_ring.clear();
+
     if (m_socketTimerID != 0)
     {
-        killTimer(m_socketTimerID);
+        NTPClock::instance()->killTimer(m_socketTimerID);
         m_socketTimerID = 0;
     }
 
     if (m_delayResnedTimerID != 0)
     {
-        killTimer(m_delayResnedTimerID);
+        NTPClock::instance()->killTimer(m_delayResnedTimerID);
         m_delayResnedTimerID = 0;
     }
 }
 
-NTPPackage NTPClient::generateRequestPackage()
-{
-    NTPPackage pk;
-
-    return pk;
-}
-
-NTPPackage NTPClient::generateResponsePackageFromByte(const QByteArray& bytes)
-{
-    NTPPackage pk;
-    pk.parseByByteArray(bytes);
-
-    return pk;
-}
-
 void NTPClient::slotNTPStart()
 {
     cancel();
     initSocket();
 
-    m_done          = false;
-    m_offset        = 0;
-    m_udpsocket->connectToHost(m_ntpServerHost, m_ntpServerPort);
+    m_exchange.start();
+    m_transport->connectToHost(m_ntpServerHost, m_ntpServerPort);
 
-    m_socketTimerID = startTimer(UDP_TIMEOUT);
+    m_socketTimerID = NTPClock::instance()->startTimer(UDP_TIMEOUT, [this]() { socketTimeout(); });
 }
 
 void NTPClient::cancel()
@@ -168,108 +160,110 @@ void NTPClient::cancel()
     releaseSocket();
 }
 
-void NTPClient::delayResend()
+void NTPClient::delayResend(qint64 ms)
 {
-    m_delayResnedTimerID = startTimer(s_delayResendIntervals[qBound(1, m_failedTimes, UDP_RESEND_INTERVAL_COUNT) - 1]);
+    m_delayResnedTimerID = NTPClock::instance()->startTimer(ms, [this]() { delayResendTimeout(); });
 }
 
-void NTPClient::timerEvent(QTimerEvent* event)
+void NTPClient::socketTimeout()
 {
-    if ((m_delayResnedTimerID == 0) && (m_socketTimerID == 0))
-    {
-        return QObject::timerEvent(event);
-    }
+    qDebug() << "NTPClient::timerEvent timeout:" << NTPClock::instance()->currentMSecsSinceEpoch() << ", for:" << m_ntpServerHost;
 
-    if      (event->timerId() == m_socketTimerID)
-    {
-        qDebug() << "NTPClient::timerEvent timeout:" << QDateTime::currentMSecsSinceEpoch() << ", for:" << m_ntpServerHost;
-
-        killTimer(m_socketTimerID);
-        m_socketTimerID = 0;
-        slotNtpError(QAbstractSocket::TemporaryError);
-    }
-    else if (event->timerId() == m_delayResnedTimerID)
-    {
-        qDebug() << "NTPClient::timerEvent delay resend:" << QDateTime::currentMSecsSinceEpoch();
+    m_socketTimerID = 0;
+    slotNtpError(QAbstractSocket::TemporaryError);
+}
 
-        killTimer(m_delayResnedTimerID);
-        m_delayResnedTimerID = 0;
-        start();
-    }
-    else
-    {
-        return QObject::timerEvent(event);
-    }
+void NTPClient::delayResendTimeout()
+{
+    qDebug() << "NTPClient::timerEvent delay resend:" << NTPClock::instance()->currentMSecsSinceEpoch();
 
-    return;
+    m_delayResnedTimerID = 0;
+    start();
 }
 
 void NTPClient::slotNtpConnected()
 {
-    NTPPackage requestPackage = generateRequestPackage();
-    QByteArray bytesToSend    = requestPackage.toByteArray();
+    // The exchange keeps the origin timestamp of the sent packet, used to verify the received packet.
+    // The transport can race several server addresses: a request is sent on each one.
+
+    uchar request[NTP_CORE_PACKET_SIZE];
+    const size_t size = m_exchange.request(request, NTPClock::instance()->currentNSecsSinceEpoch());
+
+    m_transport->write(QByteArray(reinterpret_cast<const char*>(request), int(size)));
 
-    // Save the timestamp byte of the sent packet, used to verify the received packet
+    // Host lookup and connection are bounded by UDP_TIMEOUT, the response by the adaptive timeout.
 
-    m_originTimestampByte      = requestPackage.m_requestLocalTimestampByte;
+    if (m_socketTimerID != 0)
+    {
+        NTPClock::instance()->killTimer(m_socketTimerID);
+    }
 
-    m_udpsocket->flush();
-    m_udpsocket->write(bytesToSend, 48);
-    m_udpsocket->flush();
+    m_socketTimerID = NTPClock::instance()->startTimer(m_exchange.timeout(), [this]() { socketTimeout(); });
 }
 
 void NTPClient::slotNtpError(QAbstractSocket::SocketError error)
 {
-    m_failedTimes++;
-    m_offset = 0;
-    m_done   = false;
+    const qint64 delay = m_exchange.fail();
     releaseSocket();
 
-    qDebug() << "NTPClient::onNtpError: " << error << ", failed times:" << m_failedTimes;
+    qDebug() << "NTPClient::onNtpError: " << error << ", failed times:" << m_exchange.failures();
 
-    delayResend();
+    delayResend(delay);
+
+    emit signalNtpFailed();
 }
 
 void NTPClient::slotNtpReadyRead()
 {
-    QByteArray data = readSocket();
+    // Drain all pending datagrams by batches of ring slots: a valid response is not lost
+    // behind stale or duplicate ones received in the same burst.
 
-    if (m_socketTimerID != 0)
+    while (m_transport && (m_ring.fill(m_transport) > 0))
     {
-        killTimer(m_socketTimerID);
-        m_socketTimerID = 0;
-    }
+        while (!m_ring.isEmpty())
+        {
+            const NTPReceiveSlot& slot = m_ring.front();
 
-    if (data.size() != 48)
-    {
-        qDebug() << "NTPClient::failed, content error";
-        slotNtpError(QAbstractSocket::TemporaryError);
+            // Validate the datagram and match it against the requests sent, in place in its ring slot.
+
+            if (m_exchange.response(reinterpret_cast<const uchar*>(slot.data), size_t(slot.size), slot.receiveNs))
+            {
+                acceptResponse(slot);
+
+                return;
+            }
 
-        return;
+            // Not logged here: a burst of stale datagrams must not allocate.
+
+            m_discarded++;
+            m_ring.pop();
+        }
     }
+}
 
-    NTPPackage responsePackage = generateResponsePackageFromByte(data);
+void NTPClient::acceptResponse(const NTPReceiveSlot& slot)
+{
+    // While racing server addresses, the path which answered wins.
 
-    if (responsePackage.checkByOriginTimestamp(m_originTimestampByte))
+    m_transport->accept(slot.data);
+
+    if (m_trace)
     {
-        m_failedTimes = 0;
-        m_offset      = responsePackage.calcOffset();
-        m_done        = true;
-        releaseSocket();
+        NTPTraceRecord record;
+        record.setFromResponse(QByteArray::fromRawData(slot.data, NTP_CORE_PACKET_SIZE), m_transport->peerAddress(), m_transport->peerPort(),
+                               slot.receiveNs, NTPClock::instance()->source());
+        m_trace->append(record);
+    }
 
-        emit signalNtpFinished();
+    // Slot is released with the socket, and the other datagrams received are stale.
 
-        qDebug() << "NTPClient::ntpFinished, offset:" << m_offset
-                 << ", for:" << m_ntpServerHost;
-    }
-    else
-    {
-        qDebug() << "NTPClient::failed, not match origin:"
-                 << m_originTimestampByte.toHex() << " to :"
-                 << responsePackage.m_requestLocalTimestampByte.toHex();
+    releaseSocket();
 
-        slotNtpError(QAbstractSocket::TemporaryError);
-    }
+    emit signalNtpFinished();
+
+    qDebug() << "NTPClient::ntpFinished, offset:" << offset()
+             << ", discarded datagrams:" << m_discarded
+             << ", for:" << m_ntpServerHost;
 }
 
 } // namespace QtSampleCodes
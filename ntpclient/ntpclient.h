@@ -24,15 +24,20 @@
 // Qt includes
 
 #include <QtCore>
-#include <QUdpSocket>
+#include <QAbstractSocket>
 
 // Local includes
 
+#include "ntpcore.h"
 #include "ntppackage.h"
+#include "ntpreceivering.h"
 
 namespace QtSampleCodes
 {
 
+class NTPTraceWriter;
+class NTPTransport;
+
 class NTPClient : public QObject
 {
     Q_OBJECT
@@ -47,15 +52,47 @@ public:
      */
     void start();
 
+    /**
+     * Cancel the exchange in progress and the pending resend.
+     */
+    void stop();
+
     /**
      * Whether synchronization is complete
      */
     bool done()     const;
 
     /**
-     * Timestamp to sync after done
+     * Timestamp to sync after done, in milli-seconds and nano-seconds.
+     */
+    qint64 offset()   const;
+    qint64 offsetNs() const;
+
+    /**
+     * Round-trip delay in nano-seconds and server stratum, after done.
+     */
+    qint64 delayNs()  const;
+    int    stratum()  const;
+
+    /**
+     * Datagrams received which did not match a request: stale, duplicate or invalid.
+     */
+    quint32 discarded() const;
+
+    /**
+     * Bounds of the adaptive response timeout in ms, see NTPCoreExchange::timeout().
+     */
+    void setTimeoutBounds(qint64 floorMs, qint64 ceilingMs);
+
+    /**
+     * Ntp server host name
      */
-    qint64 offset() const;
+    QString host()  const;
+
+    /**
+     * Append each completed exchange to trace. Trace is not owned, nullptr to stop recording.
+     */
+    void setTraceWriter(NTPTraceWriter* const trace);
 
 Q_SIGNALS:
 
@@ -65,16 +102,14 @@ Q_SIGNALS:
     void signalNtpFinished();
 
     /**
-     * Start sync signal. start() is issued, thread safe.
+     * Signal emitted when an exchange fails, before the delayed resend.
      */
-    void signalNtpStart();
-
-protected:
+    void signalNtpFailed();
 
     /**
-     * Asynchronous processing Udp timeout
+     * Start sync signal. start() is issued, thread safe.
      */
-    void timerEvent(QTimerEvent* event) Q_DECL_OVERRIDE;
+    void signalNtpStart();
 
 private Q_SLOTS:
 
@@ -94,27 +129,34 @@ private:
 
     void       cancel();
 
-    NTPPackage generateRequestPackage();
-    NTPPackage generateResponsePackageFromByte(const QByteArray& bytes);
-
     void       initSocket();
-    QByteArray readSocket();
     void       releaseSocket();
-    void       delayResend();
+    void       acceptResponse(const NTPReceiveSlot& slot);
+    void       delayResend(qint64 ms);
+
+    /**
+     * Asynchronous processing Udp timeout and delayed resend.
+     */
+    void       socketTimeout();
+    void       delayResendTimeout();
 
 private:
 
-    const QString m_ntpServerHost;
-    const quint16 m_ntpServerPort; // Note: Standard Ntp port is 123
+    const QString   m_ntpServerHost;
+    const quint16   m_ntpServerPort; // Note: Standard Ntp port is 123
+
+    /**
+     * Protocol state: requests sent, matching of responses, result and resend backoff.
+     */
+    NTPCoreExchange m_exchange;
 
-    bool          m_done;
-    QByteArray    m_originTimestampByte;
-    qint64        m_offset;
-    qint32        m_failedTimes;
+    NTPTransport*   m_transport;
+    NTPReceiveRing  m_ring;
+    qint32          m_socketTimerID;
+    qint32          m_delayResnedTimerID;
+    quint32         m_discarded;
 
-    QUdpSocket*   m_udpsocket;
-    qint32        m_socketTimerID;
-    qint32        m_delayResnedTimerID;
+    NTPTraceWriter* m_trace;
 };
 
 } // namespace QtSampleCodes
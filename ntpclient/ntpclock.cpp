@@ -0,0 +1,283 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Local clock and timers
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpclock.h"
+
+// C++ includes
+
+#include <chrono>
+#include <climits>
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QEvent>
+#include <QMutexLocker>
+#include <QThread>
+#include <QTimer>
+
+namespace QtSampleCodes
+{
+
+NTPClock* s_clock = nullptr;
+
+NTPClock::~NTPClock()
+{
+}
+
+NTPClock* NTPClock::instance()
+{
+    static NTPSystemClock* const s_systemClock = new NTPSystemClock();
+
+    return (s_clock ? s_clock : s_systemClock);
+}
+
+void NTPClock::setInstance(NTPClock* const clock)
+{
+    s_clock = clock;
+}
+
+// ---------------------------------------------------------------------
+
+NTPSystemClock::NTPSystemClock()
+    : m_nextID(1)
+{
+    m_monotonic.start();
+}
+
+NTPSystemClock::~NTPSystemClock()
+{
+    qDeleteAll(m_timers);
+    m_timers.clear();
+}
+
+NTPClock::Source NTPSystemClock::source() const
+{
+    return Realtime;
+}
+
+qint64 NTPSystemClock::currentMSecsSinceEpoch() const
+{
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+qint64 NTPSystemClock::currentNSecsSinceEpoch() const
+{
+    return qint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+qint64 NTPSystemClock::monotonicMSecs() const
+{
+    return m_monotonic.elapsed();
+}
+
+int NTPSystemClock::startTimer(qint64 ms, const Callback& callback)
+{
+    QTimer* const timer = new QTimer;
+    timer->setSingleShot(true);
+    timer->setTimerType(Qt::PreciseTimer);
+
+    QMutexLocker lock(&m_mutex);
+    const int    id = m_nextID++;
+
+    // A timer killed from another thread may still fire before its deletion: it is not in m_timers anymore.
+
+    QObject::connect(timer, &QTimer::timeout,
+                     [this, id, callback]()
+        {
+            QTimer* fired = nullptr;
+
+            {
+                QMutexLocker lock(&m_mutex);
+                fired = m_timers.take(id);
+            }
+
+            if (!fired)
+            {
+                return;
+            }
+
+            fired->deleteLater();
+            callback();
+        }
+    );
+
+    m_timers.insert(id, timer);
+    timer->start(int(qBound(qint64(0), ms, qint64(INT_MAX))));
+
+    return id;
+}
+
+void NTPSystemClock::killTimer(int id)
+{
+    QTimer* timer = nullptr;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        timer = m_timers.take(id);
+    }
+
+    if (timer)
+    {
+        // A QTimer can only be stopped from its thread, deleting it later stops it too.
+
+        if (timer->thread() == QThread::currentThread())
+        {
+            timer->stop();
+        }
+
+        timer->deleteLater();
+    }
+}
+
+// ---------------------------------------------------------------------
+
+NTPVirtualClock::NTPVirtualClock(qint64 referenceMSecsSinceEpoch)
+    : m_referenceEpochNs(referenceMSecsSinceEpoch * 1000000LL),
+      m_monotonicNs(0),
+      m_localErrorNs(0.0),
+      m_driftPpm(0.0),
+      m_nextID(1)
+{
+}
+
+NTPVirtualClock::~NTPVirtualClock()
+{
+}
+
+NTPClock::Source NTPVirtualClock::source() const
+{
+    return Virtual;
+}
+
+qint64 NTPVirtualClock::currentMSecsSinceEpoch() const
+{
+    return ((m_referenceEpochNs + m_monotonicNs + qint64(m_localErrorNs)) / 1000000LL);
+}
+
+qint64 NTPVirtualClock::currentNSecsSinceEpoch() const
+{
+    return (m_referenceEpochNs + m_monotonicNs + qint64(m_localErrorNs));
+}
+
+qint64 NTPVirtualClock::monotonicMSecs() const
+{
+    return (m_monotonicNs / 1000000LL);
+}
+
+qint64 NTPVirtualClock::referenceMSecsSinceEpoch() const
+{
+    return ((m_referenceEpochNs + m_monotonicNs) / 1000000LL);
+}
+
+qint64 NTPVirtualClock::localErrorMSecs() const
+{
+    return (qint64(m_localErrorNs) / 1000000LL);
+}
+
+int NTPVirtualClock::startTimer(qint64 ms, const Callback& callback)
+{
+    const int    id       = m_nextID++;
+    const qint64 deadline = m_monotonicNs + qMax(qint64(0), ms) * 1000000LL;
+
+    // Identifiers are increasing: timers with the same deadline fire in start order.
+
+    m_timers.insert(qMakePair(deadline, id), callback);
+    m_deadlines.insert(id, deadline);
+
+    return id;
+}
+
+void NTPVirtualClock::killTimer(int id)
+{
+    QHash<int, qint64>::iterator it = m_deadlines.find(id);
+
+    if (it != m_deadlines.end())
+    {
+        m_timers.remove(qMakePair(it.value(), id));
+        m_deadlines.erase(it);
+    }
+}
+
+void NTPVirtualClock::jump(qint64 ms)
+{
+    m_localErrorNs += double(ms) * 1.0e6;
+}
+
+void NTPVirtualClock::setDriftPpm(double ppm)
+{
+    m_driftPpm = ppm;
+}
+
+void NTPVirtualClock::moveTo(qint64 monotonicNs)
+{
+    if (monotonicNs <= m_monotonicNs)
+    {
+        return;
+    }
+
+    m_localErrorNs += double(monotonicNs - m_monotonicNs) * m_driftPpm * 1.0e-6;
+    m_monotonicNs   = monotonicNs;
+}
+
+int NTPVirtualClock::advance(qint64 ms)
+{
+    const qint64 target = m_monotonicNs + qMax(qint64(0), ms) * 1000000LL;
+    int          fired  = 0;
+
+    sendPostedEvents();
+
+    while (!m_timers.isEmpty() && (m_timers.firstKey().first <= target))
+    {
+        const QPair<qint64, int> key = m_timers.firstKey();
+        const Callback callback      = m_timers.take(key);
+        m_deadlines.remove(key.second);
+
+        moveTo(key.first);
+        callback();
+        ++fired;
+
+        sendPostedEvents();
+    }
+
+    moveTo(target);
+
+    return fired;
+}
+
+void NTPVirtualClock::sendPostedEvents()
+{
+    // Queued calls, and objects released with deleteLater(), as a running event loop would do.
+    // Deferred deletes are only sent when asked explicitly.
+
+    if (QCoreApplication::instance())
+    {
+        QCoreApplication::sendPostedEvents();
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    }
+}
+
+int NTPVirtualClock::pendingTimers() const
+{
+    return m_timers.size();
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,196 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Local clock and timers
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_CLOCK_H
+#define NTP_CLOCK_H
+
+// C++ includes
+
+#include <functional>
+
+// Qt includes
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QPair>
+
+class QTimer;
+
+namespace QtSampleCodes
+{
+
+/**
+ * Source of local time and single-shot timers used by all Ntp classes.
+ * The system clock is used by default, a virtual clock can be installed to run
+ * synchronization scenarios faster than real time.
+ */
+class NTPClock
+{
+
+public:
+
+    typedef std::function<void()> Callback;
+
+    /**
+     * Kind of local wall clock, recorded with the timestamps taken from it.
+     */
+    enum Source
+    {
+        Realtime = 0,       ///< System wall clock with nano-seconds resolution (std::chrono::system_clock).
+        Virtual  = 1        ///< Simulated wall clock, see NTPVirtualClock.
+    };
+
+public:
+
+    virtual ~NTPClock();
+
+    virtual Source source()                                      const = 0;
+
+    /**
+     * Local wall clock time, may jump or drift.
+     */
+    virtual qint64 currentMSecsSinceEpoch()                      const = 0;
+    virtual qint64 currentNSecsSinceEpoch()                      const = 0;
+
+    /**
+     * Monotonic time from an arbitrary reference, never jumps.
+     */
+    virtual qint64 monotonicMSecs()                              const = 0;
+
+    /**
+     * Call callback once after ms of monotonic time. Return an identifier > 0 to use with killTimer().
+     */
+    virtual int    startTimer(qint64 ms, const Callback& callback)    = 0;
+    virtual void   killTimer(int id)                                  = 0;
+
+public:
+
+    /**
+     * Clock used by Ntp classes. setInstance(nullptr) restores the system clock.
+     * Clock is not owned and must be installed before Ntp classes are used.
+     */
+    static NTPClock* instance();
+    static void      setInstance(NTPClock* const clock);
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Real time clock. Timers are QTimer and need a running event loop in the calling thread.
+ * Thread safe: a timer fires in the thread which started it, and can be killed from any thread.
+ */
+class NTPSystemClock : public NTPClock
+{
+
+public:
+
+    explicit NTPSystemClock();
+    ~NTPSystemClock();
+
+    Source source()                                      const Q_DECL_OVERRIDE;
+    qint64 currentMSecsSinceEpoch()                      const Q_DECL_OVERRIDE;
+    qint64 currentNSecsSinceEpoch()                      const Q_DECL_OVERRIDE;
+    qint64 monotonicMSecs()                              const Q_DECL_OVERRIDE;
+    int    startTimer(qint64 ms, const Callback& callback)     Q_DECL_OVERRIDE;
+    void   killTimer(int id)                                   Q_DECL_OVERRIDE;
+
+private:
+
+    QElapsedTimer        m_monotonic;
+    QMutex               m_mutex;               ///< Guards m_timers and m_nextID.
+    QHash<int, QTimer*>  m_timers;
+    int                  m_nextID;
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Simulated clock. Time only moves with advance(), which fires all due timers instantly in
+ * deadline order. The local wall clock follows a reference time with a configurable
+ * error: a drift in ppm and jumps, to check how the synchronization corrects them.
+ */
+class NTPVirtualClock : public NTPClock
+{
+
+public:
+
+    explicit NTPVirtualClock(qint64 referenceMSecsSinceEpoch = 1600000000000LL);
+    ~NTPVirtualClock();
+
+    Source source()                                      const Q_DECL_OVERRIDE;
+    qint64 currentMSecsSinceEpoch()                      const Q_DECL_OVERRIDE;
+    qint64 currentNSecsSinceEpoch()                      const Q_DECL_OVERRIDE;
+    qint64 monotonicMSecs()                              const Q_DECL_OVERRIDE;
+    int    startTimer(qint64 ms, const Callback& callback)     Q_DECL_OVERRIDE;
+    void   killTimer(int id)                                   Q_DECL_OVERRIDE;
+
+    /**
+     * True time, used by simulated servers.
+     */
+    qint64 referenceMSecsSinceEpoch()                    const;
+
+    /**
+     * Difference between local wall clock and true time.
+     */
+    qint64 localErrorMSecs()                             const;
+
+    /**
+     * Step the local wall clock by ms.
+     */
+    void   jump(qint64 ms);
+
+    /**
+     * Local wall clock runs faster (positive ppm) or slower than true time from now.
+     */
+    void   setDriftPpm(double ppm);
+
+    /**
+     * Move time forward by ms, firing all timers due until then. Return the number of timers fired.
+     * Posted events, as queued calls, are delivered first and after each timer.
+     */
+    int    advance(qint64 ms);
+
+    /**
+     * Pending timers count.
+     */
+    int    pendingTimers()                               const;
+
+private:
+
+    void   moveTo(qint64 monotonicNs);
+    void   sendPostedEvents();
+
+private:
+
+    qint64                              m_referenceEpochNs;     ///< True time when monotonic time is zero.
+    qint64                              m_monotonicNs;
+    double                              m_localErrorNs;
+    double                              m_driftPpm;
+
+    QMap<QPair<qint64, int>, Callback>  m_timers;               ///< Timers sorted by monotonic deadline in ns, then identifier.
+    QHash<int, qint64>                  m_deadlines;
+    int                                 m_nextID;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_CLOCK_H
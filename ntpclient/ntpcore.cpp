@@ -0,0 +1,369 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Protocol and exchange
+ *               state without Qt dependency.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpcore.h"
+
+// C++ includes
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#define NTP_EPOCH_DELTA_SECONDS     2208988800LL            // Seconds from 1900-01-01 to 1970-01-01
+
+namespace QtSampleCodes
+{
+
+const int64_t s_coreResendIntervals[NTP_CORE_RESEND_COUNT] =
+{
+    2000,
+    5000,
+    10000,
+    15000,
+    20000,
+    30000
+};
+
+uint64_t s_readUInt64(const unsigned char* const data)
+{
+    uint64_t value = 0;
+
+    for (int i = 0 ; i < 8 ; ++i)
+    {
+        value = (value << 8) | data[i];
+    }
+
+    return value;
+}
+
+void s_writeUInt64(unsigned char* const data, uint64_t value)
+{
+    for (int i = 7 ; i >= 0 ; --i)
+    {
+        data[i]   = static_cast<unsigned char>(value & 0xff);
+        value   >>= 8;
+    }
+}
+
+// ---------------------------------------------------------------------
+
+int64_t ntpCoreDifferenceToNs(int64_t diff)
+{
+    // Arithmetic shift keeps the sign in the seconds part, the fraction part is always positive.
+
+    int64_t  second   = diff >> 32;
+    uint64_t fraction = static_cast<uint64_t>(diff) & 0xffffffffULL;
+
+    return (second * 1000000000LL + static_cast<int64_t>((fraction * 1000000000ULL) >> 32));
+}
+
+uint64_t ntpCoreTimestampFromNs(int64_t ns)
+{
+    int64_t second    = ns / 1000000000LL;
+    int64_t remainder = ns % 1000000000LL;
+
+    if (remainder < 0)
+    {
+        second--;
+        remainder += 1000000000LL;
+    }
+
+    return ((static_cast<uint64_t>(second + NTP_EPOCH_DELTA_SECONDS) << 32) |
+            ((static_cast<uint64_t>(remainder) << 32) / 1000000000ULL));
+}
+
+int64_t ntpCoreTimestampToNs(uint64_t ts)
+{
+    return ntpCoreDifferenceToNs(static_cast<int64_t>(ts - (static_cast<uint64_t>(NTP_EPOCH_DELTA_SECONDS) << 32)));
+}
+
+int64_t ntpCoreTrimmedMean(int64_t* const values, size_t count)
+{
+    int64_t total  = 0;
+    int64_t maxval = std::numeric_limits<int64_t>::min();
+    int64_t minval = std::numeric_limits<int64_t>::max();
+
+    for (size_t i = 0 ; i < count ; ++i)
+    {
+        total  += values[i];
+        maxval  = std::max(maxval, values[i]);
+        minval  = std::min(minval, values[i]);
+    }
+
+    if (count > 2)
+    {
+        total -= (maxval + minval);
+        count -= 2;
+    }
+
+    return ((count > 0) ? (total / static_cast<int64_t>(count)) : 0);
+}
+
+int64_t ntpCoreMedian(int64_t* const values, size_t count)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    const size_t middle = count / 2;
+    std::nth_element(values, values + middle, values + count);
+    int64_t median      = values[middle];
+
+    if ((count % 2) == 0)
+    {
+        // Mean of the two middle values: the lower one is the max of the first half.
+
+        median = (median + *std::max_element(values, values + middle)) / 2;
+    }
+
+    return median;
+}
+
+// ---------------------------------------------------------------------
+
+bool NTPCoreResponse::parse(const unsigned char* const data, size_t size)
+{
+    if (size != NTP_CORE_PACKET_SIZE)
+    {
+        return false;
+    }
+
+    leap     = (data[0] >> 6) & 0x3;
+    version  = (data[0] >> 3) & 0x7;
+    mode     =  data[0]       & 0x7;
+    stratum  =  data[1];
+    origin   = s_readUInt64(data + 24);
+    receive  = s_readUInt64(data + 32);
+    transmit = s_readUInt64(data + 40);
+
+    // Mode 4: server. Broadcast and symmetric modes are not answers to a client request.
+    // An unsynchronized server (leap indicator 3, stratum 16 and above) or a kiss-o'-death
+    // (stratum 0) gives no usable time: dropped as a loss, the request times out and backs off.
+
+    return ((mode == 4) && (leap != 3) && (stratum != 0) && (stratum < 16));
+}
+
+// ---------------------------------------------------------------------
+
+NTPCoreExchange::NTPCoreExchange()
+    : m_originCount(0),
+      m_done(false),
+      m_failures(0),
+      m_stratum(0),
+      m_t0(0),
+      m_t1(0),
+      m_t2(0),
+      m_t3(0),
+      m_srtt(0),
+      m_rttvar(0),
+      m_timeoutFloor(NTP_CORE_MIN_TIMEOUT),
+      m_timeoutCeiling(NTP_CORE_TIMEOUT)
+{
+    memset(m_origins, 0, sizeof(m_origins));
+}
+
+NTPCoreExchange::~NTPCoreExchange()
+{
+}
+
+void NTPCoreExchange::start()
+{
+    m_originCount = 0;
+    m_done        = false;
+}
+
+size_t NTPCoreExchange::request(unsigned char* const data, int64_t nowNs)
+{
+    memset(data, 0, NTP_CORE_PACKET_SIZE);
+
+    data[0]           = static_cast<unsigned char>((0 << 6) | (3 << 3) | 3);    // LI: no warning, version 3, mode: client
+    data[2]           = 4;                                                      // Poll
+    data[3]           = static_cast<unsigned char>(-6);                         // Precision
+
+    // Keep each origin unique, even if the local clock does not move between two requests.
+
+    uint64_t origin   = ntpCoreTimestampFromNs(nowNs);
+
+    for (int i = 0 ; i < m_originCount ; ++i)
+    {
+        if (m_origins[i] >= origin)
+        {
+            origin = m_origins[i] + 1;
+        }
+    }
+
+    if (m_originCount == NTP_CORE_MAX_ORIGINS)
+    {
+        memmove(m_origins, m_origins + 1, sizeof(uint64_t) * (NTP_CORE_MAX_ORIGINS - 1));
+        m_originCount--;
+    }
+
+    m_origins[m_originCount++] = origin;
+    s_writeUInt64(data + 40, origin);
+
+    return NTP_CORE_PACKET_SIZE;
+}
+
+bool NTPCoreExchange::response(const unsigned char* const data, size_t size, int64_t receiveNs)
+{
+    NTPCoreResponse response;
+
+    if (m_done || !response.parse(data, size))
+    {
+        return false;
+    }
+
+    for (int i = 0 ; i < m_originCount ; ++i)
+    {
+        if (m_origins[i] == response.origin)
+        {
+            m_done     = true;
+            m_failures = 0;
+            m_stratum  = response.stratum;
+            m_t0       = response.origin;
+            m_t1       = response.receive;
+            m_t2       = response.transmit;
+            m_t3       = ntpCoreTimestampFromNs(receiveNs);
+
+            // Each request has its own origin: the round-trip time is not ambiguous after a resend (Karn).
+
+            const int64_t rtt = ntpCoreDifferenceToNs(static_cast<int64_t>(m_t3 - m_t0));
+
+            if (rtt >= 0)
+            {
+                if (m_srtt == 0)
+                {
+                    m_srtt   = std::max(rtt, int64_t(1));
+                    m_rttvar = rtt / 2;
+                }
+                else
+                {
+                    m_rttvar += (std::abs(m_srtt - rtt) - m_rttvar) / 4;
+                    m_srtt   += (rtt - m_srtt) / 8;
+                }
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int64_t NTPCoreExchange::fail()
+{
+    m_done = false;
+    m_failures++;
+
+    const int64_t interval = s_coreResendIntervals[std::min(std::max(m_failures, 1), NTP_CORE_RESEND_COUNT) - 1];
+
+    return std::max(m_timeoutFloor, interval * baseTimeout() / NTP_CORE_TIMEOUT);
+}
+
+void NTPCoreExchange::setTimeoutBounds(int64_t floorMs, int64_t ceilingMs)
+{
+    m_timeoutFloor   = std::max(int64_t(1), floorMs);
+    m_timeoutCeiling = std::max(m_timeoutFloor, ceilingMs);
+}
+
+int64_t NTPCoreExchange::baseTimeout() const
+{
+    // RTO = SRTT + max(G, 4 * RTTVAR), with a clock granularity G of 1 ms.
+
+    const int64_t rto = (m_srtt == 0) ? NTP_CORE_INITIAL_TIMEOUT
+                                      : (m_srtt + std::max(int64_t(1000000), 4 * m_rttvar) + 999999) / 1000000;
+
+    return std::min(std::max(rto, m_timeoutFloor), m_timeoutCeiling);
+}
+
+int64_t NTPCoreExchange::timeout() const
+{
+    const int64_t rto = baseTimeout();
+
+    // Exponential backoff while the server does not answer.
+
+    return ((m_failures >= 31) ? m_timeoutCeiling : std::min(rto << m_failures, m_timeoutCeiling));
+}
+
+int64_t NTPCoreExchange::smoothedRttNs() const
+{
+    return m_srtt;
+}
+
+int64_t NTPCoreExchange::rttVarianceNs() const
+{
+    return m_rttvar;
+}
+
+bool NTPCoreExchange::done() const
+{
+    return m_done;
+}
+
+int NTPCoreExchange::failures() const
+{
+    return m_failures;
+}
+
+int64_t NTPCoreExchange::offsetNs() const
+{
+    // offset = ((t1 - t0) + (t2 - t3)) / 2
+
+    return ((ntpCoreDifferenceToNs(static_cast<int64_t>(m_t1 - m_t0)) +
+             ntpCoreDifferenceToNs(static_cast<int64_t>(m_t2 - m_t3))) / 2);
+}
+
+int64_t NTPCoreExchange::delayNs() const
+{
+    // delay = (t3 - t0) - (t2 - t1)
+
+    return (ntpCoreDifferenceToNs(static_cast<int64_t>(m_t3 - m_t0)) -
+            ntpCoreDifferenceToNs(static_cast<int64_t>(m_t2 - m_t1)));
+}
+
+uint8_t NTPCoreExchange::stratum() const
+{
+    return m_stratum;
+}
+
+uint64_t NTPCoreExchange::t0() const
+{
+    return m_t0;
+}
+
+uint64_t NTPCoreExchange::t1() const
+{
+    return m_t1;
+}
+
+uint64_t NTPCoreExchange::t2() const
+{
+    return m_t2;
+}
+
+uint64_t NTPCoreExchange::t3() const
+{
+    return m_t3;
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,177 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Protocol and exchange
+ *               state without Qt dependency.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_CORE_H
+#define NTP_CORE_H
+
+// C++ includes
+
+#include <cstddef>
+#include <cstdint>
+
+#define NTP_CORE_PACKET_SIZE        48
+#define NTP_CORE_MAX_ORIGINS        8       // Requests of one exchange which can be answered (address race)
+#define NTP_CORE_TIMEOUT            30000   // Time to wait for a response, in ms: the highest adaptive timeout by default
+#define NTP_CORE_MIN_TIMEOUT        200     // Lowest adaptive timeout by default, in ms
+#define NTP_CORE_INITIAL_TIMEOUT    3000    // Timeout before the first round-trip time is measured, in ms
+#define NTP_CORE_RESEND_COUNT       6
+
+namespace QtSampleCodes
+{
+
+/**
+ * Conversions between Ntp 64 bits timestamps (32 bits seconds since 1900, 32 bits fraction)
+ * and nano-seconds since Epoch, and of a difference of Ntp timestamps to nano-seconds.
+ */
+uint64_t ntpCoreTimestampFromNs(int64_t ns);
+int64_t  ntpCoreTimestampToNs(uint64_t ts);
+int64_t  ntpCoreDifferenceToNs(int64_t diff);
+
+/**
+ * Combine server offsets. Values are reordered.
+ * Trimmed mean drops the min and max values if there are more than two values.
+ */
+int64_t  ntpCoreTrimmedMean(int64_t* const values, size_t count);
+int64_t  ntpCoreMedian(int64_t* const values, size_t count);
+
+// ---------------------------------------------------------------------
+
+/**
+ * Decoded server response.
+ */
+struct NTPCoreResponse
+{
+    uint8_t  leap;
+    uint8_t  version;
+    uint8_t  mode;
+    uint8_t  stratum;
+    uint64_t origin;                    ///< t0, echoed from the request.
+    uint64_t receive;                   ///< t1.
+    uint64_t transmit;                  ///< t2.
+
+    /**
+     * Decode a datagram. Return false if it is not a 48 bytes server response, or if the server
+     * is not synchronized or sends a kiss-o'-death.
+     */
+    bool parse(const unsigned char* const data, size_t size);
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Protocol state of the exchanges with one server, without I/O: the caller sends the
+ * requests built here, feeds the datagrams received, and schedules the timeouts and resends.
+ * Used by the Qt client and by the epoll core.
+ */
+class NTPCoreExchange
+{
+
+public:
+
+    explicit NTPCoreExchange();
+    ~NTPCoreExchange();
+
+    /**
+     * Start a new exchange: forget the requests sent before.
+     */
+    void     start();
+
+    /**
+     * Write a client request stamped with the local time nowNs in data, which must hold NTP_CORE_PACKET_SIZE bytes.
+     * Several requests can be sent for one exchange, a response to any of the last NTP_CORE_MAX_ORIGINS is accepted.
+     * Return the request size.
+     */
+    size_t   request(unsigned char* const data, int64_t nowNs);
+
+    /**
+     * Feed a datagram received at the local time receiveNs. Return true if it completes the exchange.
+     */
+    bool     response(const unsigned char* const data, size_t size, int64_t receiveNs);
+
+    /**
+     * The exchange failed: no response, or a network error. Return the delay before the next try, in ms.
+     * The resend intervals are scaled by the ratio of the retransmission timeout to NTP_CORE_TIMEOUT.
+     */
+    int64_t  fail();
+
+    /**
+     * Bounds of timeout(), in ms. Default are NTP_CORE_MIN_TIMEOUT and NTP_CORE_TIMEOUT.
+     */
+    void     setTimeoutBounds(int64_t floorMs, int64_t ceilingMs);
+
+    /**
+     * Time to wait for the response to a request, in ms. Computed as the TCP retransmission
+     * timeout (RFC 6298) from the smoothed round-trip time and its variance, doubled by
+     * consecutive failure, within the bounds.
+     */
+    int64_t  timeout()       const;
+
+    /**
+     * Smoothed round-trip time and its variance, in nano-seconds. 0 before the first response.
+     */
+    int64_t  smoothedRttNs() const;
+    int64_t  rttVarianceNs() const;
+
+    bool     done()          const;
+    int      failures()      const;
+
+    /**
+     * Result of the last completed exchange.
+     */
+    int64_t  offsetNs()      const;
+    int64_t  delayNs()       const;
+    uint8_t  stratum()       const;
+
+    /**
+     * Ntp timestamps of the last completed exchange.
+     */
+    uint64_t t0()            const;
+    uint64_t t1()            const;
+    uint64_t t2()            const;
+    uint64_t t3()            const;
+
+private:
+
+    /**
+     * Retransmission timeout without backoff, in ms.
+     */
+    int64_t  baseTimeout()   const;
+
+private:
+
+    uint64_t m_origins[NTP_CORE_MAX_ORIGINS];
+    int      m_originCount;
+    bool     m_done;
+    int      m_failures;
+    uint8_t  m_stratum;
+    uint64_t m_t0;
+    uint64_t m_t1;
+    uint64_t m_t2;
+    uint64_t m_t3;
+    int64_t  m_srtt;
+    int64_t  m_rttvar;
+    int64_t  m_timeoutFloor;
+    int64_t  m_timeoutCeiling;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_CORE_H
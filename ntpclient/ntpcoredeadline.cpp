@@ -0,0 +1,185 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Timers with absolute
+ *               deadlines in network time.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpcoredeadline.h"
+
+// C++ includes
+
+#include <algorithm>
+#include <ctime>
+
+// Linux includes
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// Local includes
+
+#include "ntpcoresync.h"
+
+namespace QtSampleCodes
+{
+
+NTPDeadlineTimers::NTPDeadlineTimers(NTPEventLoop* const loop, NTPCoreSync* const sync)
+    : m_loop(loop),
+      m_sync(sync),
+      m_fd(timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC)),
+      m_listenerID(0),
+      m_slack(NTP_DEADLINE_SLACK),
+      m_nextID(1)
+{
+    if (!isValid())
+    {
+        return;
+    }
+
+    m_loop->addWatch(m_fd, EPOLLIN, [this](uint32_t) { fire(); });
+
+    if (m_sync)
+    {
+        m_listenerID = m_sync->addOffsetListener([this]() { arm(); });
+    }
+}
+
+NTPDeadlineTimers::~NTPDeadlineTimers()
+{
+    if (m_listenerID)
+    {
+        m_sync->removeOffsetListener(m_listenerID);
+    }
+
+    if (m_fd >= 0)
+    {
+        m_loop->removeWatch(m_fd);
+        close(m_fd);
+    }
+}
+
+bool NTPDeadlineTimers::isValid() const
+{
+    return (m_fd >= 0);
+}
+
+int NTPDeadlineTimers::start(int64_t deadlineNs, const NTPEventLoop::Callback& callback)
+{
+    const int id = m_nextID++;
+
+    m_timers[std::make_pair(deadlineNs, id)] = callback;
+    m_deadlines[id]                          = deadlineNs;
+
+    if (m_timers.begin()->first.second == id)
+    {
+        arm();
+    }
+
+    return id;
+}
+
+void NTPDeadlineTimers::kill(int id)
+{
+    std::unordered_map<int, int64_t>::iterator it = m_deadlines.find(id);
+
+    if (it == m_deadlines.end())
+    {
+        return;
+    }
+
+    m_timers.erase(std::make_pair(it->second, id));
+    m_deadlines.erase(it);
+
+    // The timerfd is left armed: an early wakeup without due deadline is harmless.
+}
+
+size_t NTPDeadlineTimers::count() const
+{
+    return m_timers.size();
+}
+
+void NTPDeadlineTimers::setSlack(int64_t ns)
+{
+    m_slack = std::max(int64_t(0), ns);
+}
+
+int64_t NTPDeadlineTimers::slack() const
+{
+    return m_slack;
+}
+
+int64_t NTPDeadlineTimers::currentNSecsSinceEpoch() const
+{
+    return (m_sync ? m_sync->currentNSecsSinceEpoch() : NTPEventLoop::realtimeNs());
+}
+
+void NTPDeadlineTimers::arm()
+{
+    if (!isValid())
+    {
+        return;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec  = 0;
+    spec.it_interval.tv_nsec = 0;
+    spec.it_value.tv_sec     = 0;
+    spec.it_value.tv_nsec    = 0;
+
+    if (!m_timers.empty())
+    {
+        // The network deadline in local realtime, with the offset known now. A zero value disarms the timer.
+
+        const int64_t offset     = (m_sync ? m_sync->offsetNs() : 0);
+        const int64_t deadline   = std::max(int64_t(1), m_timers.begin()->first.first - offset);
+        spec.it_value.tv_sec     = time_t(deadline / 1000000000LL);
+        spec.it_value.tv_nsec    = long(deadline % 1000000000LL);
+    }
+
+    // When the local clock is set, the kernel cancels the timer and fire() arms it again.
+
+    timerfd_settime(m_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, nullptr);
+}
+
+void NTPDeadlineTimers::fire()
+{
+    uint64_t expirations = 0;
+
+    if (read(m_fd, &expirations, sizeof(expirations)) < 0)
+    {
+        // ECANCELED after a set of the local clock: the due deadlines are checked the same way.
+    }
+
+    // A callback can start or kill timers: take the first due deadline each time.
+
+    while (!m_timers.empty() && (m_timers.begin()->first.first <= currentNSecsSinceEpoch() + m_slack))
+    {
+        std::map<std::pair<int64_t, int>, NTPEventLoop::Callback>::iterator it = m_timers.begin();
+        NTPEventLoop::Callback callback                                         = it->second;
+
+        m_deadlines.erase(it->first.second);
+        m_timers.erase(it);
+
+        callback();
+    }
+
+    arm();
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,107 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Timers with absolute
+ *               deadlines in network time.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_CORE_DEADLINE_H
+#define NTP_CORE_DEADLINE_H
+
+// C++ includes
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+// Local includes
+
+#include "ntpcoreloop.h"
+
+#define NTP_DEADLINE_SLACK          100000      // Deadlines closer than this share one wakeup, in ns
+
+namespace QtSampleCodes
+{
+
+class NTPCoreSync;
+
+/**
+ * Timers firing at absolute instants of network time, to run coordinated actions on several hosts.
+ *
+ * Deadlines are converted to CLOCK_REALTIME with the offset of the synchronization, and the earliest
+ * one arms an absolute timerfd. The timer is armed again when the offset changes, and when the local
+ * clock is set: the timerfd is canceled by the kernel then. A slew of the local clock is followed by
+ * the realtime timer itself. Deadlines due within the slack of the first one fire in the same wakeup,
+ * early by at most the slack.
+ *
+ * Without synchronization, deadlines are in local realtime. Methods are called from the loop thread,
+ * and the loop and the synchronization must outlive this instance.
+ */
+class NTPDeadlineTimers
+{
+
+public:
+
+    explicit NTPDeadlineTimers(NTPEventLoop* const loop, NTPCoreSync* const sync = nullptr);
+    ~NTPDeadlineTimers();
+
+    /**
+     * False if the timerfd cannot be created.
+     */
+    bool    isValid()                                                           const;
+
+    /**
+     * Call callback at deadlineNs, in nano-seconds since Epoch of network time. A deadline
+     * in the past fires at the next loop iteration. Return an identifier > 0 to use with kill().
+     */
+    int     start(int64_t deadlineNs, const NTPEventLoop::Callback& callback);
+    void    kill(int id);
+    size_t  count()                                                             const;
+
+    /**
+     * Tolerance of the wakeup batching in ns, NTP_DEADLINE_SLACK by default. 0 disables it.
+     */
+    void    setSlack(int64_t ns);
+    int64_t slack()                                                             const;
+
+    /**
+     * Current network time in nano-seconds since Epoch, as used for the deadlines.
+     */
+    int64_t currentNSecsSinceEpoch()                                            const;
+
+private:
+
+    void    arm();
+    void    fire();
+
+private:
+
+    NTPEventLoop* const                                       m_loop;
+    NTPCoreSync* const                                        m_sync;
+    int                                                       m_fd;
+    int                                                       m_listenerID;
+    int64_t                                                   m_slack;
+
+    std::map<std::pair<int64_t, int>, NTPEventLoop::Callback> m_timers;     ///< Timers sorted by network deadline in ns, then identifier.
+    std::unordered_map<int, int64_t>                          m_deadlines;
+    int                                                       m_nextID;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_CORE_DEADLINE_H
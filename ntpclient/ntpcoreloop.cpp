@@ -0,0 +1,317 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Event loop based
+ *               on epoll and timerfd, without Qt dependency.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpcoreloop.h"
+
+// C++ includes
+
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+
+// Linux includes
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define NTP_LOOP_MAX_EVENTS         64
+
+namespace QtSampleCodes
+{
+
+int64_t s_clockNs(clockid_t id)
+{
+    struct timespec ts;
+    clock_gettime(id, &ts);
+
+    return (int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec);
+}
+
+void s_drain(int fd)
+{
+    uint64_t value = 0;
+
+    while (read(fd, &value, sizeof(value)) == sizeof(value))
+    {
+    }
+}
+
+// ---------------------------------------------------------------------
+
+NTPEventLoop::NTPEventLoop()
+    : m_epollFd(epoll_create1(EPOLL_CLOEXEC)),
+      m_timerFd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      m_wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      m_quit(false),
+      m_nextID(1)
+{
+    if (!isValid())
+    {
+        return;
+    }
+
+    // The internal descriptors are registered with their own value as key, callbacks use the fd.
+
+    struct epoll_event event;
+    event.events  = EPOLLIN;
+    event.data.fd = m_timerFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_timerFd, &event);
+
+    event.data.fd = m_wakeFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+}
+
+NTPEventLoop::~NTPEventLoop()
+{
+    if (m_wakeFd >= 0)
+    {
+        close(m_wakeFd);
+    }
+
+    if (m_timerFd >= 0)
+    {
+        close(m_timerFd);
+    }
+
+    if (m_epollFd >= 0)
+    {
+        close(m_epollFd);
+    }
+}
+
+bool NTPEventLoop::isValid() const
+{
+    return ((m_epollFd >= 0) && (m_timerFd >= 0) && (m_wakeFd >= 0));
+}
+
+int NTPEventLoop::fd() const
+{
+    return m_epollFd;
+}
+
+bool NTPEventLoop::addWatch(int fd, uint32_t events, const IOCallback& callback)
+{
+    struct epoll_event event;
+    event.events  = events;
+    event.data.fd = fd;
+
+    const int op  = (m_watches.count(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD);
+
+    if (epoll_ctl(m_epollFd, op, fd, &event) != 0)
+    {
+        return false;
+    }
+
+    m_watches[fd] = callback;
+
+    return true;
+}
+
+void NTPEventLoop::removeWatch(int fd)
+{
+    if (m_watches.erase(fd))
+    {
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+int NTPEventLoop::startTimer(int64_t ms, const Callback& callback)
+{
+    const int     id       = m_nextID++;
+    const int64_t deadline = monotonicNs() + std::max(int64_t(0), ms) * 1000000LL;
+
+    m_timers[std::make_pair(deadline, id)] = callback;
+    m_deadlines[id]                        = deadline;
+
+    if (m_timers.begin()->first.second == id)
+    {
+        armTimer();
+    }
+
+    return id;
+}
+
+void NTPEventLoop::killTimer(int id)
+{
+    std::unordered_map<int, int64_t>::iterator it = m_deadlines.find(id);
+
+    if (it == m_deadlines.end())
+    {
+        return;
+    }
+
+    m_timers.erase(std::make_pair(it->second, id));
+    m_deadlines.erase(it);
+
+    // The timerfd is left armed: an early wakeup without due timer is harmless.
+}
+
+void NTPEventLoop::post(const Callback& callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        m_posted.push_back(callback);
+    }
+
+    const uint64_t one = 1;
+
+    if (write(m_wakeFd, &one, sizeof(one)) < 0)
+    {
+        // Counter is saturated: the loop is already woken up.
+    }
+}
+
+void NTPEventLoop::armTimer()
+{
+    struct itimerspec spec;
+    spec.it_interval.tv_sec  = 0;
+    spec.it_interval.tv_nsec = 0;
+    spec.it_value.tv_sec     = 0;
+    spec.it_value.tv_nsec    = 0;
+
+    if (!m_timers.empty())
+    {
+        // A zero value disarms the timer: a deadline in the past is set to 1 ns.
+
+        const int64_t deadline   = std::max(int64_t(1), m_timers.begin()->first.first);
+        spec.it_value.tv_sec     = time_t(deadline / 1000000000LL);
+        spec.it_value.tv_nsec    = long(deadline % 1000000000LL);
+    }
+
+    timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+int NTPEventLoop::fireTimers()
+{
+    const int64_t now   = monotonicNs();
+    int           fired = 0;
+
+    // A callback can start or kill timers: take the first due timer each time.
+
+    while (!m_timers.empty() && (m_timers.begin()->first.first <= now))
+    {
+        std::map<std::pair<int64_t, int>, Callback>::iterator it = m_timers.begin();
+        Callback callback                                         = it->second;
+
+        m_deadlines.erase(it->first.second);
+        m_timers.erase(it);
+
+        callback();
+        fired++;
+    }
+
+    armTimer();
+
+    return fired;
+}
+
+int NTPEventLoop::firePosted()
+{
+    std::vector<Callback> posted;
+
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        posted.swap(m_posted);
+    }
+
+    for (size_t i = 0 ; i < posted.size() ; ++i)
+    {
+        posted[i]();
+    }
+
+    return int(posted.size());
+}
+
+int NTPEventLoop::processEvents(int timeoutMs)
+{
+    struct epoll_event events[NTP_LOOP_MAX_EVENTS];
+    const int          count  = epoll_wait(m_epollFd, events, NTP_LOOP_MAX_EVENTS, timeoutMs);
+    int                called = 0;
+
+    if (count < 0)
+    {
+        return -1;
+    }
+
+    for (int i = 0 ; i < count ; ++i)
+    {
+        const int fd = events[i].data.fd;
+
+        if (fd == m_timerFd)
+        {
+            s_drain(m_timerFd);
+            called += fireTimers();
+        }
+        else if (fd == m_wakeFd)
+        {
+            s_drain(m_wakeFd);
+            called += firePosted();
+        }
+        else
+        {
+            // The watch can be removed by a previous callback of this batch.
+
+            std::unordered_map<int, IOCallback>::iterator it = m_watches.find(fd);
+
+            if (it != m_watches.end())
+            {
+                IOCallback callback = it->second;
+                callback(events[i].events);
+                called++;
+            }
+        }
+    }
+
+    return called;
+}
+
+void NTPEventLoop::run()
+{
+    while (!m_quit)
+    {
+        if ((processEvents(-1) < 0) && (errno != EINTR))
+        {
+            break;
+        }
+    }
+
+    m_quit = false;
+}
+
+void NTPEventLoop::quit()
+{
+    m_quit = true;
+    post([]() {});
+}
+
+int64_t NTPEventLoop::monotonicNs()
+{
+    return s_clockNs(CLOCK_MONOTONIC);
+}
+
+int64_t NTPEventLoop::realtimeNs()
+{
+    return s_clockNs(CLOCK_REALTIME);
+}
+
+} // namespace QtSampleCodes
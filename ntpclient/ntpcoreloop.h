@@ -0,0 +1,124 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Event loop based
+ *               on epoll and timerfd, without Qt dependency.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_CORE_LOOP_H
+#define NTP_CORE_LOOP_H
+
+// C++ includes
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace QtSampleCodes
+{
+
+/**
+ * Single threaded event loop: file descriptors are watched with epoll, and all timers
+ * share one monotonic timerfd armed at the earliest deadline.
+ *
+ * The loop can run in its own thread with run(), or be embedded in the event loop of
+ * a service: fd() is readable when events are pending, then call processEvents(0).
+ * Only post() and quit() are thread safe, other methods are called from the loop thread.
+ */
+class NTPEventLoop
+{
+
+public:
+
+    typedef std::function<void()>              Callback;
+    typedef std::function<void(uint32_t)>      IOCallback;
+
+public:
+
+    explicit NTPEventLoop();
+    ~NTPEventLoop();
+
+    /**
+     * False if the epoll, timerfd or eventfd descriptors cannot be created.
+     */
+    bool    isValid()                                              const;
+    int     fd()                                                   const;
+
+    /**
+     * Call callback with the epoll events (EPOLLIN, EPOLLERR...) each time fd is ready.
+     */
+    bool    addWatch(int fd, uint32_t events, const IOCallback& callback);
+    void    removeWatch(int fd);
+
+    /**
+     * Call callback once after ms of monotonic time. Return an identifier > 0 to use with killTimer().
+     */
+    int     startTimer(int64_t ms, const Callback& callback);
+    void    killTimer(int id);
+
+    /**
+     * Call callback in the loop thread, from any thread.
+     */
+    void    post(const Callback& callback);
+
+    /**
+     * Wait up to timeoutMs for events (-1: forever) and dispatch them. Return the number of callbacks called.
+     */
+    int     processEvents(int timeoutMs);
+
+    /**
+     * Dispatch events until quit() is called.
+     */
+    void    run();
+    void    quit();
+
+    /**
+     * CLOCK_MONOTONIC and CLOCK_REALTIME in nano-seconds.
+     */
+    static int64_t monotonicNs();
+    static int64_t realtimeNs();
+
+private:
+
+    void    armTimer();
+    int     fireTimers();
+    int     firePosted();
+
+private:
+
+    int                                             m_epollFd;
+    int                                             m_timerFd;
+    int                                             m_wakeFd;
+    std::atomic<bool>                               m_quit;
+
+    std::unordered_map<int, IOCallback>             m_watches;
+    std::map<std::pair<int64_t, int>, Callback>     m_timers;       ///< Timers sorted by monotonic deadline in ns, then identifier.
+    std::unordered_map<int, int64_t>                m_deadlines;
+    int                                             m_nextID;
+
+    std::mutex                                      m_postMutex;
+    std::vector<Callback>                           m_posted;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_CORE_LOOP_H
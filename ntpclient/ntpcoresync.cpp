@@ -0,0 +1,480 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Synchronization with
+ *               a set of Ntp servers, driven by the core event loop.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpcoresync.h"
+
+// C++ includes
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+// Linux includes
+
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Local includes
+
+#include "ntpchrono.h"
+
+#define core_check_interval     1000
+#define core_check_sleep        60000
+#define core_check_precision    1000000000LL
+
+namespace QtSampleCodes
+{
+
+void s_coreFreeAddresses(struct addrinfo* const list)
+{
+    if (list)
+    {
+        freeaddrinfo(list);
+    }
+}
+
+// ---------------------------------------------------------------------
+
+/**
+ * State of one server.
+ */
+struct NTPCoreSync::Server
+{
+    Server()
+        : fd(-1),
+          timeoutTimerID(0),
+          resendTimerID(0)
+    {
+    }
+
+    std::string     host;
+    NTPCoreExchange exchange;
+    int             fd;
+    int             timeoutTimerID;
+    int             resendTimerID;
+};
+
+// ---------------------------------------------------------------------
+
+NTPCoreSync::NTPCoreSync(NTPEventLoop* const loop)
+    : m_loop(loop),
+      m_port(123),
+      m_pollInterval(0),
+      m_timeoutFloor(NTP_CORE_MIN_TIMEOUT),
+      m_timeoutCeiling(NTP_CORE_TIMEOUT),
+      m_running(false),
+      m_checkTimerID(0),
+      m_pollTimerID(0),
+      m_predictRealtime(0),
+      m_predictMonotonic(0),
+      m_generation(std::make_shared<std::atomic<int> >(0)),
+      m_nextListenerID(1),
+      m_resolverQuit(false),
+      m_synchronized(false),
+      m_offsetNs(0)
+{
+}
+
+NTPCoreSync::~NTPCoreSync()
+{
+    stop();
+
+    {
+        std::lock_guard<std::mutex> lock(m_lookupMutex);
+        m_resolverQuit = true;
+    }
+
+    m_lookupCondition.notify_one();
+
+    // A lookup in progress is waited for: the resolver thread posts to the loop until it ends.
+
+    if (m_resolver.joinable())
+    {
+        m_resolver.join();
+    }
+}
+
+void NTPCoreSync::setServers(const std::vector<std::string>& servers, uint16_t port)
+{
+    (*m_generation)++;
+
+    for (size_t i = 0 ; i < m_servers.size() ; ++i)
+    {
+        release(m_servers[i].get());
+        m_loop->killTimer(m_servers[i]->resendTimerID);
+    }
+
+    m_servers.clear();
+    m_port = port;
+
+    for (size_t i = 0 ; i < servers.size() ; ++i)
+    {
+        std::unique_ptr<Server> server(new Server);
+        server->host = servers[i];
+        server->exchange.setTimeoutBounds(m_timeoutFloor, m_timeoutCeiling);
+        m_servers.push_back(std::move(server));
+    }
+
+    // Keep the current offset until the new servers answer.
+
+    if (m_running)
+    {
+        sync();
+    }
+}
+
+void NTPCoreSync::setPollInterval(int64_t ms)
+{
+    m_pollInterval = ms;
+}
+
+void NTPCoreSync::setTimeoutBounds(int64_t floorMs, int64_t ceilingMs)
+{
+    m_timeoutFloor   = floorMs;
+    m_timeoutCeiling = ceilingMs;
+
+    for (size_t i = 0 ; i < m_servers.size() ; ++i)
+    {
+        m_servers[i]->exchange.setTimeoutBounds(m_timeoutFloor, m_timeoutCeiling);
+    }
+}
+
+void NTPCoreSync::start()
+{
+    stop();
+
+    // The first check detects a jump from zero: it starts the first synchronization.
+
+    m_running          = true;
+    m_predictRealtime  = 0;
+    m_predictMonotonic = NTPEventLoop::monotonicNs();
+    m_checkTimerID     = m_loop->startTimer(0, [this]() { check(); });
+}
+
+void NTPCoreSync::stop()
+{
+    m_running = false;
+    (*m_generation)++;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lookupMutex);
+        m_lookups.clear();
+    }
+
+    m_loop->killTimer(m_checkTimerID);
+    m_loop->killTimer(m_pollTimerID);
+    m_checkTimerID = 0;
+    m_pollTimerID  = 0;
+
+    for (size_t i = 0 ; i < m_servers.size() ; ++i)
+    {
+        release(m_servers[i].get());
+        m_loop->killTimer(m_servers[i]->resendTimerID);
+        m_servers[i]->resendTimerID = 0;
+    }
+}
+
+bool NTPCoreSync::isSynchronized() const
+{
+    return m_synchronized;
+}
+
+int64_t NTPCoreSync::offsetNs() const
+{
+    return (m_synchronized ? m_offsetNs.load() : 0);
+}
+
+int64_t NTPCoreSync::currentNSecsSinceEpoch() const
+{
+    return (NTPEventLoop::realtimeNs() + offsetNs());
+}
+
+void NTPCoreSync::check()
+{
+    const int64_t monotonic = NTPEventLoop::monotonicNs();
+    const int64_t realtime  = NTPEventLoop::realtimeNs();
+    const int64_t offset    = realtime - (m_predictRealtime + monotonic - m_predictMonotonic);
+    int64_t       interval  = core_check_interval;
+
+    if ((offset < -core_check_precision) || (offset > core_check_precision))
+    {
+        m_predictRealtime  = realtime;
+        m_predictMonotonic = monotonic;
+
+        // Local time jumped, the offset is wrong: resynchronize, and sleep before the next check.
+
+        interval           = core_check_sleep;
+        m_synchronized     = false;
+        m_offsetNs         = 0;
+
+        ntpClockPublish(0, false);
+        notify();
+        sync();
+    }
+
+    m_checkTimerID = m_loop->startTimer(interval, [this]() { check(); });
+}
+
+void NTPCoreSync::sync()
+{
+    m_samples.clear();
+
+    for (size_t i = 0 ; i < m_servers.size() ; ++i)
+    {
+        Server* const server = m_servers[i].get();
+
+        release(server);
+        m_loop->killTimer(server->resendTimerID);
+        server->resendTimerID = 0;
+        server->exchange.start();
+
+        resolve(server);
+    }
+
+    m_loop->killTimer(m_pollTimerID);
+    m_pollTimerID = 0;
+
+    if (m_pollInterval > 0)
+    {
+        m_pollTimerID = m_loop->startTimer(m_pollInterval, [this]() { m_pollTimerID = 0; sync(); });
+    }
+}
+
+void NTPCoreSync::resolve(Server* const server)
+{
+    Lookup lookup;
+    lookup.server     = server;
+    lookup.generation = *m_generation;
+    lookup.host       = server->host;
+    lookup.port       = std::to_string(m_port);
+
+    std::lock_guard<std::mutex> lock(m_lookupMutex);
+    m_lookups.push_back(lookup);
+
+    if (!m_resolver.joinable())
+    {
+        m_resolver = std::thread([this]() { resolveLoop(); });
+    }
+
+    m_lookupCondition.notify_one();
+}
+
+void NTPCoreSync::resolveLoop()
+{
+    while (true)
+    {
+        Lookup lookup;
+
+        {
+            std::unique_lock<std::mutex> lock(m_lookupMutex);
+            m_lookupCondition.wait(lock, [this]() { return (m_resolverQuit || !m_lookups.empty()); });
+
+            if (m_resolverQuit)
+            {
+                return;
+            }
+
+            lookup = m_lookups.front();
+            m_lookups.pop_front();
+        }
+
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+
+        struct addrinfo* result = nullptr;
+
+        if (getaddrinfo(lookup.host.c_str(), lookup.port.c_str(), &hints, &result) != 0)
+        {
+            result = nullptr;
+        }
+
+        // The addresses are freed with the task, even if the loop drops it without running it.
+        // This instance is used only if it did not stop since the request: the generation is
+        // shared, and this instance is destroyed from the loop thread, after stop().
+
+        std::shared_ptr<struct addrinfo>   addresses(result, s_coreFreeAddresses);
+        std::shared_ptr<std::atomic<int> > generation = m_generation;
+        Server* const                      server     = lookup.server;
+        const int                          current    = lookup.generation;
+
+        m_loop->post(
+            [this, server, generation, current, addresses]()
+            {
+                if (*generation == current)
+                {
+                    send(server, addresses.get());
+                }
+            }
+        );
+    }
+}
+
+void NTPCoreSync::send(Server* const server, const struct addrinfo* const addresses)
+{
+    for (const struct addrinfo* it = addresses ; it ; it = it->ai_next)
+    {
+        const int fd = socket(it->ai_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        if (connect(fd, it->ai_addr, it->ai_addrlen) != 0)
+        {
+            close(fd);
+            continue;
+        }
+
+        server->fd = fd;
+        break;
+    }
+
+    if (server->fd < 0)
+    {
+        fail(server);
+
+        return;
+    }
+
+    unsigned char request[NTP_CORE_PACKET_SIZE];
+    const size_t  size = server->exchange.request(request, NTPEventLoop::realtimeNs());
+
+    m_loop->addWatch(server->fd, EPOLLIN, [this, server](uint32_t) { receive(server); });
+    server->timeoutTimerID = m_loop->startTimer(server->exchange.timeout(), [this, server]() { server->timeoutTimerID = 0; fail(server); });
+
+    if (::send(server->fd, request, size, 0) != ssize_t(size))
+    {
+        fail(server);
+    }
+}
+
+void NTPCoreSync::receive(Server* const server)
+{
+    unsigned char buffer[512];
+
+    while (server->fd >= 0)
+    {
+        const ssize_t size      = recv(server->fd, buffer, sizeof(buffer), 0);
+        const int64_t receiveNs = NTPEventLoop::realtimeNs();
+
+        if (size < 0)
+        {
+            // ICMP errors of a connected socket are reported here, as ECONNREFUSED.
+
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+            {
+                fail(server);
+            }
+
+            return;
+        }
+
+        // Datagrams not matching the request are ignored, until the timeout.
+
+        if (server->exchange.response(buffer, size_t(size), receiveNs))
+        {
+            finish(server);
+
+            return;
+        }
+    }
+}
+
+void NTPCoreSync::finish(Server* const server)
+{
+    release(server);
+    update();
+}
+
+void NTPCoreSync::fail(Server* const server)
+{
+    release(server);
+
+    const int64_t delay   = server->exchange.fail();
+    server->resendTimerID = m_loop->startTimer(delay, [this, server]() { server->resendTimerID = 0; resolve(server); });
+}
+
+void NTPCoreSync::release(Server* const server)
+{
+    if (server->fd >= 0)
+    {
+        m_loop->removeWatch(server->fd);
+        close(server->fd);
+        server->fd = -1;
+    }
+
+    m_loop->killTimer(server->timeoutTimerID);
+    server->timeoutTimerID = 0;
+}
+
+void NTPCoreSync::update()
+{
+    m_samples.clear();
+
+    for (size_t i = 0 ; i < m_servers.size() ; ++i)
+    {
+        if (m_servers[i]->exchange.done())
+        {
+            m_samples.push_back(m_servers[i]->exchange.offsetNs());
+        }
+    }
+
+    m_offsetNs     = ntpCoreTrimmedMean(m_samples.data(), m_samples.size());
+    m_synchronized = true;
+
+    ntpClockPublish(m_offsetNs, true);
+    notify();
+}
+
+int NTPCoreSync::addOffsetListener(const NTPEventLoop::Callback& callback)
+{
+    const int id    = m_nextListenerID++;
+    m_listeners[id] = callback;
+
+    return id;
+}
+
+void NTPCoreSync::removeOffsetListener(int id)
+{
+    m_listeners.erase(id);
+}
+
+void NTPCoreSync::notify()
+{
+    // A listener can remove itself or another one.
+
+    const std::map<int, NTPEventLoop::Callback> listeners = m_listeners;
+
+    for (std::map<int, NTPEventLoop::Callback>::const_iterator it = listeners.begin() ; it != listeners.end() ; ++it)
+    {
+        if (m_listeners.count(it->first))
+        {
+            it->second();
+        }
+    }
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,152 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Synchronization with
+ *               a set of Ntp servers, driven by the core event loop.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_CORE_SYNC_H
+#define NTP_CORE_SYNC_H
+
+// C++ includes
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local includes
+
+#include "ntpcore.h"
+#include "ntpcoreloop.h"
+
+struct addrinfo;
+
+namespace QtSampleCodes
+{
+
+/**
+ * Network time without Qt: the counterpart of NTPTimeStamp for services which do not run
+ * a Qt event loop. All servers are queried at start(), and again when a jump of the local
+ * clock is detected, or each poll interval if set. Offsets of the servers answering are
+ * combined with a trimmed mean.
+ *
+ * Methods are called from the thread running the loop, and the loop must outlive this instance.
+ * Corrected time accessors are thread safe and lock free. Host lookups block: they run in one
+ * resolver thread, started at the first lookup and joined by the destructor.
+ */
+class NTPCoreSync
+{
+
+public:
+
+    explicit NTPCoreSync(NTPEventLoop* const loop);
+    ~NTPCoreSync();
+
+    /**
+     * Replace the Ntp servers, and resynchronize with them if started.
+     */
+    void     setServers(const std::vector<std::string>& servers, uint16_t port = 123);
+
+    /**
+     * Resynchronize each ms even if the local clock does not jump. 0 (default) disables it.
+     */
+    void     setPollInterval(int64_t ms);
+
+    /**
+     * Bounds of the adaptive response timeout of each server, in ms. See NTPCoreExchange::timeout().
+     */
+    void     setTimeoutBounds(int64_t floorMs, int64_t ceilingMs);
+
+    void     start();
+    void     stop();
+
+    /**
+     * Thread safe.
+     */
+    bool     isSynchronized()         const;
+    int64_t  offsetNs()               const;
+    int64_t  currentNSecsSinceEpoch() const;
+
+    /**
+     * Call callback each time the offset changes or is invalidated by a jump of the local clock.
+     * Return an identifier > 0 to use with removeOffsetListener().
+     */
+    int      addOffsetListener(const NTPEventLoop::Callback& callback);
+    void     removeOffsetListener(int id);
+
+private:
+
+    struct Server;
+
+    struct Lookup
+    {
+        Server*     server;
+        int         generation;
+        std::string host;
+        std::string port;
+    };
+
+    void     sync();
+    void     resolve(Server* const server);
+    void     resolveLoop();
+    void     send(Server* const server, const struct addrinfo* const addresses);
+    void     receive(Server* const server);
+    void     finish(Server* const server);
+    void     fail(Server* const server);
+    void     release(Server* const server);
+    void     update();
+    void     check();
+    void     notify();
+
+private:
+
+    NTPEventLoop* const                   m_loop;
+    std::vector<std::unique_ptr<Server> > m_servers;
+    uint16_t                              m_port;
+    int64_t                               m_pollInterval;
+    int64_t                               m_timeoutFloor;
+    int64_t                               m_timeoutCeiling;
+    bool                                  m_running;
+    int                                   m_checkTimerID;
+    int                                   m_pollTimerID;
+    int64_t                               m_predictRealtime;
+    int64_t                               m_predictMonotonic;
+    std::shared_ptr<std::atomic<int> >    m_generation;         ///< Drops host lookups finished after stop() or setServers().
+    std::vector<int64_t>                  m_samples;
+    std::map<int, NTPEventLoop::Callback> m_listeners;
+    int                                   m_nextListenerID;
+
+    std::thread                           m_resolver;
+    std::mutex                            m_lookupMutex;
+    std::condition_variable               m_lookupCondition;
+    std::deque<Lookup>                    m_lookups;            ///< Pending host lookups, guarded by m_lookupMutex.
+    bool                                  m_resolverQuit;       ///< Guarded by m_lookupMutex.
+
+    std::atomic<bool>                     m_synchronized;
+    std::atomic<int64_t>                  m_offsetNs;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_CORE_SYNC_H
@@ -0,0 +1,450 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Monitoring engine
+ *               polling a large number of Ntp servers.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpfleet.h"
+
+// C++ includes
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+// Qt includes
+
+#include <QDebug>
+#include <QUdpSocket>
+#include <QtEndian>
+
+// Local includes
+
+#include "ntpclock.h"
+#include "ntptrace.h"
+
+#define NTP_FLEET_RECEIVE_BUFFER    (4 * 1024 * 1024)       // Socket buffer absorbing bursts of responses
+
+namespace QtSampleCodes
+{
+
+bool s_isIPv4Mapped(const Q_IPV6ADDR& ip6)
+{
+    for (int i = 0 ; i < 10 ; ++i)
+    {
+        if (ip6.c[i] != 0)
+        {
+            return false;
+        }
+    }
+
+    return ((ip6.c[10] == 0xff) && (ip6.c[11] == 0xff));
+}
+
+QUdpSocket* s_bindSocket(QObject* const parent, const QHostAddress& any)
+{
+    QUdpSocket* const socket = new QUdpSocket(parent);
+
+    if (!socket->bind(any, 0))
+    {
+        qWarning() << "NTPFleet: cannot bind" << any << ":" << socket->errorString();
+        delete socket;
+
+        return nullptr;
+    }
+
+    socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, NTP_FLEET_RECEIVE_BUFFER);
+
+    return socket;
+}
+
+// ---------------------------------------------------------------------
+
+NTPFleet::NTPFleet(QObject* const parent)
+    : QObject(parent),
+      m_socket4(nullptr),
+      m_socket6(nullptr),
+      m_pollInterval(64000),
+      m_timeout(2000),
+      m_timerID(0),
+      m_timerDeadline(0),
+      m_running(false),
+      m_random(std::random_device()())
+{
+    m_nameOffsets << 0;
+}
+
+NTPFleet::~NTPFleet()
+{
+    stop();
+}
+
+int NTPFleet::addServer(const QHostAddress& address, quint16 port, const QString& name)
+{
+    const int    index = m_ports.size();
+    const qint64 now   = NTPClock::instance()->monotonicMSecs();
+
+    m_addresses   << address.toIPv6Address();
+    m_ports       << port;
+    m_states      << quint8(Idle);
+    m_stratums    << quint8(0);
+    m_deadlines   << now;
+    m_cookies     << quint32(0);
+    m_t0          << quint64(0);
+    m_offsets     << qint64(0);
+    m_delays      << qint64(0);
+    m_sent        << quint32(0);
+    m_received    << quint32(0);
+    m_timeouts    << quint32(0);
+    m_names.append(name.toUtf8());
+    m_nameOffsets << m_names.size();
+
+    if (m_running)
+    {
+        enqueue(index);
+        schedule(now);
+    }
+
+    return index;
+}
+
+int NTPFleet::count() const
+{
+    return m_ports.size();
+}
+
+void NTPFleet::setPollInterval(qint64 ms)
+{
+    m_pollInterval = qMax(qint64(1), ms);
+}
+
+void NTPFleet::setTimeout(qint64 ms)
+{
+    m_timeout = qMax(qint64(1), ms);
+}
+
+void NTPFleet::setCallback(const Callback& callback)
+{
+    m_callback = callback;
+}
+
+bool NTPFleet::start()
+{
+    stop();
+
+    m_socket4 = s_bindSocket(this, QHostAddress::AnyIPv4);
+    m_socket6 = s_bindSocket(this, QHostAddress::AnyIPv6);
+
+    if (!m_socket4 && !m_socket6)
+    {
+        return false;
+    }
+
+    if (m_socket4)
+    {
+        connect(m_socket4, SIGNAL(readyRead()),
+                this, SLOT(slotReadyRead()));
+    }
+
+    if (m_socket6)
+    {
+        connect(m_socket6, SIGNAL(readyRead()),
+                this, SLOT(slotReadyRead()));
+    }
+
+    // Spread first polls over one interval.
+
+    const qint64 now = NTPClock::instance()->monotonicMSecs();
+    const int    n   = count();
+
+    m_queue.clear();
+    m_queue.reserve(2 * n);
+
+    for (int i = 0 ; i < n ; ++i)
+    {
+        m_states[i]    = quint8(Idle);
+        m_deadlines[i] = now + m_pollInterval * i / n;
+        enqueue(i);
+    }
+
+    m_running = true;
+    service();
+
+    return true;
+}
+
+void NTPFleet::stop()
+{
+    m_running = false;
+
+    if (m_timerID != 0)
+    {
+        NTPClock::instance()->killTimer(m_timerID);
+        m_timerID = 0;
+    }
+
+    // Sockets can be stopped from the callback, while they are read.
+
+    if (m_socket4)
+    {
+        m_socket4->close();
+        m_socket4->deleteLater();
+    }
+
+    if (m_socket6)
+    {
+        m_socket6->close();
+        m_socket6->deleteLater();
+    }
+
+    m_socket4 = nullptr;
+    m_socket6 = nullptr;
+}
+
+QString NTPFleet::name(int index) const
+{
+    const int begin = m_nameOffsets.at(index);
+
+    return QString::fromUtf8(m_names.constData() + begin, m_nameOffsets.at(index + 1) - begin);
+}
+
+QHostAddress NTPFleet::address(int index) const
+{
+    const Q_IPV6ADDR& ip6 = m_addresses.at(index);
+
+    if (s_isIPv4Mapped(ip6))
+    {
+        return QHostAddress(qFromBigEndian<quint32>(ip6.c + 12));
+    }
+
+    return QHostAddress(ip6);
+}
+
+quint16 NTPFleet::port(int index) const
+{
+    return m_ports.at(index);
+}
+
+quint8 NTPFleet::stratum(int index) const
+{
+    return m_stratums.at(index);
+}
+
+quint32 NTPFleet::sent(int index) const
+{
+    return m_sent.at(index);
+}
+
+quint32 NTPFleet::received(int index) const
+{
+    return m_received.at(index);
+}
+
+quint32 NTPFleet::timeouts(int index) const
+{
+    return m_timeouts.at(index);
+}
+
+qint64 NTPFleet::offsetNs(int index) const
+{
+    return m_offsets.at(index);
+}
+
+qint64 NTPFleet::delayNs(int index) const
+{
+    return m_delays.at(index);
+}
+
+void NTPFleet::schedule(qint64 deadline)
+{
+    if ((m_timerID != 0) && (m_timerDeadline <= deadline))
+    {
+        return;
+    }
+
+    NTPClock* const clock = NTPClock::instance();
+
+    if (m_timerID != 0)
+    {
+        clock->killTimer(m_timerID);
+    }
+
+    m_timerDeadline = deadline;
+    m_timerID       = clock->startTimer(qMax(qint64(0), deadline - clock->monotonicMSecs()),
+                                        [this]() { m_timerID = 0; service(); });
+}
+
+void NTPFleet::enqueue(int index)
+{
+    m_queue.push_back(std::make_pair(m_deadlines.at(index), index));
+    std::push_heap(m_queue.begin(), m_queue.end(), std::greater<std::pair<qint64, int> >());
+}
+
+void NTPFleet::service()
+{
+    if (!m_running)
+    {
+        return;
+    }
+
+    const qint64 now = NTPClock::instance()->monotonicMSecs();
+
+    while (!m_queue.empty() && (m_queue.front().first <= now))
+    {
+        std::pop_heap(m_queue.begin(), m_queue.end(), std::greater<std::pair<qint64, int> >());
+        const std::pair<qint64, int> due = m_queue.back();
+        m_queue.pop_back();
+
+        const int i = due.second;
+
+        if (due.first != m_deadlines.at(i))
+        {
+            continue;
+        }
+
+        if (m_states[i] == Pending)
+        {
+            // Keep the poll phase of the server: next poll is one interval after the lost request.
+
+            m_timeouts[i]++;
+            m_states[i]    = quint8(Idle);
+            m_deadlines[i] = m_deadlines[i] - m_timeout + m_pollInterval;
+            enqueue(i);
+
+            if (m_callback)
+            {
+                m_callback(i, nullptr);
+
+                if (!m_running)
+                {
+                    return;
+                }
+            }
+        }
+
+        if ((m_states[i] == Idle) && (m_deadlines[i] <= now))
+        {
+            send(i, now);
+        }
+    }
+
+    if (!m_queue.empty())
+    {
+        schedule(m_queue.front().first);
+    }
+}
+
+void NTPFleet::send(int index, qint64 nowMs)
+{
+    const Q_IPV6ADDR& ip6 = m_addresses.at(index);
+    const bool        ip4 = s_isIPv4Mapped(ip6);
+    QUdpSocket* const udp = ip4 ? m_socket4 : m_socket6;
+
+    // Transmit timestamp is a nonce echoed by the server as origin timestamp: server index, then a cookie.
+
+    uchar request[48];
+    memset(request, 0, sizeof(request));
+    request[0]            = uchar((0 << 6) | (4 << 3) | 3);   // LI: no warning, version 4, mode: client
+
+    const quint32 cookie  = quint32(m_random());
+    qToBigEndian<quint32>(quint32(index), request + 40);
+    qToBigEndian<quint32>(cookie,         request + 44);
+
+    m_t0[index]           = ntpTimestampFromNs(NTPClock::instance()->currentNSecsSinceEpoch());
+    m_cookies[index]      = cookie;
+    m_states[index]       = quint8(Pending);
+    m_deadlines[index]    = nowMs + m_timeout;
+    m_sent[index]++;
+    enqueue(index);
+
+    // A request which cannot be sent is handled as lost.
+
+    if (udp)
+    {
+        udp->writeDatagram(reinterpret_cast<const char*>(request), sizeof(request),
+                           ip4 ? QHostAddress(qFromBigEndian<quint32>(ip6.c + 12)) : QHostAddress(ip6),
+                           m_ports.at(index));
+    }
+}
+
+void NTPFleet::slotReadyRead()
+{
+    receive(qobject_cast<QUdpSocket*>(sender()));
+}
+
+void NTPFleet::receive(QUdpSocket* const socket)
+{
+    if (!socket)
+    {
+        return;
+    }
+
+    NTPClock* const clock = NTPClock::instance();
+    char            buffer[512];
+    QHostAddress    peer;
+    quint16         peerPort = 0;
+
+    while (socket->hasPendingDatagrams())
+    {
+        const qint64 size      = socket->readDatagram(buffer, sizeof(buffer), &peer, &peerPort);
+        const qint64 receiveNs = clock->currentNSecsSinceEpoch();
+
+        if ((size < 48) || ((buffer[0] & 0x7) != 4))
+        {
+            continue;
+        }
+
+        const uchar* const data = reinterpret_cast<const uchar*>(buffer);
+        const quint32 index     = qFromBigEndian<quint32>(data + 24);
+
+        if ((index >= quint32(count()))                                    ||
+            (m_states.at(index)  != Pending)                               ||
+            (m_cookies.at(index) != qFromBigEndian<quint32>(data + 28))    ||
+            (m_ports.at(index)   != peerPort)                              ||
+            (memcmp(peer.toIPv6Address().c, m_addresses.at(index).c, 16) != 0))
+        {
+            continue;
+        }
+
+        // The response echoes the nonce: restore the real send time as t0.
+
+        NTPTraceRecord record;
+        record.setFromResponse(QByteArray::fromRawData(buffer, 48), peer, peerPort, receiveNs, clock->source());
+        record.t0              = m_t0.at(index);
+
+        m_states[index]        = quint8(Idle);
+        m_deadlines[index]     = m_deadlines.at(index) - m_timeout + m_pollInterval;
+        m_stratums[index]      = quint8(buffer[1]);
+        m_offsets[index]       = record.offsetNs();
+        m_delays[index]        = record.delayNs();
+        m_received[index]++;
+        enqueue(int(index));
+
+        if (m_callback)
+        {
+            m_callback(int(index), &record);
+
+            if (!m_running)
+            {
+                return;
+            }
+        }
+    }
+}
+
+} // namespace QtSampleCodes
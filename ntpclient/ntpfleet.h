@@ -0,0 +1,169 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Monitoring engine
+ *               polling a large number of Ntp servers.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_FLEET_H
+#define NTP_FLEET_H
+
+// C++ includes
+
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QObject>
+#include <QVector>
+
+class QUdpSocket;
+
+namespace QtSampleCodes
+{
+
+struct NTPTraceRecord;
+
+/**
+ * Poll thousands of Ntp servers from two sockets and one timer. Servers are not objects:
+ * the state of server i is at index i of contiguous arrays, so a scheduling pass only
+ * touches the next poll times and a response only touches one slot of each array.
+ *
+ * The transmit timestamp sent is a nonce made of the server index and a random cookie,
+ * the real send time is kept locally: a response is routed to its server without lookup.
+ */
+class NTPFleet : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Called for each completed exchange with its record, or with nullptr when the request timed out.
+     */
+    typedef std::function<void(int index, const NTPTraceRecord* record)> Callback;
+
+public:
+
+    explicit NTPFleet(QObject* const parent = nullptr);
+    ~NTPFleet();
+
+    /**
+     * Add a server to poll, return its index. Name is only kept for reports.
+     */
+    int          addServer(const QHostAddress& address, quint16 port = 123, const QString& name = QString());
+    int          count()                          const;
+
+    /**
+     * Poll interval of each server, and time to wait for a response. Default are 64 s and 2 s.
+     */
+    void         setPollInterval(qint64 ms);
+    void         setTimeout(qint64 ms);
+    void         setCallback(const Callback& callback);
+
+    /**
+     * Start polling, first polls are spread over one poll interval to not send bursts.
+     */
+    bool         start();
+    void         stop();
+
+public:
+
+    QString      name(int index)                  const;
+    QHostAddress address(int index)               const;
+    quint16      port(int index)                  const;
+    quint8       stratum(int index)               const;
+
+    quint32      sent(int index)                  const;
+    quint32      received(int index)              const;
+    quint32      timeouts(int index)              const;
+
+    /**
+     * Offset and round-trip delay of the last completed exchange with server, in nano-seconds.
+     */
+    qint64       offsetNs(int index)              const;
+    qint64       delayNs(int index)               const;
+
+private Q_SLOTS:
+
+    void slotReadyRead();
+
+private:
+
+    /**
+     * Send due requests, expire late ones, and arm the timer at the next deadline.
+     */
+    void         service();
+    void         schedule(qint64 deadline);
+
+    /**
+     * Queue the current deadline of server. Older entries of the server become stale.
+     */
+    void         enqueue(int index);
+    void         send(int index, qint64 nowMs);
+    void         receive(QUdpSocket* const socket);
+
+private:
+
+    enum State
+    {
+        Idle    = 0,
+        Pending = 1
+    };
+
+    // Per server state, index by index.
+
+    QVector<Q_IPV6ADDR> m_addresses;            ///< IPv4 are stored as IPv4-mapped IPv6.
+    QVector<quint16>    m_ports;
+    QVector<quint8>     m_states;
+    QVector<quint8>     m_stratums;
+    QVector<qint64>     m_deadlines;            ///< Monotonic ms: next poll when idle, timeout when pending.
+    QVector<quint32>    m_cookies;
+    QVector<quint64>    m_t0;                   ///< Local wall clock when the last request was sent.
+    QVector<qint64>     m_offsets;              ///< Result of the last completed exchange, in nano-seconds.
+    QVector<qint64>     m_delays;
+    QVector<quint32>    m_sent;
+    QVector<quint32>    m_received;
+    QVector<quint32>    m_timeouts;
+    QVector<int>        m_nameOffsets;          ///< Names are stored end to end in m_names.
+    QByteArray          m_names;
+
+    /**
+     * Min-heap of (deadline, server index): each wakeup only visits the due servers. An entry which does
+     * not match m_deadlines any more is dropped when it reaches the top.
+     */
+    std::vector<std::pair<qint64, int> > m_queue;
+
+    QUdpSocket*         m_socket4;
+    QUdpSocket*         m_socket6;
+    qint64              m_pollInterval;
+    qint64              m_timeout;
+    int                 m_timerID;
+    qint64              m_timerDeadline;
+    bool                m_running;
+    std::mt19937        m_random;
+    Callback            m_callback;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_FLEET_H
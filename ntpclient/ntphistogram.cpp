@@ -0,0 +1,179 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Latency histogram
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntphistogram.h"
+
+#define NTP_HISTOGRAM_SUB_BITS      7
+#define NTP_HISTOGRAM_SUB_COUNT     (1 << NTP_HISTOGRAM_SUB_BITS)
+#define NTP_HISTOGRAM_HALF_COUNT    (NTP_HISTOGRAM_SUB_COUNT / 2)
+#define NTP_HISTOGRAM_BUCKETS       (NTP_HISTOGRAM_SUB_COUNT + (64 - NTP_HISTOGRAM_SUB_BITS) * NTP_HISTOGRAM_HALF_COUNT)
+
+namespace QtSampleCodes
+{
+
+int s_mostSignificantBit(quint64 value)
+{
+
+#if defined(Q_CC_GNU) || defined(Q_CC_CLANG)
+
+    return (63 - __builtin_clzll(value));
+
+#else
+
+    int bit = 0;
+
+    while (value >>= 1)
+    {
+        ++bit;
+    }
+
+    return bit;
+
+#endif
+
+}
+
+// ---------------------------------------------------------------------
+
+NTPHistogram::NTPHistogram()
+    : m_counts(NTP_HISTOGRAM_BUCKETS, 0),
+      m_total(0),
+      m_min(0),
+      m_max(0),
+      m_sum(0.0)
+{
+}
+
+NTPHistogram::~NTPHistogram()
+{
+}
+
+int NTPHistogram::indexOf(quint64 value)
+{
+    if (value < NTP_HISTOGRAM_SUB_COUNT)
+    {
+        return int(value);
+    }
+
+    // Value is in [2^(exponent + SUB_BITS - 1), 2^(exponent + SUB_BITS)), mantissa keeps the SUB_BITS upper bits.
+
+    int     exponent = s_mostSignificantBit(value) - NTP_HISTOGRAM_SUB_BITS + 1;
+    quint64 mantissa = value >> exponent;
+
+    return (NTP_HISTOGRAM_SUB_COUNT + (exponent - 1) * NTP_HISTOGRAM_HALF_COUNT + int(mantissa - NTP_HISTOGRAM_HALF_COUNT));
+}
+
+quint64 NTPHistogram::highestEquivalentValue(int index)
+{
+    if (index < NTP_HISTOGRAM_SUB_COUNT)
+    {
+        return quint64(index);
+    }
+
+    int     exponent = (index - NTP_HISTOGRAM_SUB_COUNT) / NTP_HISTOGRAM_HALF_COUNT + 1;
+    quint64 mantissa = quint64((index - NTP_HISTOGRAM_SUB_COUNT) % NTP_HISTOGRAM_HALF_COUNT + NTP_HISTOGRAM_HALF_COUNT);
+
+    return ((mantissa << exponent) + (quint64(1) << exponent) - 1);
+}
+
+void NTPHistogram::record(qint64 value)
+{
+    value = qMax(value, qint64(0));
+
+    m_counts[indexOf(quint64(value))]++;
+
+    m_min  = (m_total == 0) ? value : qMin(m_min, value);
+    m_max  = (m_total == 0) ? value : qMax(m_max, value);
+    m_sum += double(value);
+    m_total++;
+}
+
+void NTPHistogram::merge(const NTPHistogram& other)
+{
+    if (other.m_total == 0)
+    {
+        return;
+    }
+
+    for (int i = 0 ; i < NTP_HISTOGRAM_BUCKETS ; ++i)
+    {
+        m_counts[i] += other.m_counts[i];
+    }
+
+    m_min    = (m_total == 0) ? other.m_min : qMin(m_min, other.m_min);
+    m_max    = (m_total == 0) ? other.m_max : qMax(m_max, other.m_max);
+    m_sum   += other.m_sum;
+    m_total += other.m_total;
+}
+
+void NTPHistogram::reset()
+{
+    m_counts.fill(0);
+    m_total = 0;
+    m_min   = 0;
+    m_max   = 0;
+    m_sum   = 0.0;
+}
+
+quint64 NTPHistogram::count() const
+{
+    return m_total;
+}
+
+qint64 NTPHistogram::min() const
+{
+    return m_min;
+}
+
+qint64 NTPHistogram::max() const
+{
+    return m_max;
+}
+
+double NTPHistogram::mean() const
+{
+    return ((m_total > 0) ? (m_sum / double(m_total)) : 0.0);
+}
+
+qint64 NTPHistogram::valueAtPercentile(double percentile) const
+{
+    if (m_total == 0)
+    {
+        return 0;
+    }
+
+    percentile      = qBound(0.0, percentile, 100.0);
+    quint64 target  = qMax(quint64(1), quint64(percentile / 100.0 * double(m_total) + 0.5));
+    quint64 counted = 0;
+
+    for (int i = 0 ; i < NTP_HISTOGRAM_BUCKETS ; ++i)
+    {
+        counted += m_counts[i];
+
+        if (counted >= target)
+        {
+            return qBound(m_min, qint64(highestEquivalentValue(i)), m_max);
+        }
+    }
+
+    return m_max;
+}
+
+} // namespace QtSampleCodes
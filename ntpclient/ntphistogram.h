@@ -0,0 +1,84 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Latency histogram
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_HISTOGRAM_H
+#define NTP_HISTOGRAM_H
+
+// Qt includes
+
+#include <QtGlobal>
+#include <QVector>
+
+namespace QtSampleCodes
+{
+
+/**
+ * HDR-style log-linear histogram of non-negative integer values (typically nano-seconds).
+ * Values lower than 2^NTP_HISTOGRAM_SUB_BITS are counted exactly, larger values are grouped
+ * in power of two ranges split in 2^(NTP_HISTOGRAM_SUB_BITS-1) linear sub-buckets. With 7 bits,
+ * the relative error of a reported value is lower than 2^-6, about 1.6%.
+ */
+class NTPHistogram
+{
+
+public:
+
+    explicit NTPHistogram();
+    ~NTPHistogram();
+
+    /**
+     * Count one occurrence of value. Negative values are counted as zero.
+     */
+    void    record(qint64 value);
+
+    /**
+     * Add all counts from other histogram to this one.
+     */
+    void    merge(const NTPHistogram& other);
+
+    void    reset();
+
+    quint64 count() const;
+    qint64  min()   const;
+    qint64  max()   const;
+    double  mean()  const;
+
+    /**
+     * Return the highest value equivalent to the bucket where the percentile (0.0 to 100.0) falls.
+     */
+    qint64  valueAtPercentile(double percentile) const;
+
+private:
+
+    static int     indexOf(quint64 value);
+    static quint64 highestEquivalentValue(int index);
+
+private:
+
+    QVector<quint64> m_counts;
+    quint64          m_total;
+    qint64           m_min;
+    qint64           m_max;
+    double           m_sum;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_HISTOGRAM_H
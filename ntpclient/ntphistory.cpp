@@ -0,0 +1,337 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - History of offsets
+ *               in delta-encoded rings of fixed memory.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntphistory.h"
+
+// C++ includes
+
+#include <limits>
+
+// Qt includes
+
+#include <QIODevice>
+#include <QTextStream>
+
+#define NTP_HISTORY_MAX_SAMPLE_SIZE 40      // 4 varints of 10 bytes at most
+
+namespace QtSampleCodes
+{
+
+void s_historyWriteVarint(QByteArray& data, qint64 value)
+{
+    // Zigzag: small negative values are small unsigned values.
+
+    quint64 bits = (quint64(value) << 1) ^ quint64(value >> 63);
+
+    while (bits >= 0x80)
+    {
+        data.append(char((bits & 0x7f) | 0x80));
+        bits >>= 7;
+    }
+
+    data.append(char(bits));
+}
+
+qint64 s_historyReadVarint(const char*& data)
+{
+    quint64 bits  = 0;
+    int     shift = 0;
+    uchar   byte  = 0;
+
+    do
+    {
+        byte   = uchar(*data++);
+        bits  |= quint64(byte & 0x7f) << shift;
+        shift += 7;
+    }
+    while ((byte & 0x80) && (shift < 64));
+
+    return qint64((bits >> 1) ^ (~(bits & 1) + 1));
+}
+
+// ---------------------------------------------------------------------
+
+NTPHistorySeries::NTPHistorySeries(int capacity)
+    : m_maxBlocks(1),
+      m_count(0)
+{
+    setCapacity(capacity);
+}
+
+NTPHistorySeries::~NTPHistorySeries()
+{
+}
+
+void NTPHistorySeries::setCapacity(int capacity)
+{
+    m_maxBlocks = qMax(1, capacity / NTP_HISTORY_BLOCK_SIZE);
+
+    while (m_blocks.size() > m_maxBlocks)
+    {
+        m_count -= m_blocks.takeFirst().count;
+    }
+}
+
+int NTPHistorySeries::capacity() const
+{
+    return (m_maxBlocks * NTP_HISTORY_BLOCK_SIZE);
+}
+
+void NTPHistorySeries::append(const NTPHistorySample& sample)
+{
+    if (m_blocks.isEmpty() || (m_blocks.last().data.size() > NTP_HISTORY_BLOCK_SIZE - NTP_HISTORY_MAX_SAMPLE_SIZE))
+    {
+        // Start a new block, with the memory of the oldest one when the ring is full.
+
+        Block block;
+
+        if (m_blocks.size() == m_maxBlocks)
+        {
+            block    = m_blocks.takeFirst();
+            m_count -= block.count;
+            block.data.resize(0);
+        }
+
+        block.data.reserve(NTP_HISTORY_BLOCK_SIZE);
+
+        // The first sample of a block is encoded as differences with zero.
+
+        const NTPHistorySample zero = { 0, 0, 0, 0 };
+
+        block.count   = 0;
+        block.minTime = sample.time;
+        block.maxTime = sample.time;
+        block.last    = zero;
+
+        m_blocks.append(block);
+    }
+
+    Block& block = m_blocks.last();
+
+    s_historyWriteVarint(block.data, sample.time     - block.last.time);
+    s_historyWriteVarint(block.data, sample.offsetNs - block.last.offsetNs);
+    s_historyWriteVarint(block.data, sample.delayNs  - block.last.delayNs);
+    s_historyWriteVarint(block.data, sample.errorNs  - block.last.errorNs);
+
+    block.last    = sample;
+    block.minTime = qMin(block.minTime, sample.time);
+    block.maxTime = qMax(block.maxTime, sample.time);
+    block.count++;
+    m_count++;
+}
+
+void NTPHistorySeries::clear()
+{
+    m_blocks.clear();
+    m_count = 0;
+}
+
+int NTPHistorySeries::count() const
+{
+    return m_count;
+}
+
+int NTPHistorySeries::memoryUsage() const
+{
+    return (m_blocks.size() * NTP_HISTORY_BLOCK_SIZE);
+}
+
+template <typename Visitor>
+void NTPHistorySeries::visit(qint64 from, qint64 to, Visitor visitor) const
+{
+    foreach (const Block& block, m_blocks)
+    {
+        if ((block.maxTime < from) || (block.minTime > to))
+        {
+            continue;
+        }
+
+        const char*      data   = block.data.constData();
+        NTPHistorySample sample = { 0, 0, 0, 0 };
+
+        for (int i = 0 ; i < block.count ; ++i)
+        {
+            sample.time     += s_historyReadVarint(data);
+            sample.offsetNs += s_historyReadVarint(data);
+            sample.delayNs  += s_historyReadVarint(data);
+            sample.errorNs  += s_historyReadVarint(data);
+
+            if ((sample.time >= from) && (sample.time <= to))
+            {
+                visitor(sample);
+            }
+        }
+    }
+}
+
+QVector<NTPHistorySample> NTPHistorySeries::range(qint64 from, qint64 to) const
+{
+    QVector<NTPHistorySample> samples;
+
+    visit(from, to, [&samples](const NTPHistorySample& sample) { samples.append(sample); });
+
+    return samples;
+}
+
+QVector<NTPHistoryBucket> NTPHistorySeries::downsample(qint64 from, qint64 to, qint64 bucketMs) const
+{
+    // Buckets by start time, with the sums of offsets and delays for the means.
+
+    QMap<qint64, NTPHistoryBucket>       buckets;
+    QMap<qint64, QPair<qint64, qint64> > sums;
+    bucketMs = qMax(Q_INT64_C(1), bucketMs);
+
+    visit(from, to,
+        [&](const NTPHistorySample& sample)
+        {
+            const qint64 start = from + (sample.time - from) / bucketMs * bucketMs;
+
+            if (!buckets.contains(start))
+            {
+                NTPHistoryBucket bucket;
+                bucket.start       = start;
+                bucket.count       = 0;
+                bucket.minOffsetNs = std::numeric_limits<qint64>::max();
+                bucket.maxOffsetNs = std::numeric_limits<qint64>::min();
+                bucket.minDelayNs  = std::numeric_limits<qint64>::max();
+                bucket.maxDelayNs  = std::numeric_limits<qint64>::min();
+                bucket.maxErrorNs  = std::numeric_limits<qint64>::min();
+                buckets[start]     = bucket;
+                sums[start]        = qMakePair(Q_INT64_C(0), Q_INT64_C(0));
+            }
+
+            NTPHistoryBucket&      bucket = buckets[start];
+            QPair<qint64, qint64>& sum    = sums[start];
+
+            bucket.count++;
+            bucket.minOffsetNs = qMin(bucket.minOffsetNs, sample.offsetNs);
+            bucket.maxOffsetNs = qMax(bucket.maxOffsetNs, sample.offsetNs);
+            bucket.minDelayNs  = qMin(bucket.minDelayNs,  sample.delayNs);
+            bucket.maxDelayNs  = qMax(bucket.maxDelayNs,  sample.delayNs);
+            bucket.maxErrorNs  = qMax(bucket.maxErrorNs,  sample.errorNs);
+            sum.first         += sample.offsetNs;
+            sum.second        += sample.delayNs;
+        }
+    );
+
+    QVector<NTPHistoryBucket> result;
+    result.reserve(buckets.size());
+
+    for (QMap<qint64, NTPHistoryBucket>::iterator it = buckets.begin() ; it != buckets.end() ; ++it)
+    {
+        const QPair<qint64, qint64>& sum = sums[it.key()];
+        it.value().meanOffsetNs          = sum.first  / it.value().count;
+        it.value().meanDelayNs           = sum.second / it.value().count;
+        result.append(it.value());
+    }
+
+    return result;
+}
+
+// ---------------------------------------------------------------------
+
+NTPHistory::NTPHistory()
+    : m_capacity(NTP_HISTORY_CAPACITY)
+{
+}
+
+NTPHistory::~NTPHistory()
+{
+    qDeleteAll(m_series);
+}
+
+void NTPHistory::setCapacity(int capacity)
+{
+    m_capacity = capacity;
+
+    foreach (NTPHistorySeries* const series, m_series)
+    {
+        series->setCapacity(m_capacity);
+    }
+}
+
+int NTPHistory::capacity() const
+{
+    return m_capacity;
+}
+
+void NTPHistory::addSample(int source, const NTPHistorySample& sample)
+{
+    NTPHistorySeries* series = m_series.value(source);
+
+    if (!series)
+    {
+        series           = new NTPHistorySeries(m_capacity);
+        m_series[source] = series;
+    }
+
+    series->append(sample);
+}
+
+void NTPHistory::remove(int source)
+{
+    delete m_series.take(source);
+}
+
+void NTPHistory::clear()
+{
+    qDeleteAll(m_series);
+    m_series.clear();
+}
+
+QList<int> NTPHistory::sources() const
+{
+    return m_series.keys();
+}
+
+const NTPHistorySeries* NTPHistory::series(int source) const
+{
+    return m_series.value(source);
+}
+
+bool NTPHistory::exportCsv(QIODevice* const device, qint64 from, qint64 to) const
+{
+    if (!device || !device->isWritable())
+    {
+        return false;
+    }
+
+    QTextStream stream(device);
+    stream << "source,time,offset_ns,delay_ns,error_ns\n";
+
+    for (QMap<int, NTPHistorySeries*>::const_iterator it = m_series.constBegin() ; it != m_series.constEnd() ; ++it)
+    {
+        foreach (const NTPHistorySample& sample, it.value()->range(from, to))
+        {
+            stream << it.key()        << ','
+                   << sample.time     << ','
+                   << sample.offsetNs << ','
+                   << sample.delayNs  << ','
+                   << sample.errorNs  << '\n';
+        }
+    }
+
+    stream.flush();
+
+    return (stream.status() == QTextStream::Ok);
+}
+
+} // namespace QtSampleCodes
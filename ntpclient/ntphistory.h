@@ -0,0 +1,181 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - History of offsets
+ *               in delta-encoded rings of fixed memory.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_HISTORY_H
+#define NTP_HISTORY_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QVector>
+
+#define NTP_HISTORY_BLOCK_SIZE      4096            // Bytes of a block, the unit dropped when a ring is full
+#define NTP_HISTORY_CAPACITY        (1 << 20)       // Bytes of each series by default
+#define NTP_HISTORY_COMBINED        -1              // Source of the combined offset series
+
+class QIODevice;
+
+namespace QtSampleCodes
+{
+
+/**
+ * One point of a series: local time of the measure in ms since Epoch, offset and round-trip
+ * delay in nano-seconds, and the bound of the offset error in nano-seconds.
+ */
+struct NTPHistorySample
+{
+    qint64 time;
+    qint64 offsetNs;
+    qint64 delayNs;
+    qint64 errorNs;
+};
+
+/**
+ * Aggregate of the samples of a series in [start, start + bucket duration).
+ */
+struct NTPHistoryBucket
+{
+    qint64 start;
+    int    count;
+    qint64 minOffsetNs;
+    qint64 maxOffsetNs;
+    qint64 meanOffsetNs;
+    qint64 minDelayNs;
+    qint64 maxDelayNs;
+    qint64 meanDelayNs;
+    qint64 maxErrorNs;
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Time series in a ring of blocks of NTP_HISTORY_BLOCK_SIZE bytes. Each sample is stored as
+ * the zigzag varint differences with the previous sample of its block, about 12 bytes by sample
+ * for a steady server: 1 MB holds 2 months of samples taken each 64 s. When all blocks are
+ * used, the oldest block is dropped.
+ *
+ * Times can go back after a jump of the local clock: queries filter samples by time, they
+ * are returned in insertion order.
+ */
+class NTPHistorySeries
+{
+
+public:
+
+    explicit NTPHistorySeries(int capacity = NTP_HISTORY_CAPACITY);
+    ~NTPHistorySeries();
+
+    /**
+     * Memory of the samples in bytes, rounded down to whole blocks, at least one block.
+     * Reducing the capacity drops the oldest blocks.
+     */
+    void                      setCapacity(int capacity);
+    int                       capacity()                                            const;
+
+    void                      append(const NTPHistorySample& sample);
+    void                      clear();
+
+    int                       count()                                               const;
+    int                       memoryUsage()                                         const;
+
+    /**
+     * Samples with time in [from, to].
+     */
+    QVector<NTPHistorySample> range(qint64 from, qint64 to)                         const;
+
+    /**
+     * Non-empty buckets of bucketMs with time in [from, to], sorted by start time.
+     */
+    QVector<NTPHistoryBucket> downsample(qint64 from, qint64 to, qint64 bucketMs)   const;
+
+private:
+
+    struct Block
+    {
+        QByteArray       data;
+        int              count;
+        qint64           minTime;
+        qint64           maxTime;
+        NTPHistorySample last;
+    };
+
+    /**
+     * Call visitor with each sample of blocks overlapping [from, to].
+     */
+    template <typename Visitor>
+    void                      visit(qint64 from, qint64 to, Visitor visitor)        const;
+
+private:
+
+    QList<Block>              m_blocks;             ///< Oldest block first.
+    int                       m_maxBlocks;
+    int                       m_count;
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Series of each server, identified by their index in the servers list, and of the combined
+ * offset with source NTP_HISTORY_COMBINED.
+ */
+class NTPHistory
+{
+
+public:
+
+    explicit NTPHistory();
+    ~NTPHistory();
+
+    /**
+     * Memory of each series in bytes, NTP_HISTORY_CAPACITY by default.
+     */
+    void                      setCapacity(int capacity);
+    int                       capacity()                                            const;
+
+    void                      addSample(int source, const NTPHistorySample& sample);
+    void                      remove(int source);
+    void                      clear();
+
+    /**
+     * Sources with a series, and the series of source, nullptr if none.
+     */
+    QList<int>                sources()                                             const;
+    const NTPHistorySeries*   series(int source)                                    const;
+
+    /**
+     * Write the samples of all series with time in [from, to] as CSV lines
+     * "source,time,offset_ns,delay_ns,error_ns", after a header line.
+     */
+    bool                      exportCsv(QIODevice* const device, qint64 from, qint64 to) const;
+
+private:
+
+    Q_DISABLE_COPY(NTPHistory)
+
+    QMap<int, NTPHistorySeries*> m_series;
+    int                          m_capacity;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_HISTORY_H
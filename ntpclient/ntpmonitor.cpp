@@ -0,0 +1,358 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Fleet monitor polling
+ *               a list of Ntp servers and streaming each exchange.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// C++ includes
+
+#include <cstdio>
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QHostInfo>
+#include <QStringList>
+#include <QVector>
+
+// Local includes
+
+#include "ntpfleet.h"
+#include "ntptrace.h"
+
+using namespace QtSampleCodes;
+
+/**
+ * Parse one server line: "host", "host:port", "[ipv6]:port" or a bare IPv6 address.
+ */
+bool s_parseServer(const QString& line, QString& host, quint16& port)
+{
+    host = line;
+    port = 123;
+
+    if (line.startsWith(QLatin1Char('[')))
+    {
+        const int end = line.indexOf(QLatin1Char(']'));
+
+        if (end < 0)
+        {
+            return false;
+        }
+
+        host = line.mid(1, end - 1);
+
+        if (line.mid(end + 1, 1) == QLatin1String(":"))
+        {
+            port = quint16(line.mid(end + 2).toUInt());
+        }
+    }
+    else if (line.count(QLatin1Char(':')) == 1)
+    {
+        host = line.section(QLatin1Char(':'), 0, 0);
+        port = quint16(line.section(QLatin1Char(':'), 1).toUInt());
+    }
+
+    return (!host.isEmpty() && (port != 0));
+}
+
+/**
+ * Resolve the server names of the list together: lookups run in the background and overlap,
+ * instead of waiting for each name in turn. Servers keep the order of the list.
+ */
+class NTPMonitorResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit NTPMonitorResolver(QObject* const parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+    void add(const QString& host, quint16 port)
+    {
+        QHostAddress address;
+
+        m_hosts << host;
+        m_ports << port;
+
+        if (address.setAddress(host))
+        {
+            m_addresses << address;
+
+            return;
+        }
+
+        m_addresses << QHostAddress();
+        m_lookups.insert(QHostInfo::lookupHost(host, this, SLOT(slotHostFound(QHostInfo))), m_hosts.size() - 1);
+    }
+
+    /**
+     * Wait for all lookups. Servers which cannot be resolved get a null address.
+     */
+    void wait()
+    {
+        if (!m_lookups.isEmpty())
+        {
+            m_loop.exec();
+        }
+    }
+
+    int count() const
+    {
+        return m_hosts.size();
+    }
+
+    QString host(int index) const
+    {
+        return m_hosts.at(index);
+    }
+
+    quint16 port(int index) const
+    {
+        return m_ports.at(index);
+    }
+
+    QHostAddress address(int index) const
+    {
+        return m_addresses.at(index);
+    }
+
+private Q_SLOTS:
+
+    void slotHostFound(const QHostInfo& info)
+    {
+        const int index = m_lookups.take(info.lookupId());
+
+        if (info.addresses().isEmpty())
+        {
+            qWarning() << "Ignore" << m_hosts.at(index) << ":" << info.errorString();
+        }
+        else
+        {
+            m_addresses[index] = info.addresses().first();
+        }
+
+        if (m_lookups.isEmpty())
+        {
+            m_loop.quit();
+        }
+    }
+
+private:
+
+    QStringList           m_hosts;
+    QVector<quint16>      m_ports;
+    QVector<QHostAddress> m_addresses;
+    QHash<int, int>       m_lookups;            ///< Lookup ID to server index.
+    QEventLoop            m_loop;
+};
+
+// ---------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("Poll a list of Ntp servers and stream the result of each exchange"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QLatin1String("servers"), QLatin1String("File with one server per line: host, host:port or [ipv6]:port. "
+                                                                         "Addresses are used as is, names are resolved once at startup."));
+
+    QCommandLineOption intvOpt(QLatin1String("interval"), QLatin1String("Poll interval of each server, in seconds."),          QLatin1String("s"),      QLatin1String("64"));
+    QCommandLineOption tmoOpt (QLatin1String("timeout"),  QLatin1String("Time to wait for a response, in ms."),                QLatin1String("ms"),     QLatin1String("2000"));
+    QCommandLineOption rndOpt (QLatin1String("rounds"),   QLatin1String("Stop after n polls of each server, 0 to run forever."), QLatin1String("n"),      QLatin1String("1"));
+    QCommandLineOption fmtOpt (QLatin1String("format"),   QLatin1String("Output format: csv, or binary trace records."),       QLatin1String("format"), QLatin1String("csv"));
+    QCommandLineOption outOpt (QLatin1String("output"),   QLatin1String("Output file, standard output by default."),           QLatin1String("file"));
+
+    parser.addOption(intvOpt);
+    parser.addOption(tmoOpt);
+    parser.addOption(rndOpt);
+    parser.addOption(fmtOpt);
+    parser.addOption(outOpt);
+    parser.process(app);
+
+    if (parser.positionalArguments().isEmpty())
+    {
+        parser.showHelp(-1);
+    }
+
+    const bool   binary = (parser.value(fmtOpt) == QLatin1String("binary"));
+    const qint64 rounds = parser.value(rndOpt).toLongLong();
+
+    if (!binary && (parser.value(fmtOpt) != QLatin1String("csv")))
+    {
+        qWarning() << "Unknown output format" << parser.value(fmtOpt);
+
+        return -1;
+    }
+
+    // Load servers.
+
+    QFile list(parser.positionalArguments().first());
+
+    if (!list.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qWarning() << "Cannot open" << list.fileName() << ":" << list.errorString();
+
+        return -1;
+    }
+
+    NTPMonitorResolver resolver;
+
+    while (!list.atEnd())
+    {
+        const QString line = QString::fromUtf8(list.readLine()).trimmed();
+        QString       host;
+        quint16       port = 0;
+
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')))
+        {
+            continue;
+        }
+
+        if (!s_parseServer(line, host, port))
+        {
+            qWarning() << "Ignore invalid server line:" << line;
+            continue;
+        }
+
+        resolver.add(host, port);
+    }
+
+    resolver.wait();
+
+    NTPFleet fleet;
+    fleet.setPollInterval(qint64(parser.value(intvOpt).toDouble() * 1000.0));
+    fleet.setTimeout(parser.value(tmoOpt).toLongLong());
+
+    for (int i = 0 ; i < resolver.count() ; ++i)
+    {
+        if (!resolver.address(i).isNull())
+        {
+            fleet.addServer(resolver.address(i), resolver.port(i), resolver.host(i));
+        }
+    }
+
+    if (fleet.count() == 0)
+    {
+        qWarning() << "No server to poll";
+
+        return -1;
+    }
+
+    // Open output.
+
+    QFile output;
+
+    if (parser.isSet(outOpt))
+    {
+        output.setFileName(parser.value(outOpt));
+
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qWarning() << "Cannot open" << output.fileName() << ":" << output.errorString();
+
+            return -1;
+        }
+    }
+    else if (!output.open(stdout, QIODevice::WriteOnly))
+    {
+        return -1;
+    }
+
+    if (!binary)
+    {
+        output.write("server,address,port,status,stratum,offset_ns,delay_ns,t0,t1,t2,t3\n");
+    }
+
+    // Stream each exchange. A binary output is a sequence of NTPTraceRecord, timeouts are not written.
+
+    const qint64 expected = rounds * fleet.count();
+    qint64       results  = 0;
+
+    fleet.setCallback(
+        [&](int index, const NTPTraceRecord* record)
+        {
+            if (binary)
+            {
+                if (record)
+                {
+                    output.write(reinterpret_cast<const char*>(record), sizeof(NTPTraceRecord));
+                }
+            }
+            else if (record)
+            {
+                output.write(QString::fromLatin1("%1,%2,%3,ok,%4,%5,%6,%7,%8,%9,%10\n")
+                             .arg(fleet.name(index)).arg(fleet.address(index).toString()).arg(fleet.port(index))
+                             .arg(uint(fleet.stratum(index))).arg(record->offsetNs()).arg(record->delayNs())
+                             .arg(record->t0).arg(record->t1).arg(record->t2).arg(record->t3).toUtf8());
+            }
+            else
+            {
+                output.write(QString::fromLatin1("%1,%2,%3,timeout,,,,,,,\n")
+                             .arg(fleet.name(index)).arg(fleet.address(index).toString()).arg(fleet.port(index)).toUtf8());
+            }
+
+            results++;
+
+            if ((expected > 0) && (results >= expected))
+            {
+                fleet.stop();
+                app.quit();
+            }
+        }
+    );
+
+    if (!fleet.start())
+    {
+        qWarning() << "Cannot open Udp sockets";
+
+        return -1;
+    }
+
+    qInfo().noquote() << "=== Polling" << fleet.count() << "servers";
+
+    app.exec();
+
+    output.close();
+
+    quint64 sent     = 0;
+    quint64 received = 0;
+
+    for (int i = 0 ; i < fleet.count() ; ++i)
+    {
+        sent     += fleet.sent(i);
+        received += fleet.received(i);
+    }
+
+    qInfo().noquote() << "=== Monitoring is complete!";
+    qInfo().noquote() << "> Requests sent            :" << sent;
+    qInfo().noquote() << "> Responses received       :" << received;
+
+    return 0;
+}
+
+#include "ntpmonitor.moc"
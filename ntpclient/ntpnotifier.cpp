@@ -20,9 +20,9 @@
 
 #include "ntpnotifier.h"
 
-// Qt includes
+// Local includes
 
-#include <QDateTime>
+#include "ntpclock.h"
 
 #define daemon_sleep        60000
 #define daemon_interval     1000
@@ -32,45 +32,66 @@ namespace QtSampleCodes
 {
 
 NTPNotifier::NTPNotifier(QObject* const parent)
-    : QThread(parent),
-      m_predictTimestamp(0)
+    : QObject(parent),
+      m_predictTimestamp(0),
+      m_predictMonotonic(0),
+      m_timerID(0)
 {
 }
 
-void NTPNotifier::run()
+NTPNotifier::~NTPNotifier()
 {
+    stop();
+}
+
+void NTPNotifier::start()
+{
+    stop();
+
     m_predictTimestamp = 0;
-    bool isSleep      = false;
+    m_predictMonotonic = NTPClock::instance()->monotonicMSecs();
+    m_timerID          = NTPClock::instance()->startTimer(0, [this]() { check(); });
+}
 
-    while (!isInterruptionRequested())
+void NTPNotifier::stop()
+{
+    if (m_timerID != 0)
     {
-        qint64 currentTS = QDateTime::currentMSecsSinceEpoch();
-        qint64 offset    = currentTS - m_predictTimestamp;
+        NTPClock::instance()->killTimer(m_timerID);
+        m_timerID = 0;
+    }
+}
 
-        if ((offset < -daemon_precision) || (offset > daemon_precision))
-        {
-            m_predictTimestamp = currentTS;
-            isSleep            = true;
+bool NTPNotifier::isRunning() const
+{
+    return (m_timerID != 0);
+}
+
+void NTPNotifier::check()
+{
+    NTPClock* const clock = NTPClock::instance();
+    qint64 monotonicTS    = clock->monotonicMSecs();
+    qint64 currentTS      = clock->currentMSecsSinceEpoch();
+    qint64 offset         = currentTS - (m_predictTimestamp + monotonicTS - m_predictMonotonic);
+    qint64 interval       = daemon_interval;
 
-            // Not as expected, indicating that the time stamp is not correct, resynchronize
+    if ((offset < -daemon_precision) || (offset > daemon_precision))
+    {
+        m_predictTimestamp = currentTS;
+        m_predictMonotonic = monotonicTS;
+
+        // If Ntp synchronization is performed, it will sleep for 60s before the next detection
 
-            emit signalLocaltimeChanged();
-        }
+        interval           = daemon_sleep;
+    }
 
-        if (isSleep)
-        {
-            // If Ntp synchronization is performed, it will sleep for 60s before the next detection
+    m_timerID = clock->startTimer(interval, [this]() { check(); });
 
-            msleep(daemon_sleep);
-            m_predictTimestamp += daemon_sleep;
-        }
-        else
-        {
-            msleep(daemon_interval);
-            m_predictTimestamp += daemon_interval;
-        }
+    if (interval == daemon_sleep)
+    {
+        // Not as expected, indicating that the time stamp is not correct, resynchronize
 
-        isSleep = false;
+        emit signalLocaltimeChanged();
     }
 }
 
@@ -24,30 +24,46 @@
 // Qt includes
 
 #include <QObject>
-#include <QThread>
 
 namespace QtSampleCodes
 {
 
-class NTPNotifier : public QThread
+/**
+ * Check periodically with NTPClock timers whether the local time jumped, comparing
+ * wall clock progress with monotonic time, and notify to resynchronize.
+ */
+class NTPNotifier : public QObject
 {
     Q_OBJECT
 
 public:
 
     explicit NTPNotifier(QObject* const parent = nullptr);
+    ~NTPNotifier();
+
+    /**
+     * Start checks. The first check always notifies to start the first synchronization.
+     */
+    void start();
+    void stop();
+    bool isRunning() const;
 
 Q_SIGNALS:
 
     void signalLocaltimeChanged();
 
-protected:
+private:
 
-    void run() Q_DECL_OVERRIDE;
+    void check();
 
 private:
 
+    /**
+     * Local time expected when monotonic time is m_predictMonotonic.
+     */
     qint64 m_predictTimestamp;
+    qint64 m_predictMonotonic;
+    int    m_timerID;
 };
 
 } // namespace QtSampleCodes
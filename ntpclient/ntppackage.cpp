@@ -22,31 +22,27 @@
 
 // Qt includes
 
-#include <QDateTime>
-#include <QTimer>
+#include <QtEndian>
+
+// Local includes
+
+#include "ntpclock.h"
 
 #define MS_JAN_1970                 0x20251FE2400L
-#define CURRENT_NTP_MILLION_SECOND  (MS_JAN_1970 + QDateTime::currentMSecsSinceEpoch())
+#define CURRENT_NTP_MILLION_SECOND  (MS_JAN_1970 + NTPClock::instance()->currentMSecsSinceEpoch())
 
 namespace QtSampleCodes
 {
 
-quint32 s_byteToUInt32(const QByteArray& bt)
+quint32 s_dataToUInt32(const uchar* data)
 {
-    quint32 value = 0;
-
-    for (int i = 0 ; i < 4 ; ++i)
-    {
-        value = (value << 8) + (bt[i] & 0xff);
-    }
-
-    return value;
+    return qFromBigEndian<quint32>(data);
 }
 
-qint64 s_byte64ToMillionSecond(const QByteArray& bt)
+qint64 s_data64ToMillionSecond(const uchar* data)
 {
-    quint32 second        = s_byteToUInt32(bt.left(4));
-    quint32 millionSecond = s_byteToUInt32(bt.mid(4, 4));
+    quint32 second        = s_dataToUInt32(data);
+    quint32 millionSecond = s_dataToUInt32(data + 4);
 
     return (second * 1000L + millionSecond * 1000L / (1L << 32));
 }
@@ -148,21 +144,28 @@ QByteArray NTPPackage::toByteArray()
 
 void NTPPackage::parseByByteArray(const QByteArray& bytes)
 {
+    parseByData(bytes.constData(), NTPClock::instance()->currentMSecsSinceEpoch());
+}
+
+void NTPPackage::parseByData(const char* data, qint64 receiveMSecsSinceEpoch)
+{
+    const uchar* const bytes    = reinterpret_cast<const uchar*>(data);
+
     m_li                        = quint8(bytes[0] >> 6 & 0x3);
     m_vn                        = quint8(bytes[0] >> 3 & 0x7);
     m_mode                      = quint8(bytes[0]      & 0x7);
     m_stratum                   = quint8(bytes[1]           );
     m_poll                      = quint8(bytes[2]           );
     m_precision                 = qint8 (bytes[3]           );
-    m_rootdelay                 = qint32(s_byteToUInt32(bytes.mid(4, 4)));
-    m_rootDispersion            = qint32(s_byteToUInt32(bytes.mid(8, 4)));
-    m_referenceIdentifier       = s_byteToUInt32(bytes.mid(12, 4));
-    m_referenceTimestamp        = s_byte64ToMillionSecond(bytes.mid(16, 8));
-    m_originTimestamp           = s_byte64ToMillionSecond(bytes.mid(24, 8));
-    m_receiveTimestamp          = s_byte64ToMillionSecond(bytes.mid(32, 8));
-    m_translateTimestamp        = s_byte64ToMillionSecond(bytes.mid(40, 8));
-    m_requestLocalTimestampByte = bytes.mid(24, 8);
-    m_currentLocalTimestamp     = CURRENT_NTP_MILLION_SECOND;
+    m_rootdelay                 = qint32(s_dataToUInt32(bytes + 4));
+    m_rootDispersion            = qint32(s_dataToUInt32(bytes + 8));
+    m_referenceIdentifier       = s_dataToUInt32(bytes + 12);
+    m_referenceTimestamp        = s_data64ToMillionSecond(bytes + 16);
+    m_originTimestamp           = s_data64ToMillionSecond(bytes + 24);
+    m_receiveTimestamp          = s_data64ToMillionSecond(bytes + 32);
+    m_translateTimestamp        = s_data64ToMillionSecond(bytes + 40);
+    m_requestLocalTimestampByte = QByteArray(data + 24, 8);
+    m_currentLocalTimestamp     = MS_JAN_1970 + receiveMSecsSinceEpoch;
 }
 
 qint64 NTPPackage::calcOffset() const
@@ -18,7 +18,7 @@
 #include <QUdpSocket>
 
 #define UDP_TIMEOUT                 30000
-#define UDP_RESEND_INTERVAL_COUNT   6
+#define UDP_ATTEMPT_DELAY           250     // Delay between two staggered attempts on server addresses (RFC 8305)
 
 namespace QtSampleCodes
 {
@@ -43,7 +43,6 @@ public:
      */
     void parseByByteArray(const QByteArray& bytes);
 
-
     /**
      * Calculate offset.
      */
@@ -54,6 +53,13 @@ public:
      */
     bool checkByOriginTimestamp(const QByteArray& ots) const;
 
+private:
+
+    /**
+     * Unpack a 48 bytes package in place, received at the local time receiveMSecsSinceEpoch.
+     */
+    void parseByData(const char* data, qint64 receiveMSecsSinceEpoch);
+
 public:
 
     /**
@@ -0,0 +1,233 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Ranking of Ntp servers
+ *               in a hot set polled normally and a cold set probed rarely.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpranking.h"
+
+// C++ includes
+
+#include <algorithm>
+
+// Qt includes
+
+#include <QtAlgorithms>
+
+#define NTP_RANK_UNKNOWN_SCORE      (Q_INT64_C(1) << 60)    // Not polled yet: better than unreachable, worse than any answer
+#define NTP_RANK_UNREACHABLE_SCORE  (Q_INT64_C(1) << 61)
+
+namespace QtSampleCodes
+{
+
+NTPRanking::NTPRanking()
+    : m_hotSetSize(NTP_RANK_HOT_SIZE)
+{
+}
+
+NTPRanking::~NTPRanking()
+{
+}
+
+void NTPRanking::reset(int count)
+{
+    m_delays.fill(0,   count);
+    m_jitters.fill(0,  count);
+    m_offsets.fill(0,  count);
+    m_stratums.fill(0, count);
+    m_reaches.fill(0,  count);
+    m_known.fill(0,    count);
+    m_hot.fill(0,      count);
+
+    update();
+}
+
+int NTPRanking::count() const
+{
+    return m_hot.size();
+}
+
+void NTPRanking::setHotSetSize(int size)
+{
+    m_hotSetSize = qMax(0, size);
+}
+
+int NTPRanking::hotSetSize() const
+{
+    return m_hotSetSize;
+}
+
+void NTPRanking::addSample(int source, qint64 offsetNs, qint64 delayNs, int stratum)
+{
+    if ((source < 0) || (source >= count()))
+    {
+        return;
+    }
+
+    delayNs = qMax(Q_INT64_C(0), delayNs);
+
+    if (!m_known[source] || (m_reaches[source] == 0))
+    {
+        m_delays[source]  = delayNs;
+        m_jitters[source] = 0;
+    }
+    else
+    {
+        // Exponential smoothing, with the weights used by Ntp for delay and jitter.
+
+        m_delays[source]  += (delayNs - m_delays[source]) / 8;
+        m_jitters[source] += (qAbs(offsetNs - m_offsets[source]) - m_jitters[source]) / 4;
+    }
+
+    m_offsets[source]  = offsetNs;
+    m_stratums[source] = quint8(stratum);
+    m_reaches[source]  = quint8((m_reaches[source] << 1) | 1);
+    m_known[source]    = 1;
+}
+
+void NTPRanking::addLoss(int source)
+{
+    if ((source < 0) || (source >= count()))
+    {
+        return;
+    }
+
+    m_reaches[source] = quint8(m_reaches[source] << 1);
+    m_known[source]   = 1;
+}
+
+bool NTPRanking::isKnown(int source) const
+{
+    return (m_known.value(source) != 0);
+}
+
+qint64 NTPRanking::score(int source) const
+{
+    if (!isKnown(source))
+    {
+        return NTP_RANK_UNKNOWN_SCORE;
+    }
+
+    const int answers = int(qPopulationCount(m_reaches.at(source)));
+
+    if (answers == 0)
+    {
+        return NTP_RANK_UNREACHABLE_SCORE;
+    }
+
+    const qint64 error = m_delays.at(source) / 2 + m_jitters.at(source) + m_stratums.at(source) * NTP_RANK_STRATUM_PENALTY;
+
+    return (error * 8 / answers);
+}
+
+bool NTPRanking::isHot(int source) const
+{
+    return (m_hot.value(source) != 0);
+}
+
+QList<int> NTPRanking::hotSet() const
+{
+    QList<int> sources;
+
+    for (int i = 0 ; i < m_hot.size() ; ++i)
+    {
+        if (m_hot.at(i))
+        {
+            sources << i;
+        }
+    }
+
+    return sources;
+}
+
+QSet<int> NTPRanking::hotSources() const
+{
+    QSet<int> sources;
+
+    for (int i = 0 ; i < m_hot.size() ; ++i)
+    {
+        if (m_hot.at(i))
+        {
+            sources.insert(i);
+        }
+    }
+
+    return sources;
+}
+
+QList<int> NTPRanking::coldSet() const
+{
+    QList<int> sources;
+
+    for (int i = 0 ; i < m_hot.size() ; ++i)
+    {
+        if (!m_hot.at(i))
+        {
+            sources << i;
+        }
+    }
+
+    return sources;
+}
+
+bool NTPRanking::update()
+{
+    const int n       = count();
+    const int size    = ((m_hotSetSize <= 0) || (m_hotSetSize >= n)) ? n : m_hotSetSize;
+    bool      changed = false;
+
+    // Hot servers sorted from worst to best, cold servers from best to worst. Equal scores keep the list order.
+
+    QList<int> hot  = hotSet();
+    QList<int> cold = coldSet();
+
+    std::stable_sort(hot.begin(),  hot.end(),  [this](int a, int b) { return (score(a) > score(b)); });
+    std::stable_sort(cold.begin(), cold.end(), [this](int a, int b) { return (score(a) < score(b)); });
+
+    while (hot.size() > size)
+    {
+        m_hot[hot.takeFirst()] = 0;
+        changed                = true;
+    }
+
+    while ((hot.size() < size) && !cold.isEmpty())
+    {
+        m_hot[cold.first()] = 1;
+        hot.append(cold.takeFirst());
+        changed             = true;
+    }
+
+    // Swap the best cold server with the worst hot one while it is clearly better.
+
+    while (!hot.isEmpty() && !cold.isEmpty() &&
+           (score(cold.first()) < score(hot.first()) / 100 * (100 - NTP_RANK_HYSTERESIS)))
+    {
+        const int promoted     = cold.takeFirst();
+        m_hot[hot.takeFirst()] = 0;
+        m_hot[promoted]        = 1;
+        hot.append(promoted);
+
+        std::stable_sort(hot.begin(), hot.end(), [this](int a, int b) { return (score(a) > score(b)); });
+
+        changed                = true;
+    }
+
+    return changed;
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,104 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Ranking of Ntp servers
+ *               in a hot set polled normally and a cold set probed rarely.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_RANKING_H
+#define NTP_RANKING_H
+
+// Qt includes
+
+#include <QList>
+#include <QSet>
+#include <QVector>
+
+#define NTP_RANK_HOT_SIZE           4           // Servers polled at each synchronization
+#define NTP_RANK_STRATUM_PENALTY    1000000LL   // Score added by stratum level, in ns
+#define NTP_RANK_HYSTERESIS         25          // A cold server must be this percent better than the worst hot one to replace it
+#define NTP_RANK_COLD_INTERVAL      900000      // Each cold server is probed once in this interval, in ms
+#define NTP_RANK_PROBE_INTERVAL     10000       // Cold probes are spread by slices sent at this interval, in ms
+
+namespace QtSampleCodes
+{
+
+/**
+ * Score servers by their recent results, and split them in a hot set of the best ones
+ * and a cold set. Servers are identified by their index in the servers list.
+ *
+ * The score estimates the error of a server, in nano-seconds, lower is better: half the
+ * smoothed round-trip delay, plus the smoothed jitter and a penalty by stratum level,
+ * scaled up by the losses among the last 8 polls as the reachability register of Ntp.
+ */
+class NTPRanking
+{
+
+public:
+
+    explicit NTPRanking();
+    ~NTPRanking();
+
+    /**
+     * Forget all results, for count servers. The first hotSetSize() servers are hot.
+     */
+    void       reset(int count);
+    int        count()                                                      const;
+
+    /**
+     * Number of hot servers, 0 for all.
+     */
+    void       setHotSetSize(int size);
+    int        hotSetSize()                                                 const;
+
+    void       addSample(int source, qint64 offsetNs, qint64 delayNs, int stratum);
+    void       addLoss(int source);
+
+    /**
+     * True if source was polled at least once.
+     */
+    bool       isKnown(int source)                                          const;
+    qint64     score(int source)                                            const;
+    bool       isHot(int source)                                            const;
+    QList<int> hotSet()                                                     const;
+    QList<int> coldSet()                                                    const;
+
+    /**
+     * hotSet() for lookups, without the QList::toSet() conversion deprecated by Qt.
+     */
+    QSet<int>  hotSources()                                                 const;
+
+    /**
+     * Promote or demote servers from their scores. Return true if the hot set changed.
+     */
+    bool       update();
+
+private:
+
+    QVector<qint64>  m_delays;               ///< Smoothed round-trip delay.
+    QVector<qint64>  m_jitters;              ///< Smoothed difference between two successive offsets.
+    QVector<qint64>  m_offsets;              ///< Last offset.
+    QVector<quint8>  m_stratums;
+    QVector<quint8>  m_reaches;              ///< One bit by poll, 1 if the server answered, last poll in bit 0.
+    QVector<quint8>  m_known;
+    QVector<quint8>  m_hot;
+    int              m_hotSetSize;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_RANKING_H
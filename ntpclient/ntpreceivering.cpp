@@ -0,0 +1,99 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Preallocated ring of received datagrams
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpreceivering.h"
+
+// Local includes
+
+#include "ntpclock.h"
+#include "ntptransport.h"
+
+namespace QtSampleCodes
+{
+
+NTPReceiveRing::NTPReceiveRing()
+    : m_head(0),
+      m_count(0)
+{
+}
+
+NTPReceiveRing::~NTPReceiveRing()
+{
+}
+
+int NTPReceiveRing::fill(NTPTransport* const transport)
+{
+    NTPClock* const clock = NTPClock::instance();
+    int             read  = 0;
+
+    while (!isFull() && transport->hasPendingDatagrams())
+    {
+        NTPReceiveSlot& slot = m_slots[(m_head + m_count) % NTP_RECEIVE_RING_SLOTS];
+        slot.size            = transport->readDatagram(slot.data, sizeof(slot.data));
+        slot.receiveNs       = clock->currentNSecsSinceEpoch();
+
+        if (slot.size < 0)
+        {
+            break;
+        }
+
+        m_count++;
+        read++;
+    }
+
+    return read;
+}
+
+bool NTPReceiveRing::isEmpty() const
+{
+    return (m_count == 0);
+}
+
+bool NTPReceiveRing::isFull() const
+{
+    return (m_count == NTP_RECEIVE_RING_SLOTS);
+}
+
+int NTPReceiveRing::count() const
+{
+    return m_count;
+}
+
+const NTPReceiveSlot& NTPReceiveRing::front() const
+{
+    return m_slots[m_head];
+}
+
+void NTPReceiveRing::pop()
+{
+    if (m_count > 0)
+    {
+        m_head = (m_head + 1) % NTP_RECEIVE_RING_SLOTS;
+        m_count--;
+    }
+}
+
+void NTPReceiveRing::clear()
+{
+    m_head  = 0;
+    m_count = 0;
+}
+
+} // namespace QtSampleCodes
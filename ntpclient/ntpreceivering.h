@@ -0,0 +1,84 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Preallocated ring of received datagrams
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_RECEIVE_RING_H
+#define NTP_RECEIVE_RING_H
+
+// Qt includes
+
+#include <QtGlobal>
+
+#define NTP_RECEIVE_SLOT_SIZE       64      // Ntp header and room to detect larger datagrams (extension fields, MAC)
+#define NTP_RECEIVE_RING_SLOTS      16
+
+namespace QtSampleCodes
+{
+
+class NTPTransport;
+
+/**
+ * One received datagram with its ancillary data.
+ */
+struct NTPReceiveSlot
+{
+    char   data[NTP_RECEIVE_SLOT_SIZE];
+    qint64 size;                        ///< Bytes read, datagrams larger than data are truncated to its size.
+    qint64 receiveNs;                   ///< Local wall clock when the datagram was read.
+};
+
+/**
+ * Fixed ring of datagram slots, allocated once. Datagrams are read in place in the slots
+ * and consumed from there, so draining a burst does not allocate nor copy.
+ * Not thread safe: filled and consumed by the same thread.
+ */
+class NTPReceiveRing
+{
+
+public:
+
+    explicit NTPReceiveRing();
+    ~NTPReceiveRing();
+
+    /**
+     * Read pending datagrams from transport until the ring is full. Return the number of datagrams read.
+     */
+    int                   fill(NTPTransport* const transport);
+
+    bool                  isEmpty()     const;
+    bool                  isFull()      const;
+    int                   count()       const;
+
+    /**
+     * Oldest datagram, valid until pop(). Ring must not be empty.
+     */
+    const NTPReceiveSlot& front()       const;
+    void                  pop();
+    void                  clear();
+
+private:
+
+    NTPReceiveSlot m_slots[NTP_RECEIVE_RING_SLOTS];
+    int            m_head;               ///< Index of the oldest datagram.
+    int            m_count;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_RECEIVE_RING_H
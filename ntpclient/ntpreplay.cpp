@@ -0,0 +1,214 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Replay recorded Ntp exchanges
+ *               through offset aggregation algorithms.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// C++ includes
+
+#include <cmath>
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QTextStream>
+#include <QVector>
+
+// Local includes
+
+#include "ntpaggregator.h"
+#include "ntptrace.h"
+
+using namespace QtSampleCodes;
+
+/**
+ * Decoded record: the replay loop only measures the aggregation.
+ */
+struct NTPReplaySample
+{
+    qint64 receiveNs;
+    qint64 offsetNs;
+    int    source;
+    bool   newRound;            ///< First sample of a synchronization round, the aggregator is reset before.
+};
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("Replay a Ntp trace through offset aggregation algorithms"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QLatin1String("trace"), QLatin1String("Trace file recorded with NTPTimeStamp::setTraceFile()."));
+
+    QCommandLineOption algoOpt (QLatin1String("algorithm"), QString::fromLatin1("Aggregation algorithm: %1, or all.").arg(NTPAggregator::names().join(QLatin1String(", "))),
+                                QLatin1String("name"), QLatin1String("all"));
+    QCommandLineOption roundOpt(QLatin1String("round"),     QLatin1String("Gap between two exchanges starting a new synchronization round, in ms."),
+                                QLatin1String("ms"),   QLatin1String("10000"));
+    QCommandLineOption loopOpt (QLatin1String("loops"),     QLatin1String("Replay the trace n times, to get stable timings."),
+                                QLatin1String("n"),    QLatin1String("1"));
+    QCommandLineOption csvOpt  (QLatin1String("csv"),       QLatin1String("Write receive time and combined offset of each exchange in file."),
+                                QLatin1String("file"));
+
+    parser.addOption(algoOpt);
+    parser.addOption(roundOpt);
+    parser.addOption(loopOpt);
+    parser.addOption(csvOpt);
+    parser.process(app);
+
+    if (parser.positionalArguments().isEmpty())
+    {
+        parser.showHelp(-1);
+    }
+
+    NTPTraceReader reader(parser.positionalArguments().first());
+
+    if (!reader.open())
+    {
+        return -1;
+    }
+
+    // Decode the trace once, servers are numbered by address and port.
+
+    const qint64             roundNs = parser.value(roundOpt).toLongLong() * 1000000LL;
+    qint64                   lastNs  = 0;
+    QHash<QByteArray, int>   sources;
+    QVector<NTPReplaySample> samples;
+    samples.reserve(int(reader.count()));
+
+    for (quint64 i = 0 ; i < reader.count() ; ++i)
+    {
+        const NTPTraceRecord* const record = reader.record(i);
+        QByteArray key(reinterpret_cast<const char*>(record->address), 16);
+        key.append(reinterpret_cast<const char*>(&record->port), sizeof(record->port));
+
+        QHash<QByteArray, int>::const_iterator it = sources.constFind(key);
+
+        if (it == sources.constEnd())
+        {
+            it = sources.insert(key, sources.size());
+        }
+
+        NTPReplaySample sample;
+        sample.receiveNs = ntpTimestampToNs(record->t3);
+        sample.offsetNs  = record->offsetNs();
+        sample.source    = it.value();
+        sample.newRound  = ((i == 0) || (sample.receiveNs - lastNs > roundNs));
+        lastNs           = sample.receiveNs;
+
+        samples << sample;
+    }
+
+    qInfo().noquote() << "=== Trace" << parser.positionalArguments().first() << ":"
+                      << samples.size() << "exchanges with" << sources.size() << "servers";
+
+    QStringList algorithms = NTPAggregator::names();
+
+    if (parser.value(algoOpt) != QLatin1String("all"))
+    {
+        algorithms = QStringList() << parser.value(algoOpt);
+    }
+
+    QFile       csvFile(parser.value(csvOpt));
+    QTextStream csv(&csvFile);
+
+    if (parser.isSet(csvOpt))
+    {
+        if (!csvFile.open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+            qWarning() << "Cannot write" << csvFile.fileName() << ":" << csvFile.errorString();
+
+            return -1;
+        }
+
+        csv << "algorithm,receive_ns,offset_ns\n";
+    }
+
+    const int loops = qMax(1, parser.value(loopOpt).toInt());
+
+    foreach (const QString& name, algorithms)
+    {
+        NTPAggregator* const aggregator = NTPAggregator::create(name);
+
+        if (!aggregator)
+        {
+            qWarning() << "Unknown algorithm" << name << ", use one of" << NTPAggregator::names();
+
+            return -1;
+        }
+
+        // Combined offset after each exchange, as NTPTimeStamp would publish it.
+
+        QVector<qint64> combined(samples.size());
+
+        QElapsedTimer timer;
+        timer.start();
+
+        for (int loop = 0 ; loop < loops ; ++loop)
+        {
+            for (int i = 0 ; i < samples.size() ; ++i)
+            {
+                const NTPReplaySample& sample = samples.at(i);
+
+                if (sample.newRound)
+                {
+                    aggregator->reset();
+                }
+
+                aggregator->addSample(sample.source, sample.offsetNs);
+                combined[i] = aggregator->offset();
+            }
+        }
+
+        const qint64 elapsedNs = qMax(qint64(1), timer.nsecsElapsed());
+        const double count     = double(samples.size()) * loops;
+
+        // Stability of the published offset: mean absolute step between two exchanges.
+
+        double steps = 0.0;
+
+        for (int i = 1 ; i < combined.size() ; ++i)
+        {
+            steps += std::fabs(double(combined[i] - combined[i - 1]));
+        }
+
+        qInfo().noquote() << QString::fromLatin1("> %1 : %2 ns/exchange, %3 exchanges/s, final offset %4 us, mean step %5 us")
+                             .arg(name, -14)
+                             .arg(double(elapsedNs) / qMax(1.0, count), 0, 'f', 1)
+                             .arg(count * 1.0e9 / double(elapsedNs),    0, 'f', 0)
+                             .arg(combined.isEmpty() ? 0.0 : double(combined.last()) / 1000.0, 0, 'f', 3)
+                             .arg((combined.size() > 1) ? steps / (combined.size() - 1) / 1000.0 : 0.0, 0, 'f', 3);
+
+        if (csvFile.isOpen())
+        {
+            for (int i = 0 ; i < samples.size() ; ++i)
+            {
+                csv << name << ',' << samples.at(i).receiveNs << ',' << combined.at(i) << '\n';
+            }
+        }
+
+        delete aggregator;
+    }
+
+    return 0;
+}
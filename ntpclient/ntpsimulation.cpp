@@ -0,0 +1,291 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Simulated Ntp servers
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntpsimulation.h"
+
+// C++ includes
+
+#include <cstring>
+
+// Qt includes
+
+#include <QPointer>
+#include <QtEndian>
+
+#define MS_JAN_1970                 0x20251FE2400L
+
+namespace QtSampleCodes
+{
+
+void s_writeNtpMillionSecond(QByteArray& bytes, int pos, qint64 ms)
+{
+    ms                   += MS_JAN_1970;
+    const quint32 second  = quint32(ms / 1000);
+    const quint32 frac    = quint32(quint64(ms % 1000) * (quint64(1) << 32) / 1000);
+
+    qToBigEndian<quint32>(second, reinterpret_cast<uchar*>(bytes.data() + pos));
+    qToBigEndian<quint32>(frac,   reinterpret_cast<uchar*>(bytes.data() + pos + 4));
+}
+
+// ---------------------------------------------------------------------
+
+NTPSimulatedNetwork::NTPSimulatedNetwork(NTPVirtualClock* const clock, quint32 seed)
+    : m_clock(clock),
+      m_random(seed),
+      m_requests(0),
+      m_responses(0)
+{
+}
+
+NTPSimulatedNetwork::~NTPSimulatedNetwork()
+{
+}
+
+void NTPSimulatedNetwork::setServer(const QString& host, const NTPSimulatedServer& server)
+{
+    m_servers[host] = server;
+}
+
+NTPSimulatedServer NTPSimulatedNetwork::server(const QString& host) const
+{
+    return m_servers.value(host);
+}
+
+bool NTPSimulatedNetwork::hasServer(const QString& host) const
+{
+    return m_servers.contains(host);
+}
+
+quint64 NTPSimulatedNetwork::requests() const
+{
+    return m_requests;
+}
+
+quint64 NTPSimulatedNetwork::responses() const
+{
+    return m_responses;
+}
+
+QList<qint64> NTPSimulatedNetwork::requestTimes(const QString& host) const
+{
+    return m_requestTimes.value(host);
+}
+
+NTPTransport* NTPSimulatedNetwork::createTransport(QObject* const parent)
+{
+    return new NTPSimulatedTransport(this, m_clock, parent);
+}
+
+qint64 NTPSimulatedNetwork::oneWayDelay(const NTPSimulatedServer& server)
+{
+    qint64 jitter = 0;
+
+    if (server.jitterMs > 0)
+    {
+        jitter = std::uniform_int_distribution<qint64>(0, server.jitterMs)(m_random);
+    }
+
+    return (server.delayMs / 2 + jitter);
+}
+
+bool NTPSimulatedNetwork::isLost(const NTPSimulatedServer& server)
+{
+    if (!server.reachable)
+    {
+        return true;
+    }
+
+    return ((server.lossRate > 0.0) && (std::uniform_real_distribution<double>(0.0, 1.0)(m_random) < server.lossRate));
+}
+
+void NTPSimulatedNetwork::sendRequest(NTPSimulatedTransport* const transport,
+                                      const QString& host,
+                                      const QByteArray& request)
+{
+    m_requests++;
+    m_requestTimes[host] << m_clock->monotonicMSecs();
+
+    const NTPSimulatedServer server = m_servers.value(host);
+
+    if ((request.size() < 48) || isLost(server))
+    {
+        return;
+    }
+
+    const qint64 requestDelay              = oneWayDelay(server);
+    const qint64 responseDelay             = oneWayDelay(server);
+    const bool   responseLost              = isLost(server);
+    QPointer<NTPSimulatedTransport> target = transport;
+
+    // Server side: the response is stamped with the server clock when the request arrives.
+
+    m_clock->startTimer(requestDelay,
+        [this, target, host, request, responseDelay, responseLost]()
+        {
+            const NTPSimulatedServer current = m_servers.value(host);
+            const qint64 serverMs            = m_clock->referenceMSecsSinceEpoch() + current.offsetMs;
+
+            QByteArray response(48, 0);
+            response[0]                      = char((request[0] & 0x38) | 4);     // Client version, mode: server
+            response[1]                      = char(current.stratum);
+            response[2]                      = request[2];
+            response[3]                      = char(-20);
+            response.replace(12, 4, "SIM", 4);
+            s_writeNtpMillionSecond(response, 16, serverMs);
+            response.replace(24, 8, request.constData() + 40, 8);
+            s_writeNtpMillionSecond(response, 32, serverMs);
+            s_writeNtpMillionSecond(response, 40, serverMs);
+
+            if (responseLost || !current.reachable)
+            {
+                return;
+            }
+
+            m_clock->startTimer(responseDelay,
+                [this, target, response]()
+                {
+                    if (target)
+                    {
+                        m_responses++;
+                        target->deliver(response);
+                    }
+                }
+            );
+        }
+    );
+}
+
+// ---------------------------------------------------------------------
+
+NTPSimulatedTransport::NTPSimulatedTransport(NTPSimulatedNetwork* const network,
+                                             NTPVirtualClock* const clock,
+                                             QObject* const parent)
+    : NTPTransport(parent),
+      m_network(network),
+      m_clock(clock),
+      m_port(0),
+      m_open(false)
+{
+}
+
+NTPSimulatedTransport::~NTPSimulatedTransport()
+{
+}
+
+void NTPSimulatedTransport::connectToHost(const QString& host, quint16 port)
+{
+    m_host                                 = host;
+    m_port                                 = port;
+    m_open                                 = true;
+    QPointer<NTPSimulatedTransport> target = this;
+    const bool known                       = m_network->hasServer(host);
+
+    // As QUdpSocket, the result of the host lookup is signaled asynchronously.
+
+    m_clock->startTimer(0,
+        [target, known]()
+        {
+            if (!target || !target->m_open)
+            {
+                return;
+            }
+
+            if (known)
+            {
+                emit target->signalConnected();
+            }
+            else
+            {
+                emit target->signalError(QAbstractSocket::HostNotFoundError);
+            }
+        }
+    );
+}
+
+void NTPSimulatedTransport::close()
+{
+    m_open = false;
+    m_pending.clear();
+}
+
+bool NTPSimulatedTransport::write(const QByteArray& datagram)
+{
+    if (!m_open)
+    {
+        return false;
+    }
+
+    m_network->sendRequest(this, m_host, datagram);
+
+    return true;
+}
+
+bool NTPSimulatedTransport::hasPendingDatagrams() const
+{
+    return !m_pending.isEmpty();
+}
+
+qint64 NTPSimulatedTransport::readDatagram(char* data, qint64 maxSize)
+{
+    if (m_pending.isEmpty())
+    {
+        return -1;
+    }
+
+    const QByteArray datagram = m_pending.takeFirst();
+    const qint64     size     = qMin(qint64(datagram.size()), maxSize);
+
+    memcpy(data, datagram.constData(), size_t(size));
+
+    return size;
+}
+
+QHostAddress NTPSimulatedTransport::peerAddress() const
+{
+    QHostAddress address;
+
+    if (!address.setAddress(m_host))
+    {
+        // Documentation range 192.0.2.0/24 for named simulated servers.
+
+        address.setAddress(quint32(0xC0000200 | (qHash(m_host) & 0xff)));
+    }
+
+    return address;
+}
+
+quint16 NTPSimulatedTransport::peerPort() const
+{
+    return m_port;
+}
+
+void NTPSimulatedTransport::deliver(const QByteArray& datagram)
+{
+    if (!m_open)
+    {
+        return;
+    }
+
+    m_pending << datagram;
+
+    emit signalReadyRead();
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,159 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Simulated Ntp servers
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_SIMULATION_H
+#define NTP_SIMULATION_H
+
+// C++ includes
+
+#include <random>
+
+// Qt includes
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Local includes
+
+#include "ntpclock.h"
+#include "ntptransport.h"
+
+namespace QtSampleCodes
+{
+
+/**
+ * Behavior of a simulated Ntp server.
+ */
+struct NTPSimulatedServer
+{
+    NTPSimulatedServer()
+        : offsetMs(0),
+          delayMs(20),
+          jitterMs(0),
+          lossRate(0.0),
+          reachable(true),
+          stratum(2)
+    {
+    }
+
+    qint64 offsetMs;                ///< Error of the server clock against true time.
+    qint64 delayMs;                 ///< Round-trip delay, half on each way.
+    qint64 jitterMs;                ///< Random extra delay on each way, up to jitterMs.
+    double lossRate;                ///< Probability to lose a request or a response.
+    bool   reachable;               ///< If false, all requests are lost.
+    quint8 stratum;
+};
+
+class NTPSimulatedTransport;
+
+/**
+ * Network of simulated Ntp servers answering in the time of a virtual clock.
+ * Random delays and losses use a fixed seed, so a scenario is reproducible.
+ */
+class NTPSimulatedNetwork : public NTPNetwork
+{
+
+public:
+
+    explicit NTPSimulatedNetwork(NTPVirtualClock* const clock, quint32 seed = 1);
+    ~NTPSimulatedNetwork();
+
+    void               setServer(const QString& host, const NTPSimulatedServer& server);
+    NTPSimulatedServer server(const QString& host)         const;
+    bool               hasServer(const QString& host)      const;
+
+    quint64            requests()                          const;
+    quint64            responses()                         const;
+
+    /**
+     * Monotonic times in ms of the requests sent to host, lost or not.
+     */
+    QList<qint64>      requestTimes(const QString& host)   const;
+
+    NTPTransport*      createTransport(QObject* const parent) Q_DECL_OVERRIDE;
+
+private:
+
+    friend class NTPSimulatedTransport;
+
+    /**
+     * Route a request from transport to server host, and schedule the response.
+     */
+    void               sendRequest(NTPSimulatedTransport* const transport,
+                                   const QString& host,
+                                   const QByteArray& request);
+
+    qint64             oneWayDelay(const NTPSimulatedServer& server);
+    bool               isLost(const NTPSimulatedServer& server);
+
+private:
+
+    NTPVirtualClock* const              m_clock;
+    QHash<QString, NTPSimulatedServer>  m_servers;
+    QHash<QString, QList<qint64> >      m_requestTimes;
+    std::mt19937                        m_random;
+    quint64                             m_requests;
+    quint64                             m_responses;
+};
+
+// ---------------------------------------------------------------------
+
+class NTPSimulatedTransport : public NTPTransport
+{
+    Q_OBJECT
+
+public:
+
+    explicit NTPSimulatedTransport(NTPSimulatedNetwork* const network,
+                                   NTPVirtualClock* const clock,
+                                   QObject* const parent = nullptr);
+    ~NTPSimulatedTransport();
+
+    void         connectToHost(const QString& host, quint16 port) Q_DECL_OVERRIDE;
+    void         close()                                          Q_DECL_OVERRIDE;
+
+    bool         write(const QByteArray& datagram)                Q_DECL_OVERRIDE;
+
+    bool         hasPendingDatagrams()                      const Q_DECL_OVERRIDE;
+    qint64       readDatagram(char* data, qint64 maxSize)         Q_DECL_OVERRIDE;
+
+    QHostAddress peerAddress()                              const Q_DECL_OVERRIDE;
+    quint16      peerPort()                                 const Q_DECL_OVERRIDE;
+
+private:
+
+    friend class NTPSimulatedNetwork;
+
+    void         deliver(const QByteArray& datagram);
+
+private:
+
+    NTPSimulatedNetwork* const m_network;
+    NTPVirtualClock* const     m_clock;
+    QString                    m_host;
+    quint16                    m_port;
+    bool                       m_open;
+    QList<QByteArray>          m_pending;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_SIMULATION_H
@@ -23,7 +23,13 @@
 // Qt includes
 
 #include <QMutex>
-#include <QDateTime>
+
+// Local includes
+
+#include "ntpaggregator.h"
+#include "ntpchrono.h"
+#include "ntpclock.h"
+#include "ntptrace.h"
 
 namespace QtSampleCodes
 {
@@ -43,78 +49,317 @@ NTPTimeStamp* NTPTimeStamp::instance()
 
 qint64 NTPTimeStamp::currentMSTimestamp()
 {
+    NTPClock* const clock = NTPClock::instance();
+
+    if (m_lazySync)
+    {
+        m_readMonotonic = clock->monotonicMSecs();
+
+        if (!m_syncDone)
+        {
+            queueRefresh();
+        }
+    }
+
     // Synchronization is not completed, directly return the current timestamp.
 
-    return (QDateTime::currentMSecsSinceEpoch() + (m_syncDone ? m_offsetTS : 0));
+    return (clock->currentMSecsSinceEpoch() + (m_syncDone ? m_offsetTS.load() : Q_INT64_C(0)));
+}
+
+qint64 NTPTimeStamp::currentMSTimestamp(qint64 maxStaleness)
+{
+    m_readMonotonic  = NTPClock::instance()->monotonicMSecs();
+    const qint64 age = syncAge();
+
+    if ((age < 0) || (age > maxStaleness))
+    {
+        queueRefresh();
+    }
+
+    return currentMSTimestamp();
+}
+
+qint64 NTPTimeStamp::syncAge() const
+{
+    const qint64 syncMonotonic = m_syncMonotonic;
+
+    if (!m_syncDone || (syncMonotonic < 0))
+    {
+        return -1;
+    }
+
+    return (NTPClock::instance()->monotonicMSecs() - syncMonotonic);
+}
+
+qint64 NTPTimeStamp::errorBound() const
+{
+    const qint64 age = syncAge();
+
+    if (age < 0)
+    {
+        return -1;
+    }
+
+    return (qMax(Q_INT64_C(0), m_bestDelayNs.load()) / 2000000LL + age * NTP_TS_DRIFT_PPM / 1000000LL);
+}
+
+qint64 NTPTimeStamp::bestDelayNs() const
+{
+    qint64 delayNs = -1;
+
+    for (QMap<NTPClient*, bool>::const_iterator it = m_ntpClients.constBegin() ; it != m_ntpClients.constEnd() ; ++it)
+    {
+        if (it.value() && it.key()->done() && m_hotSources.contains(m_sources.value(it.key())))
+        {
+            delayNs = (delayNs < 0) ? it.key()->delayNs() : qMin(delayNs, it.key()->delayNs());
+        }
+    }
+
+    return delayNs;
+}
+
+NTPHistory* NTPTimeStamp::history()
+{
+    return &m_history;
+}
+
+void NTPTimeStamp::setLazySync(bool lazy)
+{
+    m_lazySync = lazy;
 }
 
 NTPTimeStamp::NTPTimeStamp()
     : QObject (nullptr),
-      m_daemonThread(nullptr),
+      m_notifier(nullptr),
       m_syncDone(false),
-      m_offsetTS(0)
+      m_offsetTS(0),
+      m_syncMonotonic(-1),
+      m_refreshMonotonic(-1),
+      m_readMonotonic(-1),
+      m_bestDelayNs(-1),
+      m_lazySync(false),
+      m_refreshQueued(false),
+      m_timeoutFloor(NTP_CORE_MIN_TIMEOUT),
+      m_timeoutCeiling(NTP_CORE_TIMEOUT),
+      m_probeTimerID(0),
+      m_probeCursor(0),
+      m_aggregator(new NTPTrimmedMeanAggregator()),
+      m_trace(nullptr)
 {
 }
 
 NTPTimeStamp::~NTPTimeStamp()
 {
-    if (m_daemonThread)
+    if (m_notifier)
     {
-        m_daemonThread->requestInterruption();
-        m_daemonThread->quit();
-        m_daemonThread->wait();
-        m_daemonThread->deleteLater();
-        m_daemonThread = nullptr;
+        m_notifier->stop();
+        delete m_notifier;
+        m_notifier = nullptr;
+    }
+
+    if (m_probeTimerID)
+    {
+        NTPClock::instance()->killTimer(m_probeTimerID);
     }
 
     qDeleteAll(m_ntpClients.keys());
     m_ntpClients.clear();
+
+    delete m_aggregator;
+    delete m_trace;
 }
 
 void NTPTimeStamp::init()
 {
-    // Ntp server
+    // Standard Ntp time servers
 
-    m_ntpServers.clear();
+    setNtpServers(QStringList() << QLatin1String("fr.pool.ntp.org"));
 
-    // Standard Ntp time servers
+    // Start local time checks.
 
-    m_ntpServers.append("fr.pool.ntp.org");
+    m_notifier = new NTPNotifier(this);
+
+    connect(m_notifier, SIGNAL(signalLocaltimeChanged()),
+            this, SLOT(slotLocaltimeChanged()));
+
+    m_notifier->start();
+
+    // Start probes of cold servers.
+
+    probeColdServers();
+}
+
+QStringList NTPTimeStamp::ntpServers() const
+{
+    return m_ntpServers;
+}
+
+void NTPTimeStamp::setNtpServers(const QStringList& servers)
+{
+    // Ntp server
+
+    m_ntpServers = servers;
 
     // Ntp client
 
     qDeleteAll(m_ntpClients.keys());
     m_ntpClients.clear();
+    m_sources.clear();
+    m_sourceClients.clear();
+    m_aggregator->reset();
+    m_ranking.reset(m_ntpServers.size());
+    m_probeCursor = 0;
+
+    foreach (int source, m_history.sources())
+    {
+        if (source != NTP_HISTORY_COMBINED)
+        {
+            m_history.remove(source);
+        }
+    }
 
     foreach (const QString& host, m_ntpServers)
     {
         NTPClient* const client = new NTPClient(host);
 
+        client->setTraceWriter(m_trace);
+        client->setTimeoutBounds(m_timeoutFloor, m_timeoutCeiling);
+
         connect(client, SIGNAL(signalNtpFinished()),
                 this, SLOT(slotNTPFinished()));
 
+        connect(client, SIGNAL(signalNtpFailed()),
+                this, SLOT(slotNTPFailed()));
+
         m_ntpClients[client] = false;
+        m_sources[client]    = m_sourceClients.size();
+        m_sourceClients << client;
     }
 
-    // Start daemon thread.
+    m_hotSources = m_ranking.hotSources();
 
-    m_daemonThread = new NTPNotifier(this);
+    // Keep the current offset until the new servers answer. On demand, the next stale read resynchronizes.
 
-    connect(m_daemonThread, SIGNAL(signalLocaltimeChanged()),
-            this, SLOT(slotLocaltimeChanged()));
+    m_refreshMonotonic = -1;
 
-    m_daemonThread->start();
+    if (m_notifier && m_notifier->isRunning() && !m_lazySync)
+    {
+        refresh();
+    }
 }
 
-QStringList NTPTimeStamp::ntpServers() const
+void NTPTimeStamp::setHotSetSize(int size)
 {
-    return m_ntpServers;
+    m_ranking.setHotSetSize(size);
+
+    if (m_ranking.update())
+    {
+        applyRanking();
+    }
+}
+
+QStringList NTPTimeStamp::hotServers() const
+{
+    QStringList servers;
+
+    foreach (int source, m_ranking.hotSet())
+    {
+        servers << m_ntpServers.at(source);
+    }
+
+    return servers;
+}
+
+void NTPTimeStamp::setTimeoutBounds(qint64 floorMs, qint64 ceilingMs)
+{
+    m_timeoutFloor   = floorMs;
+    m_timeoutCeiling = ceilingMs;
+
+    foreach (NTPClient* const client, m_sourceClients)
+    {
+        client->setTimeoutBounds(m_timeoutFloor, m_timeoutCeiling);
+    }
+}
+
+void NTPTimeStamp::setAggregator(NTPAggregator* const aggregator)
+{
+    if (!aggregator || (aggregator == m_aggregator))
+    {
+        return;
+    }
+
+    delete m_aggregator;
+    m_aggregator = aggregator;
+
+    // Feed the new algorithm with the offsets of this round.
+
+    applyRanking();
+}
+
+bool NTPTimeStamp::setTraceFile(const QString& path)
+{
+    NTPTraceWriter* trace = nullptr;
+
+    if (!path.isEmpty())
+    {
+        trace = new NTPTraceWriter(path);
+
+        if (!trace->open())
+        {
+            delete trace;
+
+            return false;
+        }
+    }
+
+    for (QMap<NTPClient*, bool>::iterator it = m_ntpClients.begin() ; it != m_ntpClients.end() ; ++it)
+    {
+        it.key()->setTraceWriter(trace);
+    }
+
+    delete m_trace;
+    m_trace = trace;
+
+    return true;
 }
 
 void NTPTimeStamp::slotLocaltimeChanged()
 {
-    m_syncDone = false;
-    m_offsetTS = 0;
+    m_syncDone         = false;
+    m_offsetTS         = 0;
+    m_syncMonotonic    = -1;
+    m_refreshMonotonic = -1;
+
+    ntpClockPublish(0, false);
+
+    // On demand, the next read resynchronizes.
+
+    if (!m_lazySync)
+    {
+        refresh();
+    }
+}
+
+void NTPTimeStamp::queueRefresh()
+{
+    if (!m_refreshQueued.exchange(true))
+    {
+        QMetaObject::invokeMethod(this, "refresh", Qt::QueuedConnection);
+    }
+}
+
+void NTPTimeStamp::refresh()
+{
+    m_refreshQueued = false;
+
+    const qint64 now = NTPClock::instance()->monotonicMSecs();
+
+    if ((m_refreshMonotonic >= 0) && (now - m_refreshMonotonic < NTP_TS_REFRESH_TIMEOUT))
+    {
+        return;
+    }
+
+    m_refreshMonotonic = now;
 
     syncTimestamp();
 }
@@ -123,11 +368,89 @@ void NTPTimeStamp::syncTimestamp()
 {
     // qDebug() << "m_syncTimestamp :" << QDateTime::currentMSecsSinceEpoch() << ", " << QThread::currentThreadId();
 
+    m_aggregator->reset();
+
+    // Only the hot set is polled, cold servers are left to their probes.
+
     for (QMap<NTPClient*, bool>::iterator it = m_ntpClients.begin() ; it != m_ntpClients.end() ; ++it)
     {
         it.value() = false;
-        it.key()->start();
+
+        if (m_ranking.isHot(m_sources.value(it.key())))
+        {
+            it.key()->start();
+        }
+    }
+}
+
+void NTPTimeStamp::applyRanking()
+{
+    const QSet<int> now = m_ranking.hotSources();
+    bool            any = false;
+
+    m_aggregator->reset();
+
+    for (QMap<NTPClient*, bool>::iterator it = m_ntpClients.begin() ; it != m_ntpClients.end() ; ++it)
+    {
+        const int source = m_sources.value(it.key());
+
+        if (!now.contains(source))
+        {
+            // A demoted server does not retry anymore.
+
+            if (m_hotSources.contains(source) && !it.value())
+            {
+                it.key()->stop();
+            }
+        }
+        else if (it.value() && it.key()->done())
+        {
+            m_aggregator->addSample(source, it.key()->offsetNs());
+            any = true;
+        }
+        else if (!m_hotSources.contains(source) && m_notifier && m_notifier->isRunning())
+        {
+            // A promoted server has no offset for this round yet.
+
+            it.key()->start();
+        }
+    }
+
+    m_hotSources = now;
+
+    // Keep the current offset until a hot server answers.
+
+    if (m_syncDone && any)
+    {
+        m_offsetTS = m_aggregator->offset() / 1000000LL;
+        ntpClockPublish(m_aggregator->offset(), true);
+    }
+}
+
+void NTPTimeStamp::probeColdServers()
+{
+    const QList<int> cold = m_ranking.coldSet();
+    const qint64     read = m_readMonotonic;
+    const bool       idle = m_lazySync &&
+                            ((read < 0) || (NTPClock::instance()->monotonicMSecs() - read > NTP_RANK_COLD_INTERVAL));
+
+    // On demand, the cold set is not probed while nobody reads the time.
+
+    if (!cold.isEmpty() && !idle)
+    {
+        // Slices are sized to probe the whole cold set once in NTP_RANK_COLD_INTERVAL.
+
+        const int slices = NTP_RANK_COLD_INTERVAL / NTP_RANK_PROBE_INTERVAL;
+        const int size   = (cold.size() + slices - 1) / slices;
+
+        for (int i = 0 ; i < size ; ++i)
+        {
+            m_probeCursor = (m_probeCursor + 1) % cold.size();
+            m_sourceClients.at(cold.at(m_probeCursor))->start();
+        }
     }
+
+    m_probeTimerID = NTPClock::instance()->startTimer(NTP_RANK_PROBE_INTERVAL, [this]() { probeColdServers(); });
 }
 
 void NTPTimeStamp::slotNTPFinished()
@@ -146,8 +469,27 @@ void NTPTimeStamp::slotNTPFinished()
         return;
     }
 
+    const int source        = m_sources.value(ntpSender);
     m_ntpClients[ntpSender] = true;
 
+    m_ranking.addSample(source, ntpSender->offsetNs(), ntpSender->delayNs(), ntpSender->stratum());
+
+    const qint64     now    = NTPClock::instance()->currentMSecsSinceEpoch();
+    NTPHistorySample sample = { now, ntpSender->offsetNs(), ntpSender->delayNs(), ntpSender->delayNs() / 2 };
+    m_history.addSample(source, sample);
+
+    if (m_ranking.update())
+    {
+        applyRanking();
+    }
+
+    // The answer of a cold probe only updates its score.
+
+    if (!m_ranking.isHot(source))
+    {
+        return;
+    }
+
 /*
     // Traverse all
 
@@ -167,47 +509,47 @@ void NTPTimeStamp::slotNTPFinished()
     m_syncDone = finished;
 */
 
-    m_syncDone = true;
+    m_syncDone         = true;
+    m_syncMonotonic    = NTPClock::instance()->monotonicMSecs();
+    m_refreshMonotonic = -1;
 
     // Calculate the average deviation.
 
-    qint64 totaloffset = 0;
-    qint64 maxoffset   = 0;
-    qint64 minoffset   = INT64_MAX;
-    qint8 validCount   = 0;
+    m_aggregator->addSample(source, ntpSender->offsetNs());
+    m_offsetTS = m_aggregator->offset() / 1000000LL;
+    ntpClockPublish(m_aggregator->offset(), true);
 
-    for (QMap<NTPClient*, bool>::iterator it = m_ntpClients.begin() ; it != m_ntpClients.end() ; ++it)
-    {
-        if (!it.value())
-        {
-            continue;
-        }
+    const qint64     delayNs  = bestDelayNs();
+    m_bestDelayNs             = delayNs;
 
-        if (!it.key()->done())
-        {
-            continue;
-        }
-
-        qint64 os    = it.key()->offset();
-        totaloffset += os;
+    NTPHistorySample combined = { now, m_aggregator->offset(), delayNs, delayNs / 2 };
+    m_history.addSample(NTP_HISTORY_COMBINED, combined);
+}
 
-        maxoffset    = qMax(maxoffset, os);
-        minoffset    = qMin(minoffset, os);
+void NTPTimeStamp::slotNTPFailed()
+{
+    NTPClient* const ntpSender = qobject_cast<NTPClient*>(sender());
 
-        ++validCount;
+    if (!ntpSender || !m_ntpClients.contains(ntpSender))
+    {
+        return;
     }
 
-    // Remove the maximum value and remove the minimum value before taking the average. If 10 are full, there are 8 left.
+    const int source = m_sources.value(ntpSender);
+
+    m_ranking.addLoss(source);
 
-    if (validCount > 2)
+    // A hot server retries with its backoff, a cold probe is not repeated before its next slice.
+
+    if (!m_ranking.isHot(source))
     {
-        totaloffset -= (maxoffset + minoffset);
-        validCount  -= 2;
+        ntpSender->stop();
     }
 
-    m_offsetTS = (validCount > 0) ? ((validCount == 8) ? (totaloffset >> 3)
-                                                       :  totaloffset / validCount)
-                                  : 0;
+    if (m_ranking.update())
+    {
+        applyRanking();
+    }
 }
 
 } // namespace QtSampleCodes
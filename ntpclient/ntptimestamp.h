@@ -21,6 +21,10 @@
 #ifndef NTP_TIMESTAMP_H
 #define NTP_TIMESTAMP_H
 
+// C++ includes
+
+#include <atomic>
+
 // Qt includes
 
 #include <QtCore>
@@ -29,10 +33,18 @@
 
 #include "ntpnotifier.h"
 #include "ntpclient.h"
+#include "ntphistory.h"
+#include "ntpranking.h"
+
+#define NTP_TS_DRIFT_PPM            15      // Frequency tolerance of the local clock used by errorBound(), as Ntp
+#define NTP_TS_REFRESH_TIMEOUT      NTP_CORE_TIMEOUT
 
 namespace QtSampleCodes
 {
 
+class NTPAggregator;
+class NTPTraceWriter;
+
 class NTPTimeStamp : public QObject
 {
     Q_OBJECT
@@ -42,10 +54,74 @@ public:
     static NTPTimeStamp* instance();
     ~NTPTimeStamp();
 
+    /**
+     * Thread safe, as the time accessors below: a refresh needed by a read is queued to the
+     * thread of this object.
+     */
     qint64 currentMSTimestamp();
 
+    /**
+     * Network time, refreshed if the last synchronization is older than maxStaleness ms.
+     * The refresh runs in background and the current estimate is returned without waiting.
+     * Concurrent refreshes are coalesced: one at a time, until a hot server answers.
+     */
+    qint64 currentMSTimestamp(qint64 maxStaleness);
+
+    /**
+     * Age of the last synchronization in ms, -1 if not synchronized.
+     */
+    qint64 syncAge() const;
+
+    /**
+     * Bound of the error of currentMSTimestamp() in ms: half the best round-trip delay of the
+     * last synchronization, plus the drift of the local clock since. -1 if not synchronized.
+     */
+    qint64 errorBound() const;
+
+    /**
+     * Synchronize only on demand (default false). The local time checks and the cold server
+     * probes then do no network work while nobody reads the time: a jump of the local time
+     * only invalidates the offset, and the next read refreshes it.
+     */
+    void setLazySync(bool lazy);
+
     QStringList ntpServers() const;
 
+    /**
+     * Replace the Ntp servers, and resynchronize with them if the local time checks are started.
+     */
+    void setNtpServers(const QStringList& servers);
+
+    /**
+     * Number of best servers polled at each synchronization, 0 for all. Default is NTP_RANK_HOT_SIZE.
+     * The other servers are probed once each NTP_RANK_COLD_INTERVAL, and replace a hot server
+     * when they get a clearly better score.
+     */
+    void setHotSetSize(int size);
+    QStringList hotServers() const;
+
+    /**
+     * Bounds of the adaptive response timeout of each server in ms, see NTPCoreExchange::timeout().
+     * Default are NTP_CORE_MIN_TIMEOUT and NTP_CORE_TIMEOUT.
+     */
+    void setTimeoutBounds(qint64 floorMs, qint64 ceilingMs);
+
+    /**
+     * History of the offsets of each server, by index in ntpServers(), and of the combined offset.
+     * Series of the servers are cleared when the servers are replaced.
+     */
+    NTPHistory* history();
+
+    /**
+     * Replace the algorithm combining server offsets. Aggregator is owned by this instance.
+     */
+    void setAggregator(NTPAggregator* const aggregator);
+
+    /**
+     * Record all completed exchanges in a binary trace file, an empty path stops recording.
+     */
+    bool setTraceFile(const QString& path);
+
 private:
 
     NTPTimeStamp();
@@ -53,33 +129,91 @@ private:
     void init();
     void syncTimestamp();
 
+    /**
+     * Start a synchronization unless one is already running.
+     */
+    Q_INVOKABLE void refresh();
+
+    /**
+     * From any thread: refresh() in the thread of this object, once for concurrent reads.
+     */
+    void queueRefresh();
+
+    /**
+     * Start promoted servers, stop demoted ones, and combine the offsets of the hot set again.
+     */
+    void applyRanking();
+    void probeColdServers();
+
+    /**
+     * Lowest round-trip delay of the hot servers done since the last synchronization, -1 if none.
+     * In the thread of this object only: readers use m_bestDelayNs.
+     */
+    qint64 bestDelayNs() const;
+
 private Q_SLOTS:
 
     void slotLocaltimeChanged();
     void slotNTPFinished();
+    void slotNTPFailed();
 
 private:
 
     /**
-     * The thread checks whether there is a deviation in the local time, and if necessary, it will resynchronize the time.
+     * Checks whether there is a deviation in the local time, and if necessary, it will resynchronize the time.
      */
-    NTPNotifier*           m_daemonThread;
+    NTPNotifier*           m_notifier;
 
     /**
      * Synchronization is not completed, take local time directly.
      */
-    bool                   m_syncDone;
+    std::atomic<bool>      m_syncDone;
 
     /**
      * Deviation from network time.
      */
-    qint64                 m_offsetTS;
+    std::atomic<qint64>    m_offsetTS;
+
+    /**
+     * Monotonic times in ms of the last synchronization, of the running refresh, and of the
+     * last read of the time. -1 if none. The readers only use the atomic members.
+     */
+    std::atomic<qint64>    m_syncMonotonic;
+    qint64                 m_refreshMonotonic;
+    std::atomic<qint64>    m_readMonotonic;
+    std::atomic<qint64>    m_bestDelayNs;    ///< bestDelayNs() at the last synchronization, for errorBound().
+    std::atomic<bool>      m_lazySync;
+    std::atomic<bool>      m_refreshQueued;
 
     /**
      * Hosts list.
      */
     QStringList            m_ntpServers;
     QMap<NTPClient*, bool> m_ntpClients;
+    QHash<NTPClient*, int> m_sources;        ///< Index of the client server in m_ntpServers.
+    QVector<NTPClient*>    m_sourceClients;
+    qint64                 m_timeoutFloor;
+    qint64                 m_timeoutCeiling;
+
+    /**
+     * Hot set of servers used for synchronization, and slices of cold servers probed by the timer.
+     */
+    NTPRanking             m_ranking;
+    QSet<int>              m_hotSources;     ///< Hot set applied to the clients.
+    int                    m_probeTimerID;
+    int                    m_probeCursor;
+
+    /**
+     * Combine the offsets of the clients done since the last synchronization.
+     */
+    NTPAggregator*         m_aggregator;
+
+    NTPHistory             m_history;
+
+    /**
+     * Optional record of exchanges.
+     */
+    NTPTraceWriter*        m_trace;
 };
 
 } // namespace QtSampleCodes
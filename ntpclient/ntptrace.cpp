@@ -0,0 +1,332 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Binary trace of Ntp exchanges
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntptrace.h"
+
+// C++ includes
+
+#include <cstring>
+
+// Qt includes
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QtEndian>
+
+// Local includes
+
+#include "ntpcore.h"
+
+#define NTP_TRACE_MAGIC             "NTPTRACE"
+#define NTP_TRACE_VERSION           1
+#define NTP_TRACE_CHUNK             4096                    // Records added each time the file grows
+
+namespace QtSampleCodes
+{
+
+/**
+ * File header, followed by the records.
+ */
+struct NTPTraceHeader
+{
+    char    magic[8];
+    quint32 version;
+    quint32 recordSize;
+    quint64 count;
+};
+
+Q_STATIC_ASSERT(sizeof(NTPTraceHeader) == 24);
+Q_STATIC_ASSERT(sizeof(NTPTraceRecord) == 104);
+
+quint64 ntpTimestampFromNs(qint64 ns)
+{
+    return ntpCoreTimestampFromNs(ns);
+}
+
+qint64 ntpTimestampToNs(quint64 ts)
+{
+    return ntpCoreTimestampToNs(ts);
+}
+
+// ---------------------------------------------------------------------
+
+QHostAddress NTPTraceRecord::serverAddress() const
+{
+    Q_IPV6ADDR ip6;
+    memcpy(ip6.c, address, 16);
+
+    QHostAddress host(ip6);
+    bool         isIPv4 = false;
+    quint32      ip4    = host.toIPv4Address(&isIPv4);
+
+    return (isIPv4 ? QHostAddress(ip4) : host);
+}
+
+qint64 NTPTraceRecord::offsetNs() const
+{
+    // offset = ((t1 - t0) + (t2 - t3)) / 2
+
+    return ((ntpCoreDifferenceToNs(qint64(t1 - t0)) + ntpCoreDifferenceToNs(qint64(t2 - t3))) / 2);
+}
+
+qint64 NTPTraceRecord::delayNs() const
+{
+    // delay = (t3 - t0) - (t2 - t1)
+
+    return (ntpCoreDifferenceToNs(qint64(t3 - t0)) - ntpCoreDifferenceToNs(qint64(t2 - t1)));
+}
+
+void NTPTraceRecord::setFromResponse(const QByteArray& bytes, const QHostAddress& host, quint16 hostPort,
+                                     qint64 receiveNs, NTPClock::Source source)
+{
+    memset(this, 0, sizeof(NTPTraceRecord));
+    memcpy(packet, bytes.constData(), qMin(bytes.size(), 48));
+
+    const uchar* const data = reinterpret_cast<const uchar*>(packet);
+
+    t0          = qFromBigEndian<quint64>(data + 24);
+    t1          = qFromBigEndian<quint64>(data + 32);
+    t2          = qFromBigEndian<quint64>(data + 40);
+    t3          = ntpTimestampFromNs(receiveNs);
+    port        = hostPort;
+    clockSource = quint8(source);
+
+    Q_IPV6ADDR ip6 = host.toIPv6Address();
+    memcpy(address, ip6.c, 16);
+}
+
+// ---------------------------------------------------------------------
+
+NTPTraceWriter::NTPTraceWriter(const QString& path)
+    : m_file(path),
+      m_data(nullptr),
+      m_capacity(0)
+{
+}
+
+NTPTraceWriter::~NTPTraceWriter()
+{
+    close();
+}
+
+bool NTPTraceWriter::open()
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (m_data)
+    {
+        return true;
+    }
+
+    if (!m_file.open(QIODevice::ReadWrite))
+    {
+        qDebug() << "NTPTraceWriter::open failed:" << m_file.fileName() << m_file.errorString();
+
+        return false;
+    }
+
+    NTPTraceHeader header;
+    memset(&header, 0, sizeof(NTPTraceHeader));
+
+    if (m_file.size() > 0)
+    {
+        if ((m_file.read(reinterpret_cast<char*>(&header), sizeof(NTPTraceHeader)) != sizeof(NTPTraceHeader)) ||
+            (memcmp(header.magic, NTP_TRACE_MAGIC, 8) != 0)                                                    ||
+            (header.version    != NTP_TRACE_VERSION)                                                           ||
+            (header.recordSize != sizeof(NTPTraceRecord)))
+        {
+            qDebug() << "NTPTraceWriter::open not a trace file:" << m_file.fileName();
+            m_file.close();
+
+            return false;
+        }
+    }
+
+    if (!remap(header.count + NTP_TRACE_CHUNK))
+    {
+        m_file.close();
+
+        return false;
+    }
+
+    NTPTraceHeader* const mapped = reinterpret_cast<NTPTraceHeader*>(m_data);
+    memcpy(mapped->magic, NTP_TRACE_MAGIC, 8);
+    mapped->version              = NTP_TRACE_VERSION;
+    mapped->recordSize           = sizeof(NTPTraceRecord);
+    mapped->count                = header.count;
+
+    return true;
+}
+
+bool NTPTraceWriter::remap(quint64 capacity)
+{
+    if (m_data)
+    {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+
+    const qint64 size = qint64(sizeof(NTPTraceHeader) + capacity * sizeof(NTPTraceRecord));
+
+    if (!m_file.resize(size) || !(m_data = m_file.map(0, size)))
+    {
+        qDebug() << "NTPTraceWriter::remap failed:" << m_file.fileName() << m_file.errorString();
+        m_capacity = 0;
+
+        return false;
+    }
+
+    m_capacity = capacity;
+
+    return true;
+}
+
+void NTPTraceWriter::close()
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (!m_data)
+    {
+        return;
+    }
+
+    // Drop the unused pre-allocated records.
+
+    const quint64 count = reinterpret_cast<NTPTraceHeader*>(m_data)->count;
+    m_file.unmap(m_data);
+    m_data              = nullptr;
+    m_capacity          = 0;
+    m_file.resize(qint64(sizeof(NTPTraceHeader) + count * sizeof(NTPTraceRecord)));
+    m_file.close();
+}
+
+bool NTPTraceWriter::isOpen() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    return (m_data != nullptr);
+}
+
+bool NTPTraceWriter::append(const NTPTraceRecord& record)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (!m_data)
+    {
+        return false;
+    }
+
+    quint64 count = reinterpret_cast<NTPTraceHeader*>(m_data)->count;
+
+    if ((count == m_capacity) && !remap(m_capacity * 2))
+    {
+        return false;
+    }
+
+    NTPTraceHeader* const header = reinterpret_cast<NTPTraceHeader*>(m_data);
+    memcpy(m_data + sizeof(NTPTraceHeader) + count * sizeof(NTPTraceRecord), &record, sizeof(NTPTraceRecord));
+    header->count                = count + 1;
+
+    return true;
+}
+
+quint64 NTPTraceWriter::count() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    return (m_data ? reinterpret_cast<const NTPTraceHeader*>(m_data)->count : 0);
+}
+
+// ---------------------------------------------------------------------
+
+NTPTraceReader::NTPTraceReader(const QString& path)
+    : m_file(path),
+      m_data(nullptr),
+      m_count(0)
+{
+}
+
+NTPTraceReader::~NTPTraceReader()
+{
+    close();
+}
+
+bool NTPTraceReader::open()
+{
+    close();
+
+    if (!m_file.open(QIODevice::ReadOnly) || (m_file.size() < qint64(sizeof(NTPTraceHeader))))
+    {
+        qDebug() << "NTPTraceReader::open failed:" << m_file.fileName() << m_file.errorString();
+        m_file.close();
+
+        return false;
+    }
+
+    m_data = m_file.map(0, m_file.size());
+
+    const NTPTraceHeader* const header = reinterpret_cast<const NTPTraceHeader*>(m_data);
+
+    if (!m_data                                          ||
+        (memcmp(header->magic, NTP_TRACE_MAGIC, 8) != 0) ||
+        (header->version    != NTP_TRACE_VERSION)        ||
+        (header->recordSize != sizeof(NTPTraceRecord)))
+    {
+        qDebug() << "NTPTraceReader::open not a trace file:" << m_file.fileName();
+        close();
+
+        return false;
+    }
+
+    // Guard against a truncated file.
+
+    m_count = qMin(header->count, quint64(m_file.size() - sizeof(NTPTraceHeader)) / sizeof(NTPTraceRecord));
+
+    return true;
+}
+
+void NTPTraceReader::close()
+{
+    if (m_data)
+    {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+
+    m_count = 0;
+    m_file.close();
+}
+
+quint64 NTPTraceReader::count() const
+{
+    return m_count;
+}
+
+const NTPTraceRecord* NTPTraceReader::record(quint64 index) const
+{
+    if (index >= m_count)
+    {
+        return nullptr;
+    }
+
+    return reinterpret_cast<const NTPTraceRecord*>(m_data + sizeof(NTPTraceHeader) + index * sizeof(NTPTraceRecord));
+}
+
+} // namespace QtSampleCodes
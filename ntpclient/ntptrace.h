@@ -0,0 +1,149 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Binary trace of Ntp exchanges
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_TRACE_H
+#define NTP_TRACE_H
+
+// Qt includes
+
+#include <QFile>
+#include <QHostAddress>
+#include <QMutex>
+#include <QString>
+
+// Local includes
+
+#include "ntpclock.h"
+
+namespace QtSampleCodes
+{
+
+/**
+ * One completed Ntp exchange. Fixed size record, stored in host byte order.
+ * Timestamps are kept in Ntp 64 bits format (32 bits seconds since 1900, 32 bits fraction)
+ * to not lose the precision given by the server.
+ */
+struct NTPTraceRecord
+{
+    quint64 t0;                         ///< Client send time, as echoed by the server.
+    quint64 t1;                         ///< Server receive time.
+    quint64 t2;                         ///< Server send time.
+    quint64 t3;                         ///< Client receive time.
+    quint8  address[16];                ///< Server address, IPv4 are stored as IPv4-mapped IPv6.
+    quint16 port;
+    quint8  clockSource;                ///< NTPClock::Source of the local clock used for t3.
+    quint8  reserved[5];
+    char    packet[48];                 ///< Raw server response.
+
+    QHostAddress serverAddress() const;
+
+    /**
+     * Offset and round-trip delay of the exchange in nano-seconds.
+     */
+    qint64       offsetNs()      const;
+    qint64       delayNs()       const;
+
+    /**
+     * Fill t0, t1, t2, packet and server from a validated response, t3 from local receive time in nano-seconds since Epoch,
+     * read from a clock of kind source.
+     */
+    void         setFromResponse(const QByteArray& bytes, const QHostAddress& address, quint16 port,
+                                 qint64 receiveNs, NTPClock::Source source);
+};
+
+/**
+ * Conversions between Ntp 64 bits timestamps and nano-seconds since Epoch.
+ */
+quint64 ntpTimestampFromNs(qint64 ns);
+qint64  ntpTimestampToNs(quint64 ts);
+
+// ---------------------------------------------------------------------
+
+/**
+ * Append records to a memory-mapped trace file. The file grows by chunks and the records
+ * count is kept up to date in the header, so a trace stays readable if the process is killed.
+ */
+class NTPTraceWriter
+{
+
+public:
+
+    explicit NTPTraceWriter(const QString& path);
+    ~NTPTraceWriter();
+
+    /**
+     * Open the trace file, appending to existing records if the file is already a trace.
+     */
+    bool    open();
+    void    close();
+    bool    isOpen() const;
+
+    /**
+     * Thread safe.
+     */
+    bool    append(const NTPTraceRecord& record);
+
+    quint64 count()  const;
+
+private:
+
+    bool    remap(quint64 capacity);
+
+private:
+
+    QFile          m_file;
+    uchar*         m_data;
+    quint64        m_capacity;
+    mutable QMutex m_mutex;
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Read-only memory-mapped view of a trace file.
+ */
+class NTPTraceReader
+{
+
+public:
+
+    explicit NTPTraceReader(const QString& path);
+    ~NTPTraceReader();
+
+    bool                  open();
+    void                  close();
+
+    quint64               count()  const;
+
+    /**
+     * Records are contiguous in the mapped file: record(0) can be used as an array of count() records.
+     */
+    const NTPTraceRecord* record(quint64 index) const;
+
+private:
+
+    QFile   m_file;
+    uchar*  m_data;
+    quint64 m_count;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_TRACE_H
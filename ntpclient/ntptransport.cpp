@@ -0,0 +1,456 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Datagram transport to a Ntp server
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "ntptransport.h"
+
+// C++ includes
+
+#include <cstring>
+
+// Qt includes
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+// Local includes
+
+#include "ntpclock.h"
+#include "ntppackage.h"
+
+namespace QtSampleCodes
+{
+
+NTPNetwork* s_network = nullptr;
+
+/**
+ * Address family which answered first, per host, shared by all transports.
+ */
+QHash<QString, QAbstractSocket::NetworkLayerProtocol> s_preferredProtocols;
+QMutex                                                s_preferredProtocolsMutex;
+
+NTPTransport::NTPTransport(QObject* const parent)
+    : QObject(parent)
+{
+}
+
+NTPTransport::~NTPTransport()
+{
+}
+
+void NTPTransport::accept(const char* /*response*/)
+{
+}
+
+// ---------------------------------------------------------------------
+
+NTPNetwork::~NTPNetwork()
+{
+}
+
+NTPNetwork* NTPNetwork::instance()
+{
+    static NTPUdpNetwork s_udpNetwork;
+
+    return (s_network ? s_network : &s_udpNetwork);
+}
+
+void NTPNetwork::setInstance(NTPNetwork* const network)
+{
+    s_network = network;
+}
+
+// ---------------------------------------------------------------------
+
+NTPUdpTransport::NTPUdpTransport(QObject* const parent)
+    : NTPTransport(parent),
+      m_port(0),
+      m_lookupID(-1),
+      m_attemptTimerID(0),
+      m_current(-1),
+      m_winner(-1)
+{
+}
+
+NTPUdpTransport::~NTPUdpTransport()
+{
+    close();
+}
+
+QAbstractSocket::NetworkLayerProtocol NTPUdpTransport::preferredProtocol(const QString& host)
+{
+    QMutexLocker lock(&s_preferredProtocolsMutex);
+
+    return s_preferredProtocols.value(host, QAbstractSocket::UnknownNetworkLayerProtocol);
+}
+
+void NTPUdpTransport::connectToHost(const QString& host, quint16 port)
+{
+    close();
+
+    m_host     = host;
+    m_port     = port;
+    m_lookupID = QHostInfo::lookupHost(host, this, SLOT(slotHostFound(QHostInfo)));
+}
+
+void NTPUdpTransport::slotHostFound(const QHostInfo& info)
+{
+    if (info.lookupId() != m_lookupID)
+    {
+        return;
+    }
+
+    m_lookupID = -1;
+
+    if ((info.error() != QHostInfo::NoError) || info.addresses().isEmpty())
+    {
+        emit signalError(QAbstractSocket::HostNotFoundError);
+
+        return;
+    }
+
+    // Interleave address families, starting with the family which won the last race, or IPv6.
+
+    QList<QHostAddress> ipv6;
+    QList<QHostAddress> ipv4;
+
+    foreach (const QHostAddress& address, info.addresses())
+    {
+        if (address.protocol() == QAbstractSocket::IPv6Protocol)
+        {
+            ipv6 << address;
+        }
+        else
+        {
+            ipv4 << address;
+        }
+    }
+
+    const bool ipv4First         = (preferredProtocol(m_host) == QAbstractSocket::IPv4Protocol);
+    QList<QHostAddress>& primary = ipv4First ? ipv4 : ipv6;
+    QList<QHostAddress>& other   = ipv4First ? ipv6 : ipv4;
+
+    while (!primary.isEmpty() || !other.isEmpty())
+    {
+        if (!primary.isEmpty())
+        {
+            m_addresses << primary.takeFirst();
+        }
+
+        if (!other.isEmpty())
+        {
+            m_addresses << other.takeFirst();
+        }
+    }
+
+    startNextAttempt();
+}
+
+void NTPUdpTransport::startNextAttempt()
+{
+    if (m_attemptTimerID != 0)
+    {
+        NTPClock::instance()->killTimer(m_attemptTimerID);
+        m_attemptTimerID = 0;
+    }
+
+    if (m_winner >= 0)
+    {
+        return;
+    }
+
+    if (m_addresses.isEmpty())
+    {
+        foreach (const Attempt& attempt, m_attempts)
+        {
+            if (!attempt.failed)
+            {
+                return;
+            }
+        }
+
+        emit signalError(QAbstractSocket::NetworkError);
+
+        return;
+    }
+
+    Attempt attempt;
+    attempt.socket = new QUdpSocket(this);
+    attempt.failed = false;
+    m_attempts << attempt;
+
+    connect(attempt.socket, SIGNAL(connected()),
+            this, SLOT(slotAttemptConnected()));
+
+    connect(attempt.socket, SIGNAL(error(QAbstractSocket::SocketError)),
+            this, SLOT(slotAttemptError(QAbstractSocket::SocketError)));
+
+    connect(attempt.socket, SIGNAL(readyRead()),
+            this, SLOT(slotAttemptReadyRead()));
+
+    // Without response, the next address is tried after the attempt delay.
+
+    if (m_addresses.size() > 1)
+    {
+        m_attemptTimerID = NTPClock::instance()->startTimer(UDP_ATTEMPT_DELAY, [this]() { m_attemptTimerID = 0; startNextAttempt(); });
+    }
+
+    attempt.socket->connectToHost(m_addresses.takeFirst(), m_port);
+}
+
+int NTPUdpTransport::attemptIndex(QObject* const socket) const
+{
+    for (int i = 0 ; i < m_attempts.size() ; ++i)
+    {
+        if (m_attempts.at(i).socket == socket)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void NTPUdpTransport::slotAttemptConnected()
+{
+    int index = attemptIndex(sender());
+
+    if ((index < 0) || (m_winner >= 0))
+    {
+        return;
+    }
+
+    m_current = index;
+
+    emit signalConnected();
+}
+
+bool NTPUdpTransport::write(const QByteArray& datagram)
+{
+    const int index = (m_winner >= 0) ? m_winner : m_current;
+
+    if ((index < 0) || m_attempts.at(index).failed)
+    {
+        return false;
+    }
+
+    Attempt& attempt = m_attempts[index];
+
+    if (attempt.socket->write(datagram) != datagram.size())
+    {
+        attemptFailed(attempt.socket, attempt.socket->error());
+
+        return false;
+    }
+
+    attempt.timestamp = datagram.mid(40, 8);
+
+    return true;
+}
+
+void NTPUdpTransport::slotAttemptReadyRead()
+{
+    // Datagrams are left in the sockets and read by the client in its receive ring, racing or not.
+
+    const int index = attemptIndex(sender());
+
+    if ((index < 0) || ((m_winner >= 0) && (index != m_winner)))
+    {
+        return;
+    }
+
+    emit signalReadyRead();
+}
+
+void NTPUdpTransport::accept(const char* response)
+{
+    if (m_winner >= 0)
+    {
+        return;
+    }
+
+    // The winner is the attempt which sent the request echoed as origin timestamp.
+
+    for (int i = 0 ; i < m_attempts.size() ; ++i)
+    {
+        const Attempt& attempt = m_attempts.at(i);
+
+        if (attempt.socket && (attempt.timestamp.size() == 8) && (memcmp(response + 24, attempt.timestamp.constData(), 8) == 0))
+        {
+            win(i);
+
+            return;
+        }
+    }
+}
+
+void NTPUdpTransport::win(int index)
+{
+    m_winner = index;
+    m_addresses.clear();
+
+    if (m_attemptTimerID != 0)
+    {
+        NTPClock::instance()->killTimer(m_attemptTimerID);
+        m_attemptTimerID = 0;
+    }
+
+    for (int i = 0 ; i < m_attempts.size() ; ++i)
+    {
+        if ((i != index) && m_attempts.at(i).socket)
+        {
+            m_attempts[i].socket->close();
+            m_attempts[i].socket->deleteLater();
+            m_attempts[i].socket = nullptr;
+            m_attempts[i].failed = true;
+        }
+    }
+
+    QMutexLocker lock(&s_preferredProtocolsMutex);
+    s_preferredProtocols[m_host] = m_attempts.at(index).socket->peerAddress().protocol();
+}
+
+void NTPUdpTransport::slotAttemptError(QAbstractSocket::SocketError error)
+{
+    attemptFailed(qobject_cast<QUdpSocket*>(sender()), error);
+}
+
+void NTPUdpTransport::attemptFailed(QUdpSocket* const socket, QAbstractSocket::SocketError error)
+{
+    int index = attemptIndex(socket);
+
+    if ((index < 0) || m_attempts.at(index).failed)
+    {
+        return;
+    }
+
+    if (index == m_winner)
+    {
+        emit signalError(error);
+
+        return;
+    }
+
+    m_attempts[index].failed = true;
+    m_attempts[index].socket = nullptr;
+    socket->close();
+    socket->deleteLater();
+
+    // Do not wait the attempt delay to try the next address.
+
+    if (m_attemptTimerID != 0)
+    {
+        NTPClock::instance()->killTimer(m_attemptTimerID);
+    }
+
+    m_attemptTimerID = NTPClock::instance()->startTimer(0, [this]() { m_attemptTimerID = 0; startNextAttempt(); });
+}
+
+void NTPUdpTransport::close()
+{
+    if (m_lookupID >= 0)
+    {
+        QHostInfo::abortHostLookup(m_lookupID);
+        m_lookupID = -1;
+    }
+
+    if (m_attemptTimerID != 0)
+    {
+        NTPClock::instance()->killTimer(m_attemptTimerID);
+        m_attemptTimerID = 0;
+    }
+
+    foreach (const Attempt& attempt, m_attempts)
+    {
+        if (attempt.socket)
+        {
+            attempt.socket->close();
+            attempt.socket->deleteLater();
+        }
+    }
+
+    m_attempts.clear();
+    m_addresses.clear();
+    m_current = -1;
+    m_winner  = -1;
+}
+
+int NTPUdpTransport::readableAttempt() const
+{
+    if (m_winner >= 0)
+    {
+        return (m_attempts.at(m_winner).socket->hasPendingDatagrams() ? m_winner : -1);
+    }
+
+    for (int i = 0 ; i < m_attempts.size() ; ++i)
+    {
+        const QUdpSocket* const socket = m_attempts.at(i).socket;
+
+        if (socket && socket->hasPendingDatagrams())
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool NTPUdpTransport::hasPendingDatagrams() const
+{
+    return (readableAttempt() >= 0);
+}
+
+qint64 NTPUdpTransport::readDatagram(char* data, qint64 maxSize)
+{
+    const int index = readableAttempt();
+
+    if (index < 0)
+    {
+        return -1;
+    }
+
+    return m_attempts.at(index).socket->readDatagram(data, maxSize);
+}
+
+QHostAddress NTPUdpTransport::peerAddress() const
+{
+    const int index = (m_winner >= 0) ? m_winner : m_current;
+
+    if ((index < 0) || !m_attempts.at(index).socket)
+    {
+        return QHostAddress();
+    }
+
+    return m_attempts.at(index).socket->peerAddress();
+}
+
+quint16 NTPUdpTransport::peerPort() const
+{
+    return m_port;
+}
+
+// ---------------------------------------------------------------------
+
+NTPTransport* NTPUdpNetwork::createTransport(QObject* const parent)
+{
+    return new NTPUdpTransport(parent);
+}
+
+} // namespace QtSampleCodes
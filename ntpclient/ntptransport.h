@@ -0,0 +1,195 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Datagram transport to a Ntp server
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef NTP_TRANSPORT_H
+#define NTP_TRANSPORT_H
+
+// Qt includes
+
+#include <QObject>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QList>
+#include <QUdpSocket>
+
+namespace QtSampleCodes
+{
+
+/**
+ * Connected datagram channel used by NTPClient, with the same semantic as a connected QUdpSocket.
+ * signalConnected() is emitted each time a new path to the server is ready to send a request:
+ * the client answers it with write(), and must accept a response to any of the requests written.
+ */
+class NTPTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit NTPTransport(QObject* const parent = nullptr);
+    ~NTPTransport();
+
+    virtual void         connectToHost(const QString& host, quint16 port) = 0;
+    virtual void         close()                                          = 0;
+
+    virtual bool         write(const QByteArray& datagram)                = 0;
+
+    virtual bool         hasPendingDatagrams()                      const = 0;
+
+    /**
+     * Read the next datagram in data, as QUdpSocket::readDatagram(). A datagram larger than maxSize
+     * is truncated. Return the size read, or -1 if there is no datagram pending.
+     */
+    virtual qint64       readDatagram(char* data, qint64 maxSize)         = 0;
+
+    /**
+     * Called by the client when response, a datagram read with readDatagram(), matches a request:
+     * the path which answered is kept for the next exchanges. Nothing is done by default.
+     */
+    virtual void         accept(const char* response);
+
+    virtual QHostAddress peerAddress()                              const = 0;
+    virtual quint16      peerPort()                                 const = 0;
+
+Q_SIGNALS:
+
+    void signalConnected();
+    void signalReadyRead();
+    void signalError(QAbstractSocket::SocketError);
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Create the transports used by Ntp clients. UDP sockets are used by default,
+ * a simulated network can be installed to run synchronization scenarios without network.
+ */
+class NTPNetwork
+{
+
+public:
+
+    virtual ~NTPNetwork();
+
+    virtual NTPTransport* createTransport(QObject* const parent) = 0;
+
+public:
+
+    /**
+     * Network used by Ntp clients. setInstance(nullptr) restores UDP sockets.
+     * Network is not owned and must be installed before clients are started.
+     */
+    static NTPNetwork* instance();
+    static void        setInstance(NTPNetwork* const network);
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * UDP transport racing all server addresses, RFC 8305 style: addresses are interleaved by family,
+ * starting with the family which answered last time for this host, and a new attempt starts
+ * each UDP_ATTEMPT_DELAY ms, or at once if an attempt fails. While racing, datagrams are read
+ * from all attempts by the client, which validates them: the attempt which sent the request
+ * echoed by the response accepted wins, the others are cancelled.
+ */
+class NTPUdpTransport : public NTPTransport
+{
+    Q_OBJECT
+
+public:
+
+    explicit NTPUdpTransport(QObject* const parent = nullptr);
+    ~NTPUdpTransport();
+
+    void         connectToHost(const QString& host, quint16 port) Q_DECL_OVERRIDE;
+    void         close()                                          Q_DECL_OVERRIDE;
+
+    bool         write(const QByteArray& datagram)                Q_DECL_OVERRIDE;
+
+    bool         hasPendingDatagrams()                      const Q_DECL_OVERRIDE;
+    qint64       readDatagram(char* data, qint64 maxSize)         Q_DECL_OVERRIDE;
+    void         accept(const char* response)                     Q_DECL_OVERRIDE;
+
+    QHostAddress peerAddress()                              const Q_DECL_OVERRIDE;
+    quint16      peerPort()                                 const Q_DECL_OVERRIDE;
+
+    /**
+     * Address family which won the last race for host, UnknownNetworkLayerProtocol if none.
+     */
+    static QAbstractSocket::NetworkLayerProtocol preferredProtocol(const QString& host);
+
+private Q_SLOTS:
+
+    void slotHostFound(const QHostInfo& info);
+    void slotAttemptConnected();
+    void slotAttemptReadyRead();
+    void slotAttemptError(QAbstractSocket::SocketError error);
+
+private:
+
+    /**
+     * One socket connected to one server address.
+     */
+    struct Attempt
+    {
+        QUdpSocket* socket;
+        QByteArray  timestamp;          ///< Transmit timestamp of the request sent, the response echoes it.
+        bool        failed;
+    };
+
+private:
+
+    int  attemptIndex(QObject* const socket) const;
+
+    /**
+     * Index in m_attempts of the socket to read next: the winner, or while racing the first attempt
+     * with pending datagrams. -1 if there is nothing to read.
+     */
+    int  readableAttempt()                    const;
+    void startNextAttempt();
+    void attemptFailed(QUdpSocket* const socket, QAbstractSocket::SocketError error);
+    void win(int index);
+
+private:
+
+    QString             m_host;
+    quint16             m_port;
+    int                 m_lookupID;
+    QList<QHostAddress> m_addresses;    ///< Addresses not tried yet, in attempt order.
+    QList<Attempt>      m_attempts;
+    int                 m_attemptTimerID;
+    int                 m_current;      ///< Index in m_attempts of the last connected attempt, where requests are written.
+    int                 m_winner;       ///< Index in m_attempts, -1 until a response is accepted.
+};
+
+// ---------------------------------------------------------------------
+
+class NTPUdpNetwork : public NTPNetwork
+{
+
+public:
+
+    NTPTransport* createTransport(QObject* const parent) Q_DECL_OVERRIDE;
+};
+
+} // namespace QtSampleCodes
+
+#endif // NTP_TRANSPORT_H
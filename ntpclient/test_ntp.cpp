@@ -22,6 +22,7 @@
 
 #include <QCoreApplication>
 #include <QDebug>
+#include <QTimer>
 
 // Local includes
 
@@ -33,12 +34,20 @@ int main(int argc, char *argv[])
 {
     QCoreApplication a(argc, argv);
 
+    // Synchronization runs in the event loop.
+
+    NTPTimeStamp::instance();
+    QTimer::singleShot(5000, &a, SLOT(quit()));
+    a.exec();
+
     QDateTime time;
     time.setMSecsSinceEpoch(NTPTimeStamp::instance()->currentMSTimestamp());
 
     qDebug() << "Using Ntp servers:" << NTPTimeStamp::instance()->ntpServers();
     qDebug() << time.toString();
     qDebug() << time.toMSecsSinceEpoch() << "milli-seconds since Epoch";
+    qDebug() << "Synchronized" << NTPTimeStamp::instance()->syncAge() << "ms ago, error bound"
+             << NTPTimeStamp::instance()->errorBound() << "ms";
 
     return -1;
 }
@@ -0,0 +1,127 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal client core - Synchronization
+ *               without Qt event loop.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// C++ includes
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local includes
+
+#include "ntpchrono.h"
+#include "ntpcoredeadline.h"
+#include "ntpcoreloop.h"
+#include "ntpcoresync.h"
+
+using namespace QtSampleCodes;
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> servers;
+
+    for (int i = 1 ; i < argc ; ++i)
+    {
+        servers.push_back(argv[i]);
+    }
+
+    if (servers.empty())
+    {
+        servers.push_back("fr.pool.ntp.org");
+    }
+
+    NTPEventLoop loop;
+
+    if (!loop.isValid())
+    {
+        fprintf(stderr, "Cannot create event loop\n");
+
+        return -1;
+    }
+
+    // The service keeps its own threads: the loop runs in a dedicated one.
+
+    NTPCoreSync       sync(&loop);
+    NTPDeadlineTimers deadlines(&loop, &sync);
+
+    loop.post(
+        [&]()
+        {
+            sync.setServers(servers);
+            sync.start();
+        }
+    );
+
+    std::thread thread([&]() { loop.run(); });
+
+    for (int i = 0 ; (i < 100) && !sync.isSynchronized() ; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    const bool    synchronized = sync.isSynchronized();
+    const int64_t offsetNs     = sync.offsetNs();
+    const int64_t currentNs    = sync.currentNSecsSinceEpoch();
+
+    // Fire a deadline at the next whole second of network time, and measure its lateness.
+
+    std::atomic<int64_t> lateNs(-1);
+
+    loop.post(
+        [&]()
+        {
+            const int64_t deadline = (deadlines.currentNSecsSinceEpoch() / 1000000000LL + 1) * 1000000000LL;
+
+            deadlines.start(deadline, [&, deadline]() { lateNs = deadlines.currentNSecsSinceEpoch() - deadline; });
+        }
+    );
+
+    for (int i = 0 ; (i < 20) && (lateNs < 0) ; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    loop.post([&]() { sync.stop(); });
+    loop.quit();
+    thread.join();
+
+    printf("Using Ntp servers:");
+
+    for (size_t i = 0 ; i < servers.size() ; ++i)
+    {
+        printf(" %s", servers[i].c_str());
+    }
+
+    printf("\nSynchronized: %s, offset: %lld ns\n", synchronized ? "yes" : "no", static_cast<long long>(offsetNs));
+    printf("%lld nano-seconds since Epoch\n", static_cast<long long>(currentNs));
+    // Corrected time through the std::chrono clock, formatted as any time point.
+
+    const std::time_t now = ntp_clock::to_time_t(ntp_clock::now());
+    char              text[64];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S UTC", gmtime(&now));
+    printf("%s\n", text);
+
+    printf("Deadline fired %lld ns late\n", static_cast<long long>(lateNs.load()));
+
+    return (synchronized ? 0 : -1);
+}
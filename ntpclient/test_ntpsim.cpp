@@ -0,0 +1,334 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Network Time Protocal Qt client - Synchronization scenarios
+ *               run on a virtual clock with simulated servers.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// C++ includes
+
+#include <climits>
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+
+// Local includes
+
+#include "ntpclient.h"
+#include "ntpclock.h"
+#include "ntphistory.h"
+#include "ntpranking.h"
+#include "ntpsimulation.h"
+#include "ntptimestamp.h"
+#include "ntptrace.h"
+
+using namespace QtSampleCodes;
+
+NTPVirtualClock*     s_clock   = nullptr;
+NTPSimulatedNetwork* s_network = nullptr;
+int                  s_failed  = 0;
+
+/**
+ * Difference between corrected time and true time.
+ */
+qint64 s_errorMs()
+{
+    return (NTPTimeStamp::instance()->currentMSTimestamp() - s_clock->referenceMSecsSinceEpoch());
+}
+
+void s_check(const char* const scenario, bool passed)
+{
+    qInfo().noquote() << (passed ? "> PASS" : "> FAIL") << scenario
+                      << ": error" << s_errorMs() << "ms, local clock error" << s_clock->localErrorMSecs()
+                      << "ms, requests" << s_network->requests() << ", responses" << s_network->responses();
+
+    if (!passed)
+    {
+        s_failed++;
+    }
+}
+
+void s_setReachable(const QStringList& servers, bool reachable)
+{
+    foreach (const QString& host, servers)
+    {
+        NTPSimulatedServer server = s_network->server(host);
+        server.reachable          = reachable;
+        s_network->setServer(host, server);
+    }
+}
+
+/**
+ * Requests sent to hosts since the start.
+ */
+int s_requests(const QStringList& hosts)
+{
+    int count = 0;
+
+    foreach (const QString& host, hosts)
+    {
+        count += s_network->requestTimes(host).size();
+    }
+
+    return count;
+}
+
+/**
+ * Read the time each period during duration ms, allowing a staleness of half the period.
+ */
+void s_readEvery(qint64 period, qint64 duration)
+{
+    for (qint64 elapsed = 0 ; elapsed < duration ; elapsed += period)
+    {
+        NTPTimeStamp::instance()->currentMSTimestamp(period / 2);
+        s_clock->advance(period);
+    }
+}
+
+/**
+ * Check the buckets of a downsampled range against the samples of the range.
+ */
+bool s_checkBuckets(const QVector<NTPHistorySample>& samples, const QVector<NTPHistoryBucket>& buckets,
+                    qint64 from, qint64 to, qint64 bucketMs)
+{
+    int    count = 0;
+    qint64 start = LLONG_MIN;
+
+    foreach (const NTPHistorySample& sample, samples)
+    {
+        if ((sample.time < from) || (sample.time > to))
+        {
+            return false;
+        }
+    }
+
+    foreach (const NTPHistoryBucket& bucket, buckets)
+    {
+        if ((bucket.count <= 0) || (bucket.start <= start) || (bucket.start < from - bucketMs) || (bucket.start > to) ||
+            (bucket.minOffsetNs > bucket.meanOffsetNs) || (bucket.meanOffsetNs > bucket.maxOffsetNs) ||
+            (bucket.minDelayNs  > bucket.meanDelayNs)  || (bucket.meanDelayNs  > bucket.maxDelayNs))
+        {
+            return false;
+        }
+
+        start  = bucket.start;
+        count += bucket.count;
+    }
+
+    return (!samples.isEmpty() && (count == samples.size()));
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    NTPVirtualClock     clock;
+    NTPSimulatedNetwork network(&clock);
+    s_clock   = &clock;
+    s_network = &network;
+
+    NTPClock::setInstance(&clock);
+    NTPNetwork::setInstance(&network);
+
+    const QStringList servers = QStringList() << QLatin1String("ntp1.sim")
+                                              << QLatin1String("ntp2.sim")
+                                              << QLatin1String("ntp3.sim");
+    const qint64 offsets[]    = { 0, 2, -3 };
+
+    for (int i = 0 ; i < servers.size() ; ++i)
+    {
+        NTPSimulatedServer server;
+        server.offsetMs = offsets[i];
+        server.delayMs  = 20;
+        server.jitterMs = 4;
+        network.setServer(servers[i], server);
+    }
+
+    QElapsedTimer cpu;
+    cpu.start();
+
+    // Local clock is 350 ms ahead at startup.
+
+    clock.jump(350);
+    NTPTimeStamp::instance()->setNtpServers(servers);
+
+    clock.advance(1000);
+    s_check("first sync", qAbs(s_errorMs()) <= 10);
+
+    // 50 ppm drift during 2 hours is not a jump: no resynchronization, error follows the drift.
+
+    clock.setDriftPpm(50.0);
+    clock.advance(2 * 3600 * 1000);
+    s_check("drift without jump", qAbs(s_errorMs() - 360) <= 20);
+
+    // Local clock is stepped: notifier detects it within its check interval.
+
+    clock.jump(5000);
+    clock.advance(2000);
+    s_check("resync after jump", qAbs(s_errorMs()) <= 10);
+
+    // All servers lost: clients back off, corrected time falls back to the local clock.
+
+    s_setReachable(servers, false);
+    clock.jump(-3000);
+    quint64 requests = network.requests();
+    clock.advance(10 * 60 * 1000);
+    s_check("servers lost", (qAbs(s_errorMs() - clock.localErrorMSecs()) <= 1) && (network.requests() - requests < 100));
+
+    // Servers are back: clients recover at the latest after the longest resend interval and Udp timeout.
+
+    s_setReachable(servers, true);
+    clock.advance(UDP_TIMEOUT + 30000 + 1000);
+    s_check("servers recovered", qAbs(s_errorMs()) <= 10);
+
+    // Hot set of 2 among 4 servers, the first two hot at start. A cold server replaces the worst
+    // hot one only if its score is NTP_RANK_HYSTERESIS percent better: near.sim, 10% better, stays
+    // cold, fast.sim is promoted once probed.
+
+    clock.setDriftPpm(0.0);
+
+    const QStringList ranked = QStringList() << QLatin1String("slow1.sim")
+                                             << QLatin1String("slow2.sim")
+                                             << QLatin1String("near.sim")
+                                             << QLatin1String("fast.sim");
+    const qint64 delays[]    = { 100, 100, 90, 20 };
+
+    for (int i = 0 ; i < ranked.size() ; ++i)
+    {
+        NTPSimulatedServer server;
+        server.delayMs = delays[i];
+        network.setServer(ranked[i], server);
+    }
+
+    const qint64 historyFrom = clock.currentMSecsSinceEpoch();
+
+    NTPTimeStamp::instance()->setHotSetSize(2);
+    NTPTimeStamp::instance()->setNtpServers(ranked);
+    s_readEvery(10000, NTP_RANK_COLD_INTERVAL + 100000);
+
+    QStringList hot = NTPTimeStamp::instance()->hotServers();
+    s_check("hot set promotion", (hot.size() == 2) && hot.contains(ranked[3]) && !hot.contains(ranked[2]));
+
+    // fast.sim slows down: demoted once clearly worse than near.sim, the best cold server.
+
+    NTPSimulatedServer slowed = network.server(ranked[3]);
+    slowed.delayMs            = 400;
+    network.setServer(ranked[3], slowed);
+    s_readEvery(10000, 300000);
+
+    hot = NTPTimeStamp::instance()->hotServers();
+    s_check("hot set demotion", (hot.size() == 2) && !hot.contains(ranked[3]) && hot.contains(ranked[2]));
+
+    // History of the ranking scenarios: range and downsampling agree, and the buckets of fast.sim
+    // show its slowdown.
+
+    const qint64      historyTo = clock.currentMSecsSinceEpoch();
+    const qint64      bucketMs  = 60000;
+    NTPHistory* const history   = NTPTimeStamp::instance()->history();
+    const bool        combined  = s_checkBuckets(history->series(NTP_HISTORY_COMBINED)->range(historyFrom, historyTo),
+                                                 history->series(NTP_HISTORY_COMBINED)->downsample(historyFrom, historyTo, bucketMs),
+                                                 historyFrom, historyTo, bucketMs);
+    const QVector<NTPHistoryBucket> fast = history->series(3)->downsample(historyFrom, historyTo, bucketMs);
+
+    s_check("history range and downsampling",
+            combined &&
+            s_checkBuckets(history->series(3)->range(historyFrom, historyTo), fast, historyFrom, historyTo, bucketMs) &&
+            (fast.first().maxDelayNs < 50000000LL) && (fast.last().minDelayNs > 300000000LL));
+
+    // On demand: nothing is sent once nobody read the time for NTP_RANK_COLD_INTERVAL.
+
+    NTPTimeStamp::instance()->setLazySync(true);
+    clock.advance(NTP_RANK_COLD_INTERVAL + NTP_RANK_PROBE_INTERVAL);
+    requests = network.requests();
+    clock.advance(3600 * 1000);
+    s_check("lazy idle", network.requests() == requests);
+
+    // A burst of stale reads starts one refresh: one request to each hot server.
+
+    hot                 = NTPTimeStamp::instance()->hotServers();
+    const int hotBefore = s_requests(hot);
+
+    for (int i = 0 ; i < 100 ; ++i)
+    {
+        NTPTimeStamp::instance()->currentMSTimestamp(1000);
+    }
+
+    clock.advance(1000);
+    s_check("coalesced refresh", (s_requests(hot) - hotBefore == hot.size()) &&
+                                 (NTPTimeStamp::instance()->syncAge() >= 0) && (NTPTimeStamp::instance()->syncAge() < 1000));
+
+    // Adaptive timeout: a server answering in 20 ms is retried within a second after a loss,
+    // and the timeout doubles at each loss up to its ceiling.
+
+    const QString rtoHost = QLatin1String("rto.sim");
+    network.setServer(rtoHost, NTPSimulatedServer());
+
+    NTPClient* const rtoClient = new NTPClient(rtoHost);
+    rtoClient->start();
+    clock.advance(1000);
+
+    const int sent = network.requestTimes(rtoHost).size();
+    s_setReachable(QStringList() << rtoHost, false);
+    rtoClient->start();
+    clock.advance(60000);
+
+    const QList<qint64> times = network.requestTimes(rtoHost).mid(sent);
+    bool                rto   = !rtoClient->done() && (times.size() >= 6);
+
+    for (int i = 1 ; rto && (i < times.size()) ; ++i)
+    {
+        const qint64 gap      = times.at(i) - times.at(i - 1);
+        const qint64 previous = (i > 1) ? (times.at(i - 1) - times.at(i - 2)) : 0;
+
+        rto = (gap >= previous) && (gap <= 2 * NTP_CORE_TIMEOUT) && ((i > 1) || (gap <= 1000));
+    }
+
+    s_setReachable(QStringList() << rtoHost, true);
+    clock.advance(2 * NTP_CORE_TIMEOUT + 1000);
+    s_check("adaptive timeout backoff", rto && rtoClient->done());
+
+    // Exchanges traced under the simulated clock are recorded with its source.
+
+    QTemporaryDir  traceDir;
+    const QString  tracePath = traceDir.path() + QLatin1String("/sim.trace");
+    NTPTraceWriter trace(tracePath);
+    bool           traced    = traceDir.isValid() && trace.open();
+
+    rtoClient->setTraceWriter(&trace);
+    rtoClient->start();
+    clock.advance(1000);
+    rtoClient->setTraceWriter(nullptr);
+    trace.close();
+
+    NTPTraceReader reader(tracePath);
+    traced = traced && reader.open() && (reader.count() == 1) &&
+             (reader.record(0)->clockSource == quint8(NTPClock::Virtual));
+    s_check("trace clock source", traced);
+
+    delete rtoClient;
+
+    qInfo().noquote() << "=== Simulated" << clock.monotonicMSecs() / 1000 << "s in" << cpu.elapsed() << "ms";
+
+    NTPNetwork::setInstance(nullptr);
+    NTPClock::setInstance(nullptr);
+
+    return ((s_failed == 0) ? 0 : -1);
+}
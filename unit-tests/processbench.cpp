@@ -0,0 +1,530 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Latency of process launch by the available methods,
+ *               with percentiles.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processbench.h"
+
+// C++ includes
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <vector>
+
+// Qt includes
+
+#include <QEventLoop>
+#include <QProcess>
+
+#ifdef Q_OS_LINUX
+
+// Linux includes
+
+#   include <fcntl.h>
+#   include <poll.h>
+#   include <spawn.h>
+#   include <sys/wait.h>
+#   include <unistd.h>
+
+extern char** environ;
+
+#endif
+
+// Local includes
+
+#ifdef Q_OS_LINUX
+#   include "processlauncher.h"
+#endif
+
+#define PROCESS_BENCH_BUFFER_SIZE   65536       // Bytes of child output read at once, and dropped
+
+namespace QtSampleCodes
+{
+
+ProcessBenchSample::ProcessBenchSample()
+    : startedNs(-1),
+      firstByteNs(-1),
+      totalNs(-1)
+{
+}
+
+ProcessBenchStats::ProcessBenchStats()
+    : count(0),
+      min(-1),
+      p50(-1),
+      p99(-1),
+      max(-1)
+{
+}
+
+// ---------------------------------------------------------------------
+
+ProcessBench::ProcessBench(const QString& program, const QStringList& arguments, QObject* const parent)
+    : QObject(parent),
+      m_program(program),
+      m_arguments(arguments),
+      m_launcher(nullptr),
+      m_method(QProcessSeparate),
+      m_runs(0),
+      m_parallel(1),
+      m_next(0),
+      m_done(0),
+      m_loop(nullptr)
+{
+}
+
+ProcessBench::~ProcessBench()
+{
+}
+
+void ProcessBench::setLauncher(ProcessLauncher* const launcher)
+{
+    m_launcher = launcher;
+}
+
+bool ProcessBench::isAvailable(Method method) const
+{
+    switch (method)
+    {
+        case QProcessSeparate:
+        case QProcessMerged:
+            return true;
+
+        case PosixSpawn:
+
+#ifdef Q_OS_LINUX
+            return true;
+#else
+            return false;
+#endif
+
+        case Launcher:
+
+#ifdef Q_OS_LINUX
+            return (m_launcher && m_launcher->isRunning());
+#else
+            return false;
+#endif
+
+        default:
+            return false;
+    }
+}
+
+QVector<ProcessBenchSample> ProcessBench::run(Method method, int runs, int parallel)
+{
+    if (!isAvailable(method) || (runs <= 0))
+    {
+        return QVector<ProcessBenchSample>();
+    }
+
+    parallel = qMax(1, parallel);
+
+    if (method == PosixSpawn)
+    {
+        return runSpawn(runs, parallel);
+    }
+
+    QEventLoop loop;
+
+    m_method   = method;
+    m_runs     = runs;
+    m_parallel = parallel;
+    m_next     = 0;
+    m_done     = 0;
+    m_samples  = QVector<ProcessBenchSample>(runs);
+    m_loop     = &loop;
+
+    launch();
+
+    if (m_done < m_runs)
+    {
+        loop.exec();
+    }
+
+    m_loop = nullptr;
+
+    return m_samples;
+}
+
+ProcessBenchStats ProcessBench::stats(const QVector<ProcessBenchSample>& samples, qint64 ProcessBenchSample::* time)
+{
+    std::vector<qint64> values;
+    values.reserve(samples.size());
+
+    foreach (const ProcessBenchSample& sample, samples)
+    {
+        if (sample.*time >= 0)
+        {
+            values.push_back(sample.*time);
+        }
+    }
+
+    ProcessBenchStats stats;
+
+    if (values.empty())
+    {
+        return stats;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    const double count = double(values.size());
+
+    stats.count = int(values.size());
+    stats.min   = values.front();
+    stats.p50   = values[qMax(0, int(std::ceil(0.50 * count)) - 1)];
+    stats.p99   = values[qMax(0, int(std::ceil(0.99 * count)) - 1)];
+    stats.max   = values.back();
+
+    return stats;
+}
+
+QString ProcessBench::methodName(Method method)
+{
+    switch (method)
+    {
+        case QProcessSeparate:
+            return QLatin1String("QProcess");
+
+        case QProcessMerged:
+            return QLatin1String("QProcess merged");
+
+        case PosixSpawn:
+            return QLatin1String("posix_spawn");
+
+        case Launcher:
+            return QLatin1String("launcher");
+
+        default:
+            return QString();
+    }
+}
+
+QVector<ProcessBenchSample> ProcessBench::runSpawn(int runs, int parallel)
+{
+    QVector<ProcessBenchSample> samples(runs);
+
+#ifdef Q_OS_LINUX
+
+    QList<QByteArray>  encoded;
+    std::vector<char*> argv;
+
+    encoded << m_program.toLocal8Bit();
+
+    foreach (const QString& arg, m_arguments)
+    {
+        encoded << arg.toLocal8Bit();
+    }
+
+    for (int i = 0 ; i < encoded.size() ; ++i)
+    {
+        argv.push_back(encoded[i].data());
+    }
+
+    argv.push_back(nullptr);
+
+    struct Child
+    {
+        pid_t         pid;
+        int           fd;
+        int           index;
+        QElapsedTimer timer;
+    };
+
+    std::vector<Child> children;
+    std::vector<char>  buffer(PROCESS_BENCH_BUFFER_SIZE);
+    int                next = 0;
+
+    while ((next < runs) || !children.empty())
+    {
+        while ((next < runs) && (int(children.size()) < parallel))
+        {
+            Child child;
+            child.index = next++;
+            child.timer.start();
+
+            int fds[2];
+
+            if (pipe2(fds, O_CLOEXEC) != 0)
+            {
+                continue;
+            }
+
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+            posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+            posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+
+            const int error = posix_spawnp(&child.pid, argv[0], &actions, nullptr, argv.data(), environ);
+
+            posix_spawn_file_actions_destroy(&actions);
+            close(fds[1]);
+
+            if (error != 0)
+            {
+                close(fds[0]);
+                continue;
+            }
+
+            samples[child.index].startedNs = child.timer.nsecsElapsed();
+            child.fd                       = fds[0];
+            children.push_back(child);
+        }
+
+        if (children.empty())
+        {
+            continue;
+        }
+
+        std::vector<pollfd> fds(children.size());
+
+        for (size_t i = 0 ; i < children.size() ; ++i)
+        {
+            fds[i].fd      = children[i].fd;
+            fds[i].events  = POLLIN;
+            fds[i].revents = 0;
+        }
+
+        if (poll(fds.data(), nfds_t(fds.size()), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        // Backwards: the finished children are removed from the list.
+
+        for (int i = int(fds.size()) - 1 ; i >= 0 ; --i)
+        {
+            if (!fds[i].revents)
+            {
+                continue;
+            }
+
+            Child&              child  = children[i];
+            ProcessBenchSample& sample = samples[child.index];
+            const ssize_t       size   = read(child.fd, buffer.data(), buffer.size());
+
+            if ((size > 0) && (sample.firstByteNs < 0))
+            {
+                sample.firstByteNs = child.timer.nsecsElapsed();
+            }
+
+            if ((size == 0) || ((size < 0) && (errno != EINTR) && (errno != EAGAIN)))
+            {
+                close(child.fd);
+                waitpid(child.pid, nullptr, 0);
+
+                sample.totalNs = child.timer.nsecsElapsed();
+                children.erase(children.begin() + i);
+            }
+        }
+    }
+
+    // Only left after a poll error.
+
+    for (size_t i = 0 ; i < children.size() ; ++i)
+    {
+        close(children[i].fd);
+        waitpid(children[i].pid, nullptr, 0);
+    }
+
+#else
+
+    Q_UNUSED(parallel);
+
+#endif
+
+    return samples;
+}
+
+void ProcessBench::launch()
+{
+    while ((m_next < m_runs) && (m_running.size() < m_parallel))
+    {
+        QProcess*        qprocess = nullptr;
+        QObject*         process  = nullptr;
+
+#ifdef Q_OS_LINUX
+
+        LauncherProcess* launched = nullptr;
+
+        if (m_method == Launcher)
+        {
+            launched = new LauncherProcess(m_launcher, this);
+            launched->setProgram(m_program);
+            launched->setArguments(m_arguments);
+            launched->setProcessChannelMode(QProcess::MergedChannels);
+            process  = launched;
+        }
+
+#endif
+
+        if (!process)
+        {
+            qprocess = new QProcess(this);
+            qprocess->setProgram(m_program);
+            qprocess->setArguments(m_arguments);
+            qprocess->setProcessChannelMode((m_method == QProcessMerged) ? QProcess::MergedChannels
+                                                                         : QProcess::SeparateChannels);
+            process  = qprocess;
+        }
+
+        // Same signatures for both classes: connected by name.
+
+        connect(process, SIGNAL(started()),
+                this, SLOT(slotStarted()));
+
+        connect(process, SIGNAL(readyReadStandardOutput()),
+                this, SLOT(slotReadyRead()));
+
+        connect(process, SIGNAL(readyReadStandardError()),
+                this, SLOT(slotReadyRead()));
+
+        connect(process, SIGNAL(finished(int,QProcess::ExitStatus)),
+                this, SLOT(slotFinished()));
+
+        connect(process, SIGNAL(error(QProcess::ProcessError)),
+                this, SLOT(slotError()));
+
+        Running running;
+        running.index = m_next++;
+        running.timer.start();
+        m_running.insert(process, running);
+
+        // The launcher emits started() from start(): registered before.
+
+        if (qprocess)
+        {
+            qprocess->start();
+        }
+
+#ifdef Q_OS_LINUX
+
+        else
+        {
+            launched->start();
+        }
+
+#endif
+
+    }
+
+    if ((m_done == m_runs) && m_loop)
+    {
+        m_loop->quit();
+    }
+}
+
+void ProcessBench::complete(QObject* const process)
+{
+    if (!m_running.remove(process))
+    {
+        return;
+    }
+
+    process->disconnect(this);
+    process->deleteLater();
+
+    m_done++;
+    launch();
+}
+
+void ProcessBench::slotStarted()
+{
+    if (m_running.contains(sender()))
+    {
+        const Running& running = m_running[sender()];
+
+        m_samples[running.index].startedNs = running.timer.nsecsElapsed();
+    }
+}
+
+void ProcessBench::slotReadyRead()
+{
+    QObject* const process = sender();
+
+    if (!m_running.contains(process))
+    {
+        return;
+    }
+
+    qint64 size = 0;
+
+    if (QProcess* const child = qobject_cast<QProcess*>(process))
+    {
+        size += child->readAllStandardOutput().size();
+        size += child->readAllStandardError().size();
+    }
+
+#ifdef Q_OS_LINUX
+
+    else if (LauncherProcess* const child = qobject_cast<LauncherProcess*>(process))
+    {
+        size += child->readAllStandardOutput().size();
+        size += child->readAllStandardError().size();
+    }
+
+#endif
+
+    const Running&      running = m_running[process];
+    ProcessBenchSample& sample  = m_samples[running.index];
+
+    if ((size > 0) && (sample.firstByteNs < 0))
+    {
+        sample.firstByteNs = running.timer.nsecsElapsed();
+    }
+}
+
+void ProcessBench::slotFinished()
+{
+    QObject* const process = sender();
+
+    if (m_running.contains(process))
+    {
+        // Output still buffered counts for the first byte.
+
+        slotReadyRead();
+
+        const Running& running = m_running[process];
+
+        m_samples[running.index].totalNs = running.timer.nsecsElapsed();
+        complete(process);
+    }
+}
+
+void ProcessBench::slotError()
+{
+    // Other errors are followed by finished().
+
+    QProcess* const child = qobject_cast<QProcess*>(sender());
+
+    if (!child || (child->error() == QProcess::FailedToStart))
+    {
+        complete(sender());
+    }
+}
+
+} // namespace QtSampleCodes
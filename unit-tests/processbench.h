@@ -0,0 +1,144 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Latency of process launch by the available methods,
+ *               with percentiles.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_BENCH_H
+#define PROCESS_BENCH_H
+
+// Qt includes
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+class QEventLoop;
+
+namespace QtSampleCodes
+{
+
+class ProcessLauncher;
+
+/**
+ * Times of one run from the launch request, in ns. -1 if not reached: no output, or failure.
+ */
+struct ProcessBenchSample
+{
+    ProcessBenchSample();
+
+    qint64 startedNs;           ///< started() emitted, or posix_spawnp() returned.
+    qint64 firstByteNs;
+    qint64 totalNs;             ///< finished() emitted, or child reaped.
+};
+
+/**
+ * Nearest-rank percentiles of one time over the runs, in ns.
+ */
+struct ProcessBenchStats
+{
+    ProcessBenchStats();
+
+    int    count;
+    qint64 min;
+    qint64 p50;
+    qint64 p99;
+    qint64 max;
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Run a command a number of times with a method, at most parallel runs at a time, and time each
+ * run. The Qt methods run in a local event loop, the posix_spawn baseline polls the pipes without
+ * Qt: the difference is the cost of the orchestration.
+ */
+class ProcessBench : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    enum Method
+    {
+        QProcessSeparate = 0,       ///< QProcess, stdout and stderr read separately.
+        QProcessMerged,             ///< QProcess with MergedChannels.
+        PosixSpawn,                 ///< posix_spawnp() and poll(), Linux only.
+        Launcher,                   ///< ProcessLauncher helper, Linux only.
+        MethodCount
+    };
+
+public:
+
+    explicit ProcessBench(const QString& program, const QStringList& arguments, QObject* const parent = nullptr);
+    ~ProcessBench();
+
+    /**
+     * Helper for the Launcher method, started by the caller.
+     */
+    void                        setLauncher(ProcessLauncher* const launcher);
+
+    bool                        isAvailable(Method method)                          const;
+
+    /**
+     * Blocking. Failed runs are in the samples, with -1 times.
+     */
+    QVector<ProcessBenchSample> run(Method method, int runs, int parallel);
+
+    static ProcessBenchStats    stats(const QVector<ProcessBenchSample>& samples, qint64 ProcessBenchSample::* time);
+    static QString              methodName(Method method);
+
+private Q_SLOTS:
+
+    void slotStarted();
+    void slotReadyRead();
+    void slotFinished();
+    void slotError();
+
+private:
+
+    QVector<ProcessBenchSample> runSpawn(int runs, int parallel);
+    void                        launch();
+    void                        complete(QObject* const process);
+
+private:
+
+    struct Running
+    {
+        int           index;
+        QElapsedTimer timer;
+    };
+
+    QString                     m_program;
+    QStringList                 m_arguments;
+    ProcessLauncher*            m_launcher;
+    Method                      m_method;
+    int                         m_runs;
+    int                         m_parallel;
+    int                         m_next;
+    int                         m_done;
+    QHash<QObject*, Running>    m_running;
+    QVector<ProcessBenchSample> m_samples;
+    QEventLoop*                 m_loop;
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_BENCH_H
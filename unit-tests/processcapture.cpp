@@ -0,0 +1,257 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Capture of process output in memory up to a budget,
+ *               then in a temporary file mapped in memory.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processcapture.h"
+
+// C++ includes
+
+#include <cstring>
+
+// Qt includes
+
+#include <QByteArrayMatcher>
+#include <QDir>
+#include <QIODevice>
+#include <QTemporaryFile>
+
+namespace QtSampleCodes
+{
+
+ProcessCapture::ProcessCapture(qint64 budget)
+    : m_budget(qMax(Q_INT64_C(0), budget)),
+      m_size(0),
+      m_file(nullptr),
+      m_map(nullptr),
+      m_mapSize(0)
+{
+}
+
+ProcessCapture::~ProcessCapture()
+{
+    clear();
+}
+
+void ProcessCapture::setMemoryBudget(qint64 budget)
+{
+    m_budget = qMax(Q_INT64_C(0), budget);
+}
+
+qint64 ProcessCapture::memoryBudget() const
+{
+    return m_budget;
+}
+
+bool ProcessCapture::append(const char* data, qint64 size)
+{
+    if (!m_error.isEmpty())
+    {
+        return false;
+    }
+
+    if (size <= 0)
+    {
+        return true;
+    }
+
+    if (!m_file && (m_size + size > m_budget) && !spill())
+    {
+        return false;
+    }
+
+    if (m_file)
+    {
+        if (m_file->write(data, size) != size)
+        {
+            m_error = m_file->errorString();
+
+            return false;
+        }
+    }
+    else
+    {
+        m_buffer.append(data, int(size));
+    }
+
+    m_size += size;
+
+    return true;
+}
+
+bool ProcessCapture::append(const QByteArray& data)
+{
+    return append(data.constData(), data.size());
+}
+
+qint64 ProcessCapture::readFrom(QIODevice* const device)
+{
+    char   chunk[PROCESS_CAPTURE_CHUNK_SIZE];
+    qint64 total = 0;
+    qint64 size  = 0;
+
+    while (m_error.isEmpty() && ((size = device->read(chunk, sizeof(chunk))) > 0))
+    {
+        if (!append(chunk, size))
+        {
+            break;
+        }
+
+        total += size;
+    }
+
+    return total;
+}
+
+QString ProcessCapture::errorString() const
+{
+    return m_error;
+}
+
+void ProcessCapture::clear()
+{
+    unmap();
+
+    delete m_file;
+    m_file = nullptr;
+
+    m_buffer.clear();
+    m_size = 0;
+    m_error.clear();
+}
+
+qint64 ProcessCapture::size() const
+{
+    return m_size;
+}
+
+bool ProcessCapture::isSpilled() const
+{
+    return (m_file != nullptr);
+}
+
+QString ProcessCapture::fileName() const
+{
+    return (m_file ? m_file->fileName() : QString());
+}
+
+const char* ProcessCapture::data()
+{
+    if (m_size == 0)
+    {
+        return nullptr;
+    }
+
+    if (!m_file)
+    {
+        return m_buffer.constData();
+    }
+
+    // The file grew since the last mapping: map it again with the new size.
+
+    if (m_mapSize != m_size)
+    {
+        unmap();
+
+        if (!m_file->flush())
+        {
+            return nullptr;
+        }
+
+        m_map     = m_file->map(0, m_size);
+        m_mapSize = m_map ? m_size : 0;
+    }
+
+    return reinterpret_cast<const char*>(m_map);
+}
+
+QByteArray ProcessCapture::view()
+{
+    const char* const bytes = data();
+
+    return (bytes ? QByteArray::fromRawData(bytes, int(qMin(m_size, qint64(INT_MAX)))) : QByteArray());
+}
+
+QByteArray ProcessCapture::tail(qint64 size)
+{
+    const char* const bytes = data();
+    size                    = qBound(Q_INT64_C(0), size, qMin(m_size, qint64(INT_MAX)));
+
+    return (bytes ? QByteArray::fromRawData(bytes + m_size - size, int(size)) : QByteArray());
+}
+
+qint64 ProcessCapture::indexOf(const QByteArray& needle, qint64 from)
+{
+    const char* const bytes = data();
+
+    if (!bytes || (from < 0) || (from + needle.size() > m_size))
+    {
+        return -1;
+    }
+
+    // Searched by windows of INT_MAX bytes, overlapping by the needle size.
+
+    QByteArrayMatcher matcher(needle);
+    const qint64      window = qint64(INT_MAX) - needle.size();
+
+    for (qint64 start = from ; start + needle.size() <= m_size ; start += window)
+    {
+        const int length = int(qMin(m_size - start, qint64(INT_MAX)));
+        const int index  = matcher.indexIn(bytes + start, length);
+
+        if (index >= 0)
+        {
+            return (start + index);
+        }
+    }
+
+    return -1;
+}
+
+bool ProcessCapture::spill()
+{
+    QTemporaryFile* const file = new QTemporaryFile(QDir::tempPath() + QLatin1String("/processcapture-XXXXXX"));
+
+    if (!file->open() || (file->write(m_buffer) != m_buffer.size()))
+    {
+        m_error = file->errorString();
+        delete file;
+
+        return false;
+    }
+
+    // Memory of the buffer is released: only the file grows now.
+
+    m_file   = file;
+    m_buffer = QByteArray();
+
+    return true;
+}
+
+void ProcessCapture::unmap()
+{
+    if (m_map)
+    {
+        m_file->unmap(m_map);
+        m_map     = nullptr;
+        m_mapSize = 0;
+    }
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,121 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Capture of process output in memory up to a budget,
+ *               then in a temporary file mapped in memory.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_CAPTURE_H
+#define PROCESS_CAPTURE_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QString>
+
+#define PROCESS_CAPTURE_BUDGET      (1 << 20)       // Bytes kept in memory by default before spilling to disk
+#define PROCESS_CAPTURE_CHUNK_SIZE  65536           // Bytes read from the device at once
+
+class QIODevice;
+class QTemporaryFile;
+
+namespace QtSampleCodes
+{
+
+/**
+ * Output of a process kept in memory while it fits in the budget. Past the budget, it is moved
+ * to a temporary file and new data is appended there: the memory used stays bounded whatever
+ * the size of the output.
+ *
+ * The whole output is readable without copy with data(): the memory buffer, or the temporary
+ * file mapped read-only. The view is valid until the next append or clear.
+ */
+class ProcessCapture
+{
+
+public:
+
+    explicit ProcessCapture(qint64 budget = PROCESS_CAPTURE_BUDGET);
+    ~ProcessCapture();
+
+    /**
+     * Bytes kept in memory, 0 to always write to disk. Applies to the next appends.
+     */
+    void        setMemoryBudget(qint64 budget);
+    qint64      memoryBudget()                                          const;
+
+    /**
+     * Return false if the temporary file cannot be written: data is lost, errorString() tells why,
+     * and the next appends fail until clear().
+     */
+    bool        append(const char* data, qint64 size);
+    bool        append(const QByteArray& data);
+
+    /**
+     * Append all available data of device, by chunks. Return the number of bytes appended.
+     * Reading stops at the first chunk which cannot be appended.
+     */
+    qint64      readFrom(QIODevice* const device);
+
+    /**
+     * Empty while the whole output is captured.
+     */
+    QString     errorString()                                           const;
+
+    void        clear();
+
+    qint64      size()                                                  const;
+    bool        isSpilled()                                             const;
+    QString     fileName()                                              const;
+
+    /**
+     * Whole output, without copy. nullptr if empty or if the file cannot be mapped.
+     */
+    const char* data();
+
+    /**
+     * Views sharing data(): deep copy them to keep them after the next append.
+     */
+    QByteArray  view();
+    QByteArray  tail(qint64 size);
+
+    /**
+     * Position of the first needle at or after from, -1 if not found.
+     */
+    qint64      indexOf(const QByteArray& needle, qint64 from = 0);
+
+private:
+
+    bool        spill();
+    void        unmap();
+
+private:
+
+    Q_DISABLE_COPY(ProcessCapture)
+
+    qint64          m_budget;
+    qint64          m_size;
+    QByteArray      m_buffer;
+    QTemporaryFile* m_file;
+    uchar*          m_map;
+    qint64          m_mapSize;
+    QString         m_error;
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_CAPTURE_H
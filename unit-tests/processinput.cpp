@@ -0,0 +1,454 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Stream a file or generated data to the standard input
+ *               of a process, with bounded memory.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processinput.h"
+
+// C++ includes
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+// Qt includes
+
+#include <QSocketNotifier>
+
+#ifdef Q_OS_LINUX
+
+// Linux includes
+
+#   include <fcntl.h>
+#   include <sys/sendfile.h>
+#   include <unistd.h>
+
+#endif
+
+namespace QtSampleCodes
+{
+
+ProcessInput::ProcessInput(QProcess* const process)
+    : QObject(process),
+      m_process(process),
+      m_mode(None),
+      m_map(nullptr),
+      m_position(0),
+      m_remaining(0),
+      m_bufferStart(0),
+      m_bufferEnd(0),
+      m_readFd(-1),
+      m_writeFd(-1),
+      m_notifier(nullptr),
+      m_sent(0),
+      m_finished(false)
+{
+    connect(m_process, SIGNAL(started()),
+            this, SLOT(slotStarted()));
+
+    connect(m_process, SIGNAL(error(QProcess::ProcessError)),
+            this, SLOT(slotProcessError(QProcess::ProcessError)));
+}
+
+ProcessInput::~ProcessInput()
+{
+    closePipe();
+
+#ifdef Q_OS_LINUX
+
+    if (m_readFd >= 0)
+    {
+        close(m_readFd);
+    }
+
+#endif
+
+}
+
+bool ProcessInput::setFile(const QString& path, qint64 offset, qint64 length)
+{
+    m_file.setFileName(path);
+
+    if (!m_file.open(QIODevice::ReadOnly) || (offset < 0) || (offset > m_file.size()))
+    {
+        m_errorString = m_file.errorString();
+
+        return false;
+    }
+
+    m_position  = offset;
+    m_remaining = ((length < 0) || (offset + length > m_file.size())) ? m_file.size() - offset : length;
+
+    // The child reads the whole file itself.
+
+    if ((offset == 0) && (m_remaining == m_file.size()))
+    {
+        m_file.close();
+        m_process->setStandardInputFile(path);
+        m_mode = WholeFile;
+
+        return true;
+    }
+
+    if (preparePipe())
+    {
+        return true;
+    }
+
+    if (m_remaining > 0)
+    {
+        m_map = m_file.map(offset, m_remaining);
+
+        if (!m_map)
+        {
+            m_errorString = m_file.errorString();
+
+            return false;
+        }
+    }
+
+    m_mode = Paced;
+
+    return true;
+}
+
+void ProcessInput::setGenerator(const Generator& generator)
+{
+    m_generator = generator;
+    m_buffer    = QByteArray(PROCESS_INPUT_CHUNK_SIZE, Qt::Uninitialized);
+
+    if (!preparePipe())
+    {
+        m_mode = Paced;
+    }
+}
+
+qint64 ProcessInput::bytesSent() const
+{
+    return m_sent;
+}
+
+bool ProcessInput::isFinished() const
+{
+    return m_finished;
+}
+
+QString ProcessInput::errorString() const
+{
+    return m_errorString;
+}
+
+bool ProcessInput::preparePipe()
+{
+
+#ifdef Q_OS_LINUX
+
+    int fds[2];
+
+    if (pipe2(fds, O_CLOEXEC) != 0)
+    {
+        return false;
+    }
+
+    // QProcess opens the read end again in start(), and makes it the child stdin.
+
+    m_readFd  = fds[0];
+    m_writeFd = fds[1];
+    m_mode    = Pipe;
+    m_process->setStandardInputFile(QString::fromLatin1("/proc/self/fd/%1").arg(m_readFd));
+
+    return true;
+
+#else
+
+    return false;
+
+#endif
+
+}
+
+void ProcessInput::ignoreSigpipe()
+{
+
+#ifdef Q_OS_LINUX
+
+    struct sigaction current;
+
+    if ((sigaction(SIGPIPE, nullptr, &current) == 0) && (current.sa_handler == SIG_DFL))
+    {
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+#endif
+
+}
+
+void ProcessInput::slotStarted()
+{
+    switch (m_mode)
+    {
+        case WholeFile:
+            m_sent = m_remaining;
+            finish();
+            break;
+
+        case Pipe:
+
+#ifdef Q_OS_LINUX
+
+            // Only the child keeps the read end: it gets EOF when we close the write end.
+
+            close(m_readFd);
+            m_readFd = -1;
+
+            ignoreSigpipe();
+            fcntl(m_writeFd, F_SETFL, fcntl(m_writeFd, F_GETFL) | O_NONBLOCK);
+
+            m_notifier = new QSocketNotifier(m_writeFd, QSocketNotifier::Write, this);
+
+            connect(m_notifier, SIGNAL(activated(int)),
+                    this, SLOT(slotPump()));
+
+#endif
+
+            slotPump();
+            break;
+
+        case Paced:
+            connect(m_process, SIGNAL(bytesWritten(qint64)),
+                    this, SLOT(slotPump()));
+
+            slotPump();
+            break;
+
+        default:
+            break;
+    }
+}
+
+void ProcessInput::slotProcessError(QProcess::ProcessError error)
+{
+    if ((error == QProcess::FailedToStart) && !m_finished)
+    {
+
+#ifdef Q_OS_LINUX
+
+        if (m_readFd >= 0)
+        {
+            close(m_readFd);
+            m_readFd = -1;
+        }
+
+#endif
+
+        finish(m_process->errorString());
+    }
+}
+
+void ProcessInput::slotPump()
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    if (m_mode == Pipe)
+    {
+        pumpPipe();
+    }
+    else
+    {
+        pumpPaced();
+    }
+}
+
+void ProcessInput::pumpPipe()
+{
+
+#ifdef Q_OS_LINUX
+
+    // Until the pipe is full: the notifier calls again when the child has read.
+
+    while (!m_finished)
+    {
+        ssize_t size = 0;
+
+        if (m_file.isOpen())
+        {
+            if (m_remaining == 0)
+            {
+                finish();
+                break;
+            }
+
+            off_t position = off_t(m_position);
+            size           = sendfile(m_writeFd, m_file.handle(), &position,
+                                      size_t(qMin(m_remaining, qint64(PROCESS_INPUT_CHUNK_SIZE))));
+
+            if (size > 0)
+            {
+                m_position   = position;
+                m_remaining -= size;
+            }
+            else if (size == 0)
+            {
+                finish(QLatin1String("File truncated while sending it"));
+                break;
+            }
+        }
+        else
+        {
+            if (m_bufferStart == m_bufferEnd)
+            {
+                const qint64 count = m_generator ? m_generator(m_buffer.data(), m_buffer.size()) : 0;
+
+                if (count <= 0)
+                {
+                    finish((count < 0) ? QString(QLatin1String("Input generator failed")) : QString());
+                    break;
+                }
+
+                m_bufferStart = 0;
+                m_bufferEnd   = int(qMin(count, qint64(m_buffer.size())));
+            }
+
+            size = write(m_writeFd, m_buffer.constData() + m_bufferStart, size_t(m_bufferEnd - m_bufferStart));
+
+            if (size > 0)
+            {
+                m_bufferStart += int(size);
+            }
+        }
+
+        if (size < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (errno != EAGAIN)
+            {
+                finish(QString::fromLocal8Bit(strerror(errno)));
+            }
+
+            break;
+        }
+
+        m_sent += size;
+    }
+
+#endif
+
+}
+
+void ProcessInput::pumpPaced()
+{
+    // QProcess copies the chunks in its buffer: only a bounded amount is queued at a time.
+
+    while (!m_finished && (m_process->bytesToWrite() < PROCESS_INPUT_MAX_PENDING))
+    {
+        qint64 size = 0;
+
+        if (m_map || m_file.isOpen())
+        {
+            if (m_remaining == 0)
+            {
+                finish();
+                break;
+            }
+
+            size = m_process->write(reinterpret_cast<const char*>(m_map) + m_sent, qMin(m_remaining, qint64(PROCESS_INPUT_CHUNK_SIZE)));
+
+            if (size > 0)
+            {
+                m_remaining -= size;
+            }
+        }
+        else
+        {
+            const qint64 count = m_generator ? m_generator(m_buffer.data(), m_buffer.size()) : 0;
+
+            if (count <= 0)
+            {
+                finish((count < 0) ? QString(QLatin1String("Input generator failed")) : QString());
+                break;
+            }
+
+            size = m_process->write(m_buffer.constData(), qMin(count, qint64(m_buffer.size())));
+        }
+
+        if (size < 0)
+        {
+            finish(m_process->errorString());
+            break;
+        }
+
+        m_sent += size;
+    }
+}
+
+void ProcessInput::finish(const QString& error)
+{
+    m_finished    = true;
+    m_errorString = error;
+
+    if      (m_mode == Pipe)
+    {
+        closePipe();
+    }
+    else if (m_mode == Paced)
+    {
+        // Closed once the queued data is written.
+
+        m_process->closeWriteChannel();
+    }
+
+    if (m_map)
+    {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+
+    m_file.close();
+
+    emit signalFinished();
+}
+
+void ProcessInput::closePipe()
+{
+    if (m_notifier)
+    {
+        m_notifier->setEnabled(false);
+        m_notifier->deleteLater();
+        m_notifier = nullptr;
+    }
+
+    if (m_writeFd >= 0)
+    {
+
+#ifdef Q_OS_LINUX
+        close(m_writeFd);
+#endif
+
+        m_writeFd = -1;
+    }
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,140 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Stream a file or generated data to the standard input
+ *               of a process, with bounded memory.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_INPUT_H
+#define PROCESS_INPUT_H
+
+// C++ includes
+
+#include <functional>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QProcess>
+
+#define PROCESS_INPUT_CHUNK_SIZE    65536       // Bytes written to the child at once
+#define PROCESS_INPUT_MAX_PENDING   (1 << 18)   // Bytes queued in QProcess before waiting for bytesWritten()
+
+class QSocketNotifier;
+
+namespace QtSampleCodes
+{
+
+/**
+ * Feed the standard input of a process, set before starting it. Input is written as the child
+ * reads it: the parent holds at most a chunk, never the whole input.
+ *
+ *  - A whole file is opened by QProcess as the child stdin: the child reads it directly.
+ *  - On Linux, a file range or a generator goes through a pipe of our own, given to the child as
+ *    its stdin through /proc/self/fd. File data is moved with sendfile(), without copy in user
+ *    space, and writes are driven by the pipe becoming writable.
+ *  - Elsewhere, chunks are written with QProcess::write(), a mapped file range without reading
+ *    it first, paced by bytesWritten().
+ *
+ * Needs the event loop: QProcess::waitForFinished() does not run the pipe notifier.
+ */
+class ProcessInput : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Fill data with at most maxSize bytes, return their count: 0 at the end, -1 on error.
+     */
+    typedef std::function<qint64(char* data, qint64 maxSize)> Generator;
+
+public:
+
+    explicit ProcessInput(QProcess* const process);
+    ~ProcessInput();
+
+    /**
+     * length bytes of the file from offset, -1 up to its end.
+     */
+    bool    setFile(const QString& path, qint64 offset = 0, qint64 length = -1);
+    void    setGenerator(const Generator& generator);
+
+    qint64  bytesSent()                                 const;
+    bool    isFinished()                                const;
+    QString errorString()                               const;
+
+    /**
+     * A child closing its end of a pipe of ours must fail our writes with EPIPE, not kill us:
+     * SIGPIPE is ignored if nobody handles it, as QProcess does.
+     */
+    static void ignoreSigpipe();
+
+Q_SIGNALS:
+
+    /**
+     * All input is written and stdin is closed, or writing failed.
+     */
+    void signalFinished();
+
+private Q_SLOTS:
+
+    void slotStarted();
+    void slotProcessError(QProcess::ProcessError error);
+    void slotPump();
+
+private:
+
+    enum Mode
+    {
+        None = 0,
+        WholeFile,
+        Pipe,
+        Paced
+    };
+
+    bool    preparePipe();
+    void    pumpPipe();
+    void    pumpPaced();
+    void    finish(const QString& error = QString());
+    void    closePipe();
+
+private:
+
+    QProcess*        m_process;
+    Mode             m_mode;
+    QFile            m_file;
+    uchar*           m_map;
+    qint64           m_position;
+    qint64           m_remaining;
+    Generator        m_generator;
+    QByteArray       m_buffer;
+    int              m_bufferStart;
+    int              m_bufferEnd;
+    int              m_readFd;
+    int              m_writeFd;
+    QSocketNotifier* m_notifier;
+    qint64           m_sent;
+    bool             m_finished;
+    QString          m_errorString;
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_INPUT_H
@@ -0,0 +1,924 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Launch child processes from a small helper forked
+ *               early, instead of forking the whole caller.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processlauncher.h"
+
+// C++ includes
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <map>
+#include <vector>
+
+// Qt includes
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QSocketNotifier>
+
+// Linux includes
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PROCESS_LAUNCHER_MERGED     0x1         // Request flag: stderr is sent to the stdout pipe
+#define PROCESS_LAUNCHER_SIGNAL     0x2         // Request flag: signal a child instead of spawning one
+
+extern char** environ;
+
+namespace QtSampleCodes
+{
+
+struct LauncherReply
+{
+    qint64 pid;
+    int    error;
+};
+
+/**
+ * Request following the PROCESS_LAUNCHER_SIGNAL flag.
+ */
+struct LauncherSignal
+{
+    qint64 pid;
+    int    signal;
+};
+
+/**
+ * Written at once in the status pipe: smaller than PIPE_BUF, so never split.
+ */
+struct LauncherStatus
+{
+    int    status;
+    rusage usage;
+};
+
+void s_launcherSend(int socket, const LauncherReply& reply, const int* const fds, int count)
+{
+    union
+    {
+        cmsghdr align;
+        char    buffer[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+
+    iovec  iov = { const_cast<LauncherReply*>(&reply), sizeof(reply) };
+    msghdr msg;
+    memset(&msg,     0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+
+    msg.msg_iov    = &iov;
+    msg.msg_iovlen = 1;
+
+    if (count > 0)
+    {
+        msg.msg_control    = control.buffer;
+        msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+
+        cmsghdr* const cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level    = SOL_SOCKET;
+        cmsg->cmsg_type     = SCM_RIGHTS;
+        cmsg->cmsg_len      = CMSG_LEN(count * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+    }
+
+    sendmsg(socket, &msg, MSG_NOSIGNAL);
+}
+
+/**
+ * Request: the flags, then the program and its arguments, each ended by a null byte.
+ */
+void s_launcherSpawn(int socket, char* const request, ssize_t size, std::map<pid_t, int>& statusFds)
+{
+    LauncherReply reply = { -1, 0 };
+    quint32       flags = 0;
+
+    if (size <= ssize_t(sizeof(flags)))
+    {
+        reply.error = EINVAL;
+        s_launcherSend(socket, reply, nullptr, 0);
+
+        return;
+    }
+
+    memcpy(&flags, request, sizeof(flags));
+
+    std::vector<char*> argv;
+
+    for (char* arg = request + sizeof(flags) ; arg < request + size ; arg += strlen(arg) + 1)
+    {
+        argv.push_back(arg);
+    }
+
+    argv.push_back(nullptr);
+
+    const bool merged    = (flags & PROCESS_LAUNCHER_MERGED);
+    int        output[2] = { -1, -1 };
+    int        error[2]  = { -1, -1 };
+    int        status[2] = { -1, -1 };
+
+    if ((pipe2(output, O_CLOEXEC) != 0) || (!merged && (pipe2(error, O_CLOEXEC) != 0)) || (pipe2(status, O_CLOEXEC) != 0))
+    {
+        reply.error = errno;
+    }
+    else
+    {
+        // The helper blocks SIGCHLD and ignores SIGPIPE: the child gets the defaults back.
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&actions, output[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, merged ? output[1] : error[1], STDERR_FILENO);
+
+        sigset_t mask;
+        sigset_t defaults;
+        sigemptyset(&mask);
+        sigemptyset(&defaults);
+        sigaddset(&defaults, SIGCHLD);
+        sigaddset(&defaults, SIGPIPE);
+
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+        posix_spawnattr_setsigmask(&attr, &mask);
+        posix_spawnattr_setsigdefault(&attr, &defaults);
+
+        pid_t pid   = -1;
+        reply.error = posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), environ);
+
+        posix_spawnattr_destroy(&attr);
+        posix_spawn_file_actions_destroy(&actions);
+
+        if (reply.error == 0)
+        {
+            reply.pid      = pid;
+            statusFds[pid] = status[1];
+            status[1]      = -1;
+        }
+    }
+
+    if (reply.pid > 0)
+    {
+        const int fds[3] = { output[0], merged ? status[0] : error[0], status[0] };
+        s_launcherSend(socket, reply, fds, merged ? 2 : 3);
+    }
+    else
+    {
+        s_launcherSend(socket, reply, nullptr, 0);
+    }
+
+    // The caller has its own copies now, the write ends belong to the child.
+
+    const int fds[6] = { output[0], output[1], error[0], error[1], status[0], status[1] };
+
+    for (int i = 0 ; i < 6 ; ++i)
+    {
+        if (fds[i] >= 0)
+        {
+            close(fds[i]);
+        }
+    }
+}
+
+/**
+ * Signal a child not reaped yet: a zombie keeps its pid, which cannot be reused meanwhile.
+ */
+void s_launcherSignal(int socket, const char* const request, ssize_t size, const std::map<pid_t, int>& statusFds)
+{
+    LauncherReply  reply  = { -1, 0 };
+    LauncherSignal target = { -1, 0 };
+
+    if (size != ssize_t(sizeof(quint32) + sizeof(target)))
+    {
+        reply.error = EINVAL;
+    }
+    else
+    {
+        memcpy(&target, request + sizeof(quint32), sizeof(target));
+
+        if      (statusFds.find(pid_t(target.pid)) == statusFds.end())
+        {
+            reply.error = ESRCH;
+        }
+        else if (kill(pid_t(target.pid), target.signal) != 0)
+        {
+            reply.error = errno;
+        }
+        else
+        {
+            reply.pid = target.pid;
+        }
+    }
+
+    s_launcherSend(socket, reply, nullptr, 0);
+}
+
+/**
+ * Send the wait status and resource usage of the exited children to their status pipe.
+ */
+void s_launcherReap(std::map<pid_t, int>& statusFds)
+{
+    LauncherStatus status;
+    pid_t          pid = 0;
+
+    while ((pid = wait4(-1, &status.status, WNOHANG, &status.usage)) > 0)
+    {
+        std::map<pid_t, int>::iterator it = statusFds.find(pid);
+
+        if (it != statusFds.end())
+        {
+            ssize_t written;
+
+            do
+            {
+                written = write(it->second, &status, sizeof(status));
+            }
+            while ((written < 0) && (errno == EINTR));
+
+            close(it->second);
+            statusFds.erase(it);
+        }
+    }
+}
+
+/**
+ * Main loop of the helper, until the caller closes the socket. Only POSIX calls here: Qt is not
+ * used in the forked process.
+ */
+void s_launcherServe(int socket)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    const int            signals = signalfd(-1, &mask, SFD_CLOEXEC);
+    std::map<pid_t, int> statusFds;
+    std::vector<char>    request(PROCESS_LAUNCHER_MAX_REQUEST + 1);
+
+    while (signals >= 0)
+    {
+        pollfd fds[2] =
+        {
+            { socket,  POLLIN, 0 },
+            { signals, POLLIN, 0 }
+        };
+
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            signalfd_siginfo info;
+
+            if (read(signals, &info, sizeof(info)) > 0)
+            {
+                s_launcherReap(statusFds);
+            }
+        }
+
+        if (fds[0].revents)
+        {
+            const ssize_t size = recv(socket, request.data(), PROCESS_LAUNCHER_MAX_REQUEST, 0);
+
+            if (size <= 0)
+            {
+                break;
+            }
+
+            quint32 flags = 0;
+
+            if (size >= ssize_t(sizeof(flags)))
+            {
+                memcpy(&flags, request.data(), sizeof(flags));
+            }
+
+            request[size] = '\0';
+
+            if (flags & PROCESS_LAUNCHER_SIGNAL)
+            {
+                s_launcherSignal(socket, request.data(), size, statusFds);
+            }
+            else
+            {
+                s_launcherSpawn(socket, request.data(), size, statusFds);
+            }
+        }
+    }
+
+    for (std::map<pid_t, int>::const_iterator it = statusFds.begin() ; it != statusFds.end() ; ++it)
+    {
+        close(it->second);
+    }
+
+    if (signals >= 0)
+    {
+        close(signals);
+    }
+
+    close(socket);
+}
+
+// ---------------------------------------------------------------------
+
+ProcessLauncher::ProcessLauncher()
+    : m_socket(-1),
+      m_pid(-1)
+{
+}
+
+ProcessLauncher::~ProcessLauncher()
+{
+    stop();
+}
+
+bool ProcessLauncher::start()
+{
+    if (isRunning())
+    {
+        return true;
+    }
+
+    int sockets[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0)
+    {
+        return false;
+    }
+
+    const pid_t pid = fork();
+
+    if (pid < 0)
+    {
+        close(sockets[0]);
+        close(sockets[1]);
+
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        close(sockets[0]);
+        s_launcherServe(sockets[1]);
+        _exit(0);
+    }
+
+    close(sockets[1]);
+
+    m_socket = sockets[0];
+    m_pid    = pid;
+
+    return true;
+}
+
+void ProcessLauncher::stop()
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (m_socket >= 0)
+    {
+        // The helper exits when the socket is closed.
+
+        close(m_socket);
+        waitpid(pid_t(m_pid), nullptr, 0);
+
+        m_socket = -1;
+        m_pid    = -1;
+    }
+}
+
+bool ProcessLauncher::isRunning() const
+{
+    return (m_socket >= 0);
+}
+
+qint64 ProcessLauncher::spawn(const QString& program, const QStringList& arguments, bool merged,
+                              int* const fds, int* const error)
+{
+    int            code  = 0;
+    const quint32  flags = merged ? PROCESS_LAUNCHER_MERGED : 0;
+    QByteArray     request(sizeof(flags), Qt::Uninitialized);
+    LauncherReply  reply = { -1, 0 };
+
+    memcpy(request.data(), &flags, sizeof(flags));
+    request.append(program.toLocal8Bit()).append('\0');
+
+    foreach (const QString& arg, arguments)
+    {
+        request.append(arg.toLocal8Bit()).append('\0');
+    }
+
+    fds[0] = -1;
+    fds[1] = -1;
+    fds[2] = -1;
+
+    int          received[3] = { -1, -1, -1 };
+    QMutexLocker lock(&m_mutex);
+
+    if (request.size() > PROCESS_LAUNCHER_MAX_REQUEST)
+    {
+        code = E2BIG;
+    }
+    else
+    {
+        code = transact(request, &reply, sizeof(reply), received);
+    }
+
+    if      ((code == 0) && (reply.pid <= 0))
+    {
+        code = reply.error;
+    }
+    else if (code == 0)
+    {
+        fds[0] = received[0];
+        fds[1] = merged ? -1          : received[1];
+        fds[2] = merged ? received[1] : received[2];
+    }
+
+    if (error)
+    {
+        *error = code;
+    }
+
+    return ((code == 0) ? reply.pid : -1);
+}
+
+bool ProcessLauncher::signalChild(qint64 pid, int signal, int* const error)
+{
+    const quint32        flags  = PROCESS_LAUNCHER_SIGNAL;
+    const LauncherSignal target = { pid, signal };
+    QByteArray           request(int(sizeof(flags) + sizeof(target)), Qt::Uninitialized);
+    LauncherReply        reply  = { -1, 0 };
+    int                  unused[3];
+
+    memcpy(request.data(),                 &flags,  sizeof(flags));
+    memcpy(request.data() + sizeof(flags), &target, sizeof(target));
+
+    QMutexLocker lock(&m_mutex);
+
+    int code = transact(request, &reply, sizeof(reply), unused);
+
+    if (code == 0)
+    {
+        code = reply.error;
+    }
+
+    if (error)
+    {
+        *error = code;
+    }
+
+    return (code == 0);
+}
+
+int ProcessLauncher::transact(const QByteArray& request, void* const reply, int size, int* const fds)
+{
+    if (m_socket < 0)
+    {
+        return ENOTCONN;
+    }
+
+    if (send(m_socket, request.constData(), request.size(), MSG_NOSIGNAL) != request.size())
+    {
+        return errno;
+    }
+
+    union
+    {
+        cmsghdr align;
+        char    buffer[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+
+    iovec  iov = { reply, size_t(size) };
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    ssize_t received;
+
+    do
+    {
+        received = recvmsg(m_socket, &msg, MSG_CMSG_CLOEXEC);
+    }
+    while ((received < 0) && (errno == EINTR));
+
+    const cmsghdr* const cmsg  = (received == ssize_t(size)) ? CMSG_FIRSTHDR(&msg) : nullptr;
+    const int            count = cmsg ? int((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int)) : 0;
+
+    fds[0] = -1;
+    fds[1] = -1;
+    fds[2] = -1;
+
+    if (cmsg && (cmsg->cmsg_type == SCM_RIGHTS) && (count <= 3))
+    {
+        memcpy(fds, CMSG_DATA(cmsg), count * sizeof(int));
+    }
+
+    if (received != ssize_t(size))
+    {
+        return ((received < 0) ? errno : EPROTO);
+    }
+
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+
+LauncherProcess::LauncherProcess(ProcessLauncher* const launcher, QObject* const parent)
+    : QObject(parent),
+      m_launcher(launcher),
+      m_mode(QProcess::SeparateChannels),
+      m_state(QProcess::NotRunning),
+      m_pid(0),
+      m_exitCode(0),
+      m_exitStatus(QProcess::NormalExit)
+{
+    for (int i = 0 ; i < ChannelCount ; ++i)
+    {
+        m_fds[i]       = -1;
+        m_notifiers[i] = nullptr;
+    }
+}
+
+LauncherProcess::~LauncherProcess()
+{
+    kill();
+
+    for (int i = 0 ; i < ChannelCount ; ++i)
+    {
+        closeChannel(i);
+    }
+}
+
+void LauncherProcess::setProgram(const QString& program)
+{
+    m_program = program;
+}
+
+QString LauncherProcess::program() const
+{
+    return m_program;
+}
+
+void LauncherProcess::setArguments(const QStringList& arguments)
+{
+    m_arguments = arguments;
+}
+
+QStringList LauncherProcess::arguments() const
+{
+    return m_arguments;
+}
+
+void LauncherProcess::setProcessChannelMode(QProcess::ProcessChannelMode mode)
+{
+    m_mode = mode;
+}
+
+void LauncherProcess::start()
+{
+    if (m_state != QProcess::NotRunning)
+    {
+        return;
+    }
+
+    int code = ENOTCONN;
+
+    m_exitCode   = 0;
+    m_exitStatus = QProcess::NormalExit;
+    m_usage      = ProcessUsage();
+    m_buffers[Output].clear();
+    m_buffers[Error].clear();
+
+    m_pid = m_launcher ? m_launcher->spawn(m_program, m_arguments, (m_mode == QProcess::MergedChannels), m_fds, &code)
+                       : -1;
+
+    if (m_pid <= 0)
+    {
+        m_pid         = 0;
+        m_errorString = QString::fromLocal8Bit(strerror(code));
+
+        emit error(QProcess::FailedToStart);
+
+        return;
+    }
+
+    for (int i = 0 ; i < ChannelCount ; ++i)
+    {
+        if (m_fds[i] >= 0)
+        {
+            fcntl(m_fds[i], F_SETFL, fcntl(m_fds[i], F_GETFL) | O_NONBLOCK);
+
+            m_notifiers[i] = new QSocketNotifier(m_fds[i], QSocketNotifier::Read, this);
+
+            connect(m_notifiers[i], SIGNAL(activated(int)),
+                    this, SLOT(slotActivated(int)));
+        }
+    }
+
+    m_state = QProcess::Running;
+
+    emit started();
+}
+
+bool LauncherProcess::waitForFinished(int msecs)
+{
+    if (m_state != QProcess::Running)
+    {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (m_state == QProcess::Running)
+    {
+        pollfd fds[ChannelCount];
+        int    channels[ChannelCount];
+        int    count = 0;
+
+        for (int i = 0 ; i < ChannelCount ; ++i)
+        {
+            if (m_fds[i] >= 0)
+            {
+                fds[count].fd      = m_fds[i];
+                fds[count].events  = POLLIN;
+                fds[count].revents = 0;
+                channels[count]    = i;
+                count++;
+            }
+        }
+
+        const int remaining = (msecs < 0) ? -1 : int(qMax(qint64(0), msecs - timer.elapsed()));
+        const int ready     = poll(fds, nfds_t(count), remaining);
+
+        if ((ready < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+
+        if (ready <= 0)
+        {
+            return false;
+        }
+
+        // The status closes the other channels: they are checked again before use.
+
+        for (int i = 0 ; i < count ; ++i)
+        {
+            if (fds[i].revents && (m_fds[channels[i]] == fds[i].fd))
+            {
+                handle(channels[i]);
+            }
+        }
+    }
+
+    return true;
+}
+
+void LauncherProcess::terminate()
+{
+    // Through the helper: the child may be reaped already, and its pid reused.
+
+    if ((m_state == QProcess::Running) && (m_pid > 0) && m_launcher)
+    {
+        m_launcher->signalChild(m_pid, SIGTERM);
+    }
+}
+
+void LauncherProcess::kill()
+{
+    if ((m_state == QProcess::Running) && (m_pid > 0) && m_launcher)
+    {
+        m_launcher->signalChild(m_pid, SIGKILL);
+    }
+}
+
+QProcess::ProcessState LauncherProcess::state() const
+{
+    return m_state;
+}
+
+qint64 LauncherProcess::processId() const
+{
+    return m_pid;
+}
+
+int LauncherProcess::exitCode() const
+{
+    return m_exitCode;
+}
+
+QProcess::ExitStatus LauncherProcess::exitStatus() const
+{
+    return m_exitStatus;
+}
+
+QString LauncherProcess::errorString() const
+{
+    return m_errorString;
+}
+
+ProcessUsage LauncherProcess::usage() const
+{
+    return m_usage;
+}
+
+QByteArray LauncherProcess::readAllStandardOutput()
+{
+    QByteArray data;
+    data.swap(m_buffers[Output]);
+
+    return data;
+}
+
+QByteArray LauncherProcess::readAllStandardError()
+{
+    QByteArray data;
+    data.swap(m_buffers[Error]);
+
+    return data;
+}
+
+void LauncherProcess::slotActivated(int fd)
+{
+    for (int i = 0 ; i < ChannelCount ; ++i)
+    {
+        if (m_fds[i] == fd)
+        {
+            handle(i);
+
+            return;
+        }
+    }
+}
+
+void LauncherProcess::handle(int channel)
+{
+    if (channel == Status)
+    {
+        readStatus();
+    }
+    else if (readChannel(channel) > 0)
+    {
+        if (channel == Output)
+        {
+            emit readyReadStandardOutput();
+        }
+        else
+        {
+            emit readyReadStandardError();
+        }
+    }
+}
+
+qint64 LauncherProcess::readChannel(int channel)
+{
+    char   chunk[PROCESS_LAUNCHER_CHUNK_SIZE];
+    qint64 total = 0;
+
+    while (m_fds[channel] >= 0)
+    {
+        const ssize_t size = read(m_fds[channel], chunk, sizeof(chunk));
+
+        if (size > 0)
+        {
+            m_buffers[channel].append(chunk, int(size));
+            total += size;
+
+            continue;
+        }
+
+        if ((size < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+
+        if ((size == 0) || (errno != EAGAIN))
+        {
+            closeChannel(channel);
+        }
+
+        break;
+    }
+
+    return total;
+}
+
+void LauncherProcess::readStatus()
+{
+    LauncherStatus status;
+    ssize_t        size;
+
+    memset(&status, 0, sizeof(status));
+
+    do
+    {
+        size = read(m_fds[Status], &status, sizeof(status));
+    }
+    while ((size < 0) && (errno == EINTR));
+
+    if ((size < 0) && (errno == EAGAIN))
+    {
+        return;
+    }
+
+    closeChannel(Status);
+
+    // Exit code and signal as QProcess reports them. A helper gone before the child is a crash.
+
+    const bool received = (size == ssize_t(sizeof(status)));
+
+    if      (received && WIFEXITED(status.status))
+    {
+        m_exitCode   = WEXITSTATUS(status.status);
+        m_exitStatus = QProcess::NormalExit;
+    }
+    else if (received && WIFSIGNALED(status.status))
+    {
+        m_exitCode   = WTERMSIG(status.status);
+        m_exitStatus = QProcess::CrashExit;
+    }
+    else
+    {
+        m_exitCode   = -1;
+        m_exitStatus = QProcess::CrashExit;
+    }
+
+    if (received)
+    {
+        m_usage.setRusage(status.usage);
+    }
+
+    // The output written before the exit is still in the pipes.
+
+    for (int i = Output ; i < Status ; ++i)
+    {
+        handle(i);
+        closeChannel(i);
+    }
+
+    m_state = QProcess::NotRunning;
+    m_pid   = 0;
+
+    emit finished(m_exitCode, m_exitStatus);
+}
+
+void LauncherProcess::closeChannel(int channel)
+{
+    // Deleted later: this can be called from the activated() signal of the notifier.
+
+    if (m_notifiers[channel])
+    {
+        m_notifiers[channel]->setEnabled(false);
+        m_notifiers[channel]->deleteLater();
+        m_notifiers[channel] = nullptr;
+    }
+
+    if (m_fds[channel] >= 0)
+    {
+        close(m_fds[channel]);
+        m_fds[channel] = -1;
+    }
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,205 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Launch child processes from a small helper forked
+ *               early, instead of forking the whole caller.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_LAUNCHER_H
+#define PROCESS_LAUNCHER_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QProcess>
+#include <QStringList>
+
+// Local includes
+
+#include "processusage.h"
+
+#define PROCESS_LAUNCHER_MAX_REQUEST    65536       // Bytes of program and arguments sent to the helper
+#define PROCESS_LAUNCHER_CHUNK_SIZE     65536       // Bytes read from a child pipe at once
+
+class QSocketNotifier;
+
+namespace QtSampleCodes
+{
+
+/**
+ * Helper process forked by start(), spawning the children on request over a Unix socket.
+ *
+ * QProcess forks the caller, which copies the page tables of its whole address space: with a
+ * large caller, this dominates the launch of short tools. The helper is forked while the caller
+ * is still small and has one thread, so call start() first in main(). It starts the children with
+ * posix_spawnp(), which uses vfork in the C library, and passes the read ends of their stdout,
+ * stderr and exit status pipes back to the caller. The helper reaps them with wait4(): the exit
+ * status comes with the resources they used.
+ *
+ * Children inherit the working directory and environment of the helper, taken when it was forked.
+ * They are signaled through the helper too: only it knows whether a pid is still its child, or
+ * already reaped and free to be reused by another process.
+ */
+class ProcessLauncher
+{
+
+public:
+
+    ProcessLauncher();
+    ~ProcessLauncher();
+
+    bool   start();
+
+    /**
+     * Stop the helper. Running children are not killed: their exit status is lost.
+     */
+    void   stop();
+
+    bool   isRunning()                                                                  const;
+
+    /**
+     * Spawn a child with stdin on /dev/null. On success, return its pid and set fds to the pipes of
+     * its stdout, stderr (-1 if merged in stdout) and exit status, closed on exec, owned by the caller.
+     * Otherwise return -1 and set error to an errno value. Thread-safe.
+     */
+    qint64 spawn(const QString& program, const QStringList& arguments, bool merged,
+                 int* const fds, int* const error = nullptr);
+
+    /**
+     * Send signal to a child spawned by this launcher, unless it is already reaped. Return false
+     * and set error to an errno value otherwise. Thread-safe.
+     */
+    bool   signalChild(qint64 pid, int signal, int* const error = nullptr);
+
+private:
+
+    /**
+     * Send a request and receive its reply, with the file descriptors passed along, -1 if none.
+     * Return 0 or an errno value. Called with the mutex locked.
+     */
+    int    transact(const QByteArray& request, void* const reply, int size, int* const fds);
+
+private:
+
+    Q_DISABLE_COPY(ProcessLauncher)
+
+    int    m_socket;
+    qint64 m_pid;
+    QMutex m_mutex;
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Child started by a ProcessLauncher, with the signals and accessors of QProcess used by the
+ * tests: it can replace a QProcess in the code reading its output. Only SeparateChannels and
+ * MergedChannels modes are supported.
+ */
+class LauncherProcess : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit LauncherProcess(ProcessLauncher* const launcher, QObject* const parent = nullptr);
+    ~LauncherProcess();
+
+    void                        setProgram(const QString& program);
+    QString                     program()                                           const;
+
+    void                        setArguments(const QStringList& arguments);
+    QStringList                 arguments()                                         const;
+
+    void                        setProcessChannelMode(QProcess::ProcessChannelMode mode);
+
+    /**
+     * started() or error() are emitted before returning.
+     */
+    void                        start();
+
+    /**
+     * Process the child pipes without the event loop, like QProcess: signals are emitted from
+     * this call. Return false on timeout or if the child is not running.
+     */
+    bool                        waitForFinished(int msecs = 30000);
+
+    void                        terminate();
+    void                        kill();
+
+    QProcess::ProcessState      state()                                             const;
+    qint64                      processId()                                         const;
+    int                         exitCode()                                          const;
+    QProcess::ExitStatus        exitStatus()                                        const;
+    QString                     errorString()                                       const;
+
+    /**
+     * Exact usage from wait4() in the helper, valid after finished().
+     */
+    ProcessUsage                usage()                                             const;
+
+    QByteArray                  readAllStandardOutput();
+    QByteArray                  readAllStandardError();
+
+Q_SIGNALS:
+
+    void started();
+    void readyReadStandardOutput();
+    void readyReadStandardError();
+    void finished(int exitCode, QProcess::ExitStatus exitStatus);
+    void error(QProcess::ProcessError error);
+
+private Q_SLOTS:
+
+    void slotActivated(int fd);
+
+private:
+
+    enum Channel
+    {
+        Output = 0,
+        Error,
+        Status,
+        ChannelCount
+    };
+
+    void                        handle(int channel);
+    qint64                      readChannel(int channel);
+    void                        readStatus();
+    void                        closeChannel(int channel);
+
+private:
+
+    ProcessLauncher*             m_launcher;
+    QString                      m_program;
+    QStringList                  m_arguments;
+    QProcess::ProcessChannelMode m_mode;
+    QProcess::ProcessState       m_state;
+    qint64                       m_pid;
+    int                          m_exitCode;
+    QProcess::ExitStatus         m_exitStatus;
+    QString                      m_errorString;
+    ProcessUsage                 m_usage;
+    int                          m_fds[ChannelCount];
+    QSocketNotifier*             m_notifiers[ChannelCount];
+    QByteArray                   m_buffers[Status];
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_LAUNCHER_H
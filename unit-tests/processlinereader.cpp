@@ -0,0 +1,177 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Incremental line splitter of process output, without
+ *               allocation by line.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processlinereader.h"
+
+// C++ includes
+
+#include <cstring>
+
+// Qt includes
+
+#include <QIODevice>
+
+namespace QtSampleCodes
+{
+
+ProcessLineReader::ProcessLineReader(const LineCallback& callback)
+    : m_callback(callback),
+      m_buffer(PROCESS_LINE_BUFFER_SIZE, Qt::Uninitialized),
+      m_used(0),
+      m_scanned(0),
+      m_lines(0),
+      m_bytes(0)
+{
+}
+
+ProcessLineReader::~ProcessLineReader()
+{
+}
+
+void ProcessLineReader::setCallback(const LineCallback& callback)
+{
+    m_callback = callback;
+}
+
+qint64 ProcessLineReader::readFrom(QIODevice* const device)
+{
+    qint64 total = 0;
+
+    while (device->bytesAvailable() > 0)
+    {
+        // A partial line filling the buffer grows it, up to the line size limit.
+
+        if ((m_used == m_buffer.size()) && (m_buffer.size() < PROCESS_LINE_MAX_SIZE))
+        {
+            m_buffer.resize(qMin(m_buffer.size() * 2, PROCESS_LINE_MAX_SIZE));
+        }
+
+        const qint64 size = device->read(m_buffer.data() + m_used, m_buffer.size() - m_used);
+
+        if (size <= 0)
+        {
+            break;
+        }
+
+        m_used  += int(size);
+        m_bytes += quint64(size);
+        total   += size;
+
+        split();
+    }
+
+    return total;
+}
+
+void ProcessLineReader::feed(const char* data, int size)
+{
+    while (size > 0)
+    {
+        if ((m_used == m_buffer.size()) && (m_buffer.size() < PROCESS_LINE_MAX_SIZE))
+        {
+            m_buffer.resize(qMin(m_buffer.size() * 2, PROCESS_LINE_MAX_SIZE));
+        }
+
+        const int count = qMin(size, m_buffer.size() - m_used);
+
+        memcpy(m_buffer.data() + m_used, data, count);
+
+        m_used  += count;
+        m_bytes += quint64(count);
+        data    += count;
+        size    -= count;
+
+        split();
+    }
+}
+
+void ProcessLineReader::flush()
+{
+    if (m_used > 0)
+    {
+        deliver(m_buffer.constData(), m_used);
+    }
+
+    m_used    = 0;
+    m_scanned = 0;
+}
+
+quint64 ProcessLineReader::lineCount() const
+{
+    return m_lines;
+}
+
+quint64 ProcessLineReader::byteCount() const
+{
+    return m_bytes;
+}
+
+void ProcessLineReader::split()
+{
+    const char* const buffer = m_buffer.constData();
+    int               start  = 0;
+    const char*       end    = nullptr;
+
+    // Only the new bytes are searched: the partial line was scanned by the previous call.
+
+    while ((end = static_cast<const char*>(memchr(buffer + m_scanned, '\n', m_used - m_scanned))))
+    {
+        const int eol = int(end - buffer);
+        deliver(buffer + start, eol - start);
+
+        start     = eol + 1;
+        m_scanned = start;
+    }
+
+    m_scanned = m_used;
+
+    // A line longer than the limit is delivered in pieces.
+
+    if ((start == 0) && (m_used == PROCESS_LINE_MAX_SIZE))
+    {
+        deliver(buffer, m_used);
+        start = m_used;
+    }
+
+    if (start > 0)
+    {
+        m_used   -= start;
+        m_scanned = m_used;
+        memmove(m_buffer.data(), m_buffer.constData() + start, m_used);
+    }
+}
+
+void ProcessLineReader::deliver(const char* data, int size)
+{
+    if ((size > 0) && (data[size - 1] == '\r'))
+    {
+        size--;
+    }
+
+    m_lines++;
+
+    if (m_callback)
+    {
+        m_callback(data, size);
+    }
+}
+
+} // namespace QtSampleCodes
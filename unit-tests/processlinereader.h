@@ -0,0 +1,102 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Incremental line splitter of process output, without
+ *               allocation by line.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_LINE_READER_H
+#define PROCESS_LINE_READER_H
+
+// C++ includes
+
+#include <functional>
+
+// Qt includes
+
+#include <QByteArray>
+
+#define PROCESS_LINE_BUFFER_SIZE    65536           // Bytes read from the device at once
+#define PROCESS_LINE_MAX_SIZE       (1 << 20)       // Longer lines are delivered in pieces of this size
+
+class QIODevice;
+
+namespace QtSampleCodes
+{
+
+/**
+ * Split a byte stream in lines, read by chunks from a device or fed by the caller. Lines are
+ * delivered to the callback as slices of the internal buffer, without the end of line ("\n"
+ * or "\r\n"): the data is only valid during the call. A line received in several reads is
+ * kept in the buffer until its end arrives.
+ *
+ * Bytes are scanned with memchr, vectorized by the C library.
+ */
+class ProcessLineReader
+{
+
+public:
+
+    typedef std::function<void(const char* data, int size)> LineCallback;
+
+public:
+
+    explicit ProcessLineReader(const LineCallback& callback = LineCallback());
+    ~ProcessLineReader();
+
+    void    setCallback(const LineCallback& callback);
+
+    /**
+     * Read all available data of device in the internal buffer, and deliver the complete lines.
+     * Return the number of bytes read.
+     */
+    qint64  readFrom(QIODevice* const device);
+
+    /**
+     * Deliver the complete lines of data.
+     */
+    void    feed(const char* data, int size);
+
+    /**
+     * Deliver the last line without end of line, at the end of the stream.
+     */
+    void    flush();
+
+    quint64 lineCount()                 const;
+    quint64 byteCount()                 const;
+
+private:
+
+    /**
+     * Deliver the complete lines in the buffer, and move the partial line to its start.
+     */
+    void    split();
+    void    deliver(const char* data, int size);
+
+private:
+
+    LineCallback m_callback;
+    QByteArray   m_buffer;
+    int          m_used;                ///< Bytes in the buffer: the start of a line not complete yet.
+    int          m_scanned;             ///< Bytes of the buffer already searched for an end of line.
+    quint64      m_lines;
+    quint64      m_bytes;
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_LINE_READER_H
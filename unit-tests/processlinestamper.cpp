@@ -0,0 +1,159 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Lines of process output tagged with network time and
+ *               offset from the process start, by channel.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processlinestamper.h"
+
+// C++ includes
+
+#include <algorithm>
+#include <chrono>
+
+// Local includes
+
+#include "ntpchrono.h"
+
+namespace QtSampleCodes
+{
+
+qint64 s_stamperSteadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool s_stamperLineLessThan(const ProcessLine& a, const ProcessLine& b)
+{
+    return (a.offsetNs < b.offsetNs);
+}
+
+// ---------------------------------------------------------------------
+
+ProcessLineStamper::ProcessLineStamper(qint64 budget)
+    : m_startNs(s_stamperSteadyNs()),
+      m_offsetNs(0),
+      m_networkNs(0),
+      m_synchronized(false)
+{
+    m_texts[QProcess::StandardOutput].setMemoryBudget(budget);
+    m_texts[QProcess::StandardError].setMemoryBudget(budget);
+
+    m_readers[QProcess::StandardOutput].setCallback(
+        [this](const char* data, int size)
+        {
+            append(QProcess::StandardOutput, data, size);
+        }
+    );
+
+    m_readers[QProcess::StandardError].setCallback(
+        [this](const char* data, int size)
+        {
+            append(QProcess::StandardError, data, size);
+        }
+    );
+}
+
+ProcessLineStamper::~ProcessLineStamper()
+{
+}
+
+void ProcessLineStamper::start()
+{
+    m_startNs = s_stamperSteadyNs();
+
+    for (int i = 0 ; i < 2 ; ++i)
+    {
+        m_lines[i].clear();
+        m_texts[i].clear();
+    }
+}
+
+qint64 ProcessLineStamper::readFrom(QProcess* const process, QProcess::ProcessChannel channel)
+{
+    process->setReadChannel(channel);
+    stamp();
+
+    return m_readers[channel].readFrom(process);
+}
+
+void ProcessLineStamper::flush()
+{
+    stamp();
+
+    m_readers[QProcess::StandardOutput].flush();
+    m_readers[QProcess::StandardError].flush();
+}
+
+const QVector<ProcessLine>& ProcessLineStamper::lines(QProcess::ProcessChannel channel) const
+{
+    return m_lines[channel];
+}
+
+QVector<ProcessLine> ProcessLineStamper::merged() const
+{
+    // Each list is already in time order: a stable sort of the concatenation keeps stdout first.
+
+    QVector<ProcessLine> lines = m_lines[QProcess::StandardOutput] + m_lines[QProcess::StandardError];
+    std::stable_sort(lines.begin(), lines.end(), s_stamperLineLessThan);
+
+    return lines;
+}
+
+QByteArray ProcessLineStamper::text(const ProcessLine& line)
+{
+    const char* const data = m_texts[line.channel].data();
+
+    if (!data)
+    {
+        return QByteArray();
+    }
+
+    return QByteArray::fromRawData(data + line.position, line.size);
+}
+
+bool ProcessLineStamper::isSynchronized() const
+{
+    return m_synchronized;
+}
+
+void ProcessLineStamper::stamp()
+{
+    m_offsetNs     = s_stamperSteadyNs() - m_startNs;
+    m_networkNs    = ntp_clock::now().time_since_epoch().count();
+    m_synchronized = ntp_clock::synchronized();
+}
+
+void ProcessLineStamper::append(QProcess::ProcessChannel channel, const char* data, int size)
+{
+    ProcessLine line;
+    line.offsetNs  = m_offsetNs;
+    line.networkNs = m_networkNs;
+    line.channel   = channel;
+    line.position  = m_texts[channel].size();
+    line.size      = size;
+
+    // A line whose text is lost is not kept: positions stay inside the capture.
+
+    if (m_texts[channel].append(data, size))
+    {
+        m_lines[channel].append(line);
+    }
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,126 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Lines of process output tagged with network time and
+ *               offset from the process start, by channel.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_LINE_STAMPER_H
+#define PROCESS_LINE_STAMPER_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QProcess>
+#include <QVector>
+
+// Local includes
+
+#include "processcapture.h"
+#include "processlinereader.h"
+
+namespace QtSampleCodes
+{
+
+/**
+ * A line of output. The text is stored in the stamper, see ProcessLineStamper::text().
+ */
+struct ProcessLine
+{
+    qint64                   offsetNs;          ///< Monotonic time since start(), in ns.
+    qint64                   networkNs;         ///< Network time, in ns since Epoch.
+    QProcess::ProcessChannel channel;
+    qint64                   position;          ///< In the text of the channel, may be past 2 GB.
+    int                      size;
+};
+
+/**
+ * Split stdout and stderr of a process in separate line lists, each line tagged when it was
+ * read: network time from ntp_clock, corrected by the offset NTPTimeStamp publishes, and
+ * monotonic offset from start().
+ *
+ * Both clocks are read once per chunk read from the process, not per line: lines arriving in
+ * the same chunk share their time, which keeps the cost flat at high line rates. A line cut
+ * between two chunks gets the time of the chunk completing it. Texts are appended to one
+ * ProcessCapture by channel, without allocation by line: past the memory budget, they go to a
+ * temporary file, and only the lines, 40 bytes each, stay in memory.
+ */
+class ProcessLineStamper
+{
+
+public:
+
+    /**
+     * Bytes of text of each channel kept in memory before spilling to disk.
+     */
+    explicit ProcessLineStamper(qint64 budget = PROCESS_CAPTURE_BUDGET);
+    ~ProcessLineStamper();
+
+    /**
+     * Reference of the offsets, called just before starting the process. Clear the lines.
+     */
+    void                        start();
+
+    /**
+     * Read all available data of a channel of process. Return the number of bytes read.
+     */
+    qint64                      readFrom(QProcess* const process, QProcess::ProcessChannel channel);
+
+    /**
+     * Deliver the last lines without end of line, at the end of the process.
+     */
+    void                        flush();
+
+    const QVector<ProcessLine>& lines(QProcess::ProcessChannel channel)         const;
+
+    /**
+     * Lines of both channels ordered by time, stdout first at equal times.
+     */
+    QVector<ProcessLine>        merged()                                        const;
+
+    /**
+     * Text of line, shared with the stamper: valid until the next read. Empty if the spilled
+     * text cannot be mapped.
+     */
+    QByteArray                  text(const ProcessLine& line);
+
+    /**
+     * False if network time was not synchronized yet at the last read: system time is used.
+     */
+    bool                        isSynchronized()                                const;
+
+private:
+
+    void                        stamp();
+    void                        append(QProcess::ProcessChannel channel, const char* data, int size);
+
+private:
+
+    Q_DISABLE_COPY(ProcessLineStamper)
+
+    qint64               m_startNs;
+    qint64               m_offsetNs;
+    qint64               m_networkNs;
+    bool                 m_synchronized;
+    ProcessLineReader    m_readers[2];
+    QVector<ProcessLine> m_lines[2];
+    ProcessCapture       m_texts[2];
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_LINE_STAMPER_H
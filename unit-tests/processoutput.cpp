@@ -0,0 +1,393 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Process output written to sinks from a dedicated
+ *               thread, without blocking the reader.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processoutput.h"
+
+// C++ includes
+
+#include <cstdio>
+
+// Qt includes
+
+#include <QIODevice>
+#include <QMutexLocker>
+#include <QtEndian>
+
+namespace QtSampleCodes
+{
+
+ProcessSink::ProcessSink()
+{
+}
+
+ProcessSink::~ProcessSink()
+{
+}
+
+void ProcessSink::flush()
+{
+}
+
+void ProcessSink::close()
+{
+    flush();
+}
+
+// ---------------------------------------------------------------------
+
+ProcessFileSink::ProcessFileSink(const QString& path, bool compressed)
+    : m_file(path),
+      m_compressed(compressed)
+{
+}
+
+ProcessFileSink::~ProcessFileSink()
+{
+    close();
+}
+
+bool ProcessFileSink::open()
+{
+    return m_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+}
+
+QString ProcessFileSink::errorString() const
+{
+    return m_file.errorString();
+}
+
+void ProcessFileSink::write(const char* data, qint64 size)
+{
+    if (!m_compressed)
+    {
+        m_file.write(data, size);
+
+        return;
+    }
+
+    m_block.append(data, int(size));
+
+    if (m_block.size() >= PROCESS_OUTPUT_BLOCK_SIZE)
+    {
+        writeBlock();
+    }
+}
+
+void ProcessFileSink::flush()
+{
+    // A compressed block is written only full or at the end: small blocks compress badly.
+
+    if (m_file.isOpen())
+    {
+        m_file.flush();
+    }
+}
+
+void ProcessFileSink::close()
+{
+    if (m_file.isOpen())
+    {
+        writeBlock();
+        m_file.close();
+    }
+}
+
+QByteArray ProcessFileSink::readCompressed(const QString& path)
+{
+    QFile      file(path);
+    QByteArray data;
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return data;
+    }
+
+    while (!file.atEnd())
+    {
+        const QByteArray header = file.read(4);
+
+        if (header.size() != 4)
+        {
+            break;
+        }
+
+        data.append(qUncompress(file.read(qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(header.constData())))));
+    }
+
+    return data;
+}
+
+void ProcessFileSink::writeBlock()
+{
+    if (m_block.isEmpty())
+    {
+        return;
+    }
+
+    const QByteArray compressed = qCompress(m_block);
+    uchar            header[4];
+    qToBigEndian<quint32>(quint32(compressed.size()), header);
+
+    m_file.write(reinterpret_cast<const char*>(header), 4);
+    m_file.write(compressed);
+    m_block.clear();
+}
+
+// ---------------------------------------------------------------------
+
+ProcessRingSink::ProcessRingSink(int capacity)
+    : m_ring(capacity)
+{
+}
+
+ProcessRingSink::~ProcessRingSink()
+{
+}
+
+void ProcessRingSink::write(const char* data, qint64 size)
+{
+    QMutexLocker lock(&m_mutex);
+    m_ring.append(data, size);
+}
+
+QByteArray ProcessRingSink::toByteArray() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    return m_ring.toByteArray();
+}
+
+qint64 ProcessRingSink::totalBytes() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    return m_ring.totalBytes();
+}
+
+// ---------------------------------------------------------------------
+
+ProcessStderrSink::ProcessStderrSink()
+{
+}
+
+ProcessStderrSink::~ProcessStderrSink()
+{
+}
+
+void ProcessStderrSink::write(const char* data, qint64 size)
+{
+    fwrite(data, 1, size_t(size), stderr);
+}
+
+void ProcessStderrSink::flush()
+{
+    fflush(stderr);
+}
+
+// ---------------------------------------------------------------------
+
+ProcessOutputWriter::ProcessOutputWriter(OverflowPolicy policy, int capacity)
+    : QThread(nullptr),
+      m_policy(policy),
+      m_queue(capacity),
+      m_stop(false),
+      m_written(0),
+      m_droppedChunks(0),
+      m_droppedBytes(0)
+{
+}
+
+ProcessOutputWriter::~ProcessOutputWriter()
+{
+    stop();
+    qDeleteAll(m_sinks);
+}
+
+void ProcessOutputWriter::addSink(ProcessSink* const sink)
+{
+    m_sinks << sink;
+}
+
+ProcessOutputWriter::OverflowPolicy ProcessOutputWriter::overflowPolicy() const
+{
+    return m_policy;
+}
+
+bool ProcessOutputWriter::push(const QByteArray& data)
+{
+    if (data.isEmpty())
+    {
+        return true;
+    }
+
+    bool   pushed  = true;
+    qint64 dropped = 0;
+
+    switch (m_policy)
+    {
+        case Block:
+            while (!m_queue.tryPush(data))
+            {
+                QThread::usleep(PROCESS_OUTPUT_BLOCK_WAIT);
+            }
+
+            break;
+
+        case DropOldest:
+            pushed = m_queue.pushDroppingOldest(data, &dropped);
+            break;
+
+        default:
+            pushed = m_queue.tryPush(data);
+            break;
+    }
+
+    if (!pushed)
+    {
+        dropped = data.size();
+    }
+    else
+    {
+        m_ready.release();
+    }
+
+    if (dropped > 0)
+    {
+        m_droppedChunks.fetch_add(1, std::memory_order_relaxed);
+        m_droppedBytes.fetch_add(quint64(dropped), std::memory_order_relaxed);
+
+        return false;
+    }
+
+    return true;
+}
+
+qint64 ProcessOutputWriter::readFrom(QIODevice* const device)
+{
+    // The chunk read is shared with the queue, not copied.
+
+    const QByteArray data = device->readAll();
+    push(data);
+
+    return data.size();
+}
+
+void ProcessOutputWriter::stop()
+{
+    if (isRunning())
+    {
+        m_stop.store(true, std::memory_order_release);
+        m_ready.release();
+        wait();
+    }
+}
+
+quint64 ProcessOutputWriter::writtenBytes() const
+{
+    return m_written.load(std::memory_order_relaxed);
+}
+
+quint64 ProcessOutputWriter::droppedChunks() const
+{
+    return m_droppedChunks.load(std::memory_order_relaxed);
+}
+
+quint64 ProcessOutputWriter::droppedBytes() const
+{
+    return m_droppedBytes.load(std::memory_order_relaxed);
+}
+
+ProcessOutputWriter::OverflowPolicy ProcessOutputWriter::overflowPolicyFromName(const QString& name, bool* const ok)
+{
+    // In the order of OverflowPolicy values.
+
+    static const char* const names[] = { "block", "drop-oldest", "drop" };
+
+    for (int i = 0 ; i < int(sizeof(names) / sizeof(names[0])) ; ++i)
+    {
+        if (name == QLatin1String(names[i]))
+        {
+            if (ok)
+            {
+                *ok = true;
+            }
+
+            return OverflowPolicy(i);
+        }
+    }
+
+    if (ok)
+    {
+        *ok = false;
+    }
+
+    return CountAndDrop;
+}
+
+void ProcessOutputWriter::run()
+{
+    QByteArray chunk;
+
+    while (true)
+    {
+        // Read before draining: all chunks pushed before stop() are written.
+
+        const bool stopping = m_stop.load(std::memory_order_acquire);
+
+        while (m_queue.tryPop(chunk))
+        {
+            foreach (ProcessSink* const sink, m_sinks)
+            {
+                sink->write(chunk.constData(), chunk.size());
+            }
+
+            m_written.fetch_add(quint64(chunk.size()), std::memory_order_relaxed);
+        }
+
+        chunk.clear();
+
+        if (stopping)
+        {
+            break;
+        }
+
+        if (m_ready.tryAcquire(1, PROCESS_OUTPUT_IDLE))
+        {
+            // One release per push: the ones of the chunks already written are consumed at once.
+
+            m_ready.tryAcquire(m_ready.available());
+        }
+        else
+        {
+            foreach (ProcessSink* const sink, m_sinks)
+            {
+                sink->flush();
+            }
+        }
+    }
+
+    foreach (ProcessSink* const sink, m_sinks)
+    {
+        sink->close();
+    }
+}
+
+} // namespace QtSampleCodes
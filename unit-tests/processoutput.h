@@ -0,0 +1,224 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Process output written to sinks from a dedicated
+ *               thread, without blocking the reader.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_OUTPUT_H
+#define PROCESS_OUTPUT_H
+
+// C++ includes
+
+#include <atomic>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThread>
+
+// Local includes
+
+#include "processqueue.h"
+#include "processring.h"
+
+#define PROCESS_OUTPUT_BLOCK_SIZE   (1 << 18)   // Bytes compressed at once by a file sink
+#define PROCESS_OUTPUT_IDLE         100         // Time without output before the sinks are flushed, in ms
+#define PROCESS_OUTPUT_BLOCK_WAIT   100         // Pause of a blocked producer before trying again, in us
+
+class QIODevice;
+
+namespace QtSampleCodes
+{
+
+/**
+ * Destination of the output, called from the writer thread only.
+ */
+class ProcessSink
+{
+
+public:
+
+    ProcessSink();
+    virtual ~ProcessSink();
+
+    virtual void write(const char* data, qint64 size) = 0;
+
+    /**
+     * No output for a while.
+     */
+    virtual void flush();
+
+    /**
+     * End of output, flush() by default.
+     */
+    virtual void close();
+
+private:
+
+    Q_DISABLE_COPY(ProcessSink)
+};
+
+/**
+ * Output to a file, as is or compressed with qCompress() by blocks of PROCESS_OUTPUT_BLOCK_SIZE
+ * bytes. A compressed file is a sequence of blocks, each one prefixed with its compressed size
+ * on 4 bytes, big-endian: read it back with readCompressed().
+ */
+class ProcessFileSink : public ProcessSink
+{
+
+public:
+
+    explicit ProcessFileSink(const QString& path, bool compressed = false);
+    ~ProcessFileSink();
+
+    bool              open();
+    QString           errorString()                                 const;
+
+    void              write(const char* data, qint64 size) Q_DECL_OVERRIDE;
+    void              flush()                                        Q_DECL_OVERRIDE;
+    void              close()                                        Q_DECL_OVERRIDE;
+
+    static QByteArray readCompressed(const QString& path);
+
+private:
+
+    void              writeBlock();
+
+private:
+
+    QFile      m_file;
+    bool       m_compressed;
+    QByteArray m_block;
+};
+
+/**
+ * Last bytes of the output in memory, readable from any thread.
+ */
+class ProcessRingSink : public ProcessSink
+{
+
+public:
+
+    explicit ProcessRingSink(int capacity = PROCESS_RING_SIZE);
+    ~ProcessRingSink();
+
+    void       write(const char* data, qint64 size) Q_DECL_OVERRIDE;
+
+    QByteArray toByteArray()                                        const;
+    qint64     totalBytes()                                         const;
+
+private:
+
+    ProcessRing    m_ring;
+    mutable QMutex m_mutex;
+};
+
+/**
+ * Output copied to the standard error of this process.
+ */
+class ProcessStderrSink : public ProcessSink
+{
+
+public:
+
+    ProcessStderrSink();
+    ~ProcessStderrSink();
+
+    void write(const char* data, qint64 size) Q_DECL_OVERRIDE;
+    void flush()                              Q_DECL_OVERRIDE;
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Hand the output read from a process to a thread writing it to sinks. The reader only pushes
+ * the chunks in a lock-free queue and wakes the thread: a slow sink never delays reading, and
+ * the child never blocks on a full pipe because of it. When the queue is full, the overflow
+ * policy decides between waiting and losing output, which is counted.
+ */
+class ProcessOutputWriter : public QThread
+{
+
+public:
+
+    enum OverflowPolicy
+    {
+        Block = 0,          ///< The reader waits for the writer: no loss, the child may block.
+        DropOldest,         ///< The oldest queued chunk is replaced by the new one.
+        CountAndDrop        ///< The new chunk is dropped.
+    };
+
+public:
+
+    explicit ProcessOutputWriter(OverflowPolicy policy = CountAndDrop, int capacity = PROCESS_QUEUE_SLOTS);
+    ~ProcessOutputWriter();
+
+    /**
+     * Take ownership of sink. Before start().
+     */
+    void           addSink(ProcessSink* const sink);
+
+    OverflowPolicy overflowPolicy()                                 const;
+
+    /**
+     * From the reader thread only. Return false if data, or older output, is dropped.
+     */
+    bool           push(const QByteArray& data);
+
+    /**
+     * Push all available data of device. Return the number of bytes read.
+     */
+    qint64         readFrom(QIODevice* const device);
+
+    /**
+     * Write the queued output, close the sinks, and end the thread.
+     */
+    void           stop();
+
+    quint64        writtenBytes()                                   const;
+    quint64        droppedChunks()                                  const;
+    quint64        droppedBytes()                                   const;
+
+    /**
+     * Policy named block, drop-oldest or drop. An unknown name returns CountAndDrop, and sets ok to false.
+     */
+    static OverflowPolicy overflowPolicyFromName(const QString& name, bool* const ok = nullptr);
+
+protected:
+
+    void run() Q_DECL_OVERRIDE;
+
+private:
+
+    OverflowPolicy          m_policy;
+    ProcessChunkQueue       m_queue;
+    QSemaphore              m_ready;            ///< Released at each push, to wake the writer.
+    QList<ProcessSink*>     m_sinks;
+    std::atomic<bool>       m_stop;
+    std::atomic<quint64>    m_written;
+    std::atomic<quint64>    m_droppedChunks;
+    std::atomic<quint64>    m_droppedBytes;
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_OUTPUT_H
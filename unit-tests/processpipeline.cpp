@@ -0,0 +1,464 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Chain of processes, the output of each stage piped
+ *               to the input of the next one, with optional tee.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processpipeline.h"
+
+// C++ includes
+
+#include <cerrno>
+
+// Qt includes
+
+#include <QSocketNotifier>
+
+#ifdef Q_OS_LINUX
+
+// Linux includes
+
+#   include <fcntl.h>
+#   include <sys/ioctl.h>
+#   include <unistd.h>
+
+#endif
+
+// Local includes
+
+#include "processinput.h"
+
+namespace QtSampleCodes
+{
+
+ProcessPipelineStage::ProcessPipelineStage()
+    : teeSize(0),
+      started(false),
+      exitCode(-1),
+      exitStatus(QProcess::NormalExit),
+      startedNs(-1),
+      finishedNs(-1)
+{
+}
+
+// ---------------------------------------------------------------------
+
+ProcessPipeline::Stage::Stage()
+    : process(nullptr),
+      ring(nullptr),
+      teeOutFd(-1),
+      teeReadFd(-1),
+      teeWriteFd(-1),
+      nextInFd(-1),
+      readNotifier(nullptr),
+      writeNotifier(nullptr)
+{
+}
+
+ProcessPipeline::ProcessPipeline(QObject* const parent)
+    : QObject(parent),
+      m_finished(0)
+{
+}
+
+ProcessPipeline::~ProcessPipeline()
+{
+    for (int i = 0 ; i < m_stages.size() ; ++i)
+    {
+        closeTee(m_stages[i]);
+        closeFd(m_stages[i].teeOutFd);
+        closeFd(m_stages[i].nextInFd);
+        delete m_stages[i].ring;
+    }
+}
+
+int ProcessPipeline::addStage(const QString& program, const QStringList& arguments, int teeSize)
+{
+    Stage stage;
+    stage.info.program   = program;
+    stage.info.arguments = arguments;
+    stage.info.teeSize   = qMax(teeSize, 0);
+    stage.process        = new QProcess(this);
+    stage.process->setProgram(program);
+    stage.process->setArguments(arguments);
+    stage.process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+
+    if (teeSize > 0)
+    {
+        stage.ring = new ProcessRing(teeSize);
+    }
+
+    connect(stage.process, SIGNAL(started()),
+            this, SLOT(slotStarted()));
+
+    connect(stage.process, SIGNAL(readyReadStandardOutput()),
+            this, SLOT(slotReadyRead()));
+
+    connect(stage.process, SIGNAL(finished(int,QProcess::ExitStatus)),
+            this, SLOT(slotProcessFinished(int,QProcess::ExitStatus)));
+
+    m_stages << stage;
+
+    return (m_stages.size() - 1);
+}
+
+int ProcessPipeline::stageCount() const
+{
+    return m_stages.size();
+}
+
+QProcess* ProcessPipeline::process(int index) const
+{
+    return ((index >= 0) && (index < m_stages.size())) ? m_stages.at(index).process : nullptr;
+}
+
+ProcessPipelineStage ProcessPipeline::stage(int index) const
+{
+    return m_stages.value(index).info;
+}
+
+QByteArray ProcessPipeline::tee(int index) const
+{
+    const ProcessRing* const ring = m_stages.value(index).ring;
+
+    return (ring ? ring->toByteArray() : QByteArray());
+}
+
+qint64 ProcessPipeline::teeTotalBytes(int index) const
+{
+    const ProcessRing* const ring = m_stages.value(index).ring;
+
+    return (ring ? ring->totalBytes() : 0);
+}
+
+bool ProcessPipeline::start()
+{
+    // All redirections are set before the first child is forked.
+
+    for (int i = 0 ; i < (m_stages.size() - 1) ; ++i)
+    {
+        // Without a pipe of ours, a tee reads the stage output and writes it to the next one.
+
+        if (m_stages.at(i).ring)
+        {
+            prepareTee(i);
+        }
+        else
+        {
+            m_stages[i].process->setStandardOutputProcess(m_stages.at(i + 1).process);
+        }
+    }
+
+    m_buffer   = QByteArray(PROCESS_PIPELINE_CHUNK_SIZE, Qt::Uninitialized);
+    m_finished = 0;
+    m_timer.start();
+
+    for (int i = 0 ; i < m_stages.size() ; ++i)
+    {
+        m_stages[i].process->start();
+
+        // The children hold their ends of our pipes now: EOF comes when they exit.
+
+        closeFd(m_stages[i].teeOutFd);
+
+        if (i > 0)
+        {
+            closeFd(m_stages[i - 1].nextInFd);
+        }
+
+        if (!m_stages[i].process->waitForStarted())
+        {
+            kill();
+
+            for (int j = 0 ; j < m_stages.size() ; ++j)
+            {
+                closeTee(m_stages[j]);
+                closeFd(m_stages[j].teeOutFd);
+                closeFd(m_stages[j].nextInFd);
+            }
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ProcessPipeline::kill()
+{
+    foreach (const Stage& stage, m_stages)
+    {
+        if (stage.process->state() != QProcess::NotRunning)
+        {
+            stage.process->kill();
+        }
+    }
+}
+
+bool ProcessPipeline::isFinished() const
+{
+    return (!m_stages.isEmpty() && (m_finished == m_stages.size()));
+}
+
+void ProcessPipeline::slotStarted()
+{
+    const int index = indexOf(sender());
+
+    if (index >= 0)
+    {
+        m_stages[index].info.started   = true;
+        m_stages[index].info.startedNs = m_timer.nsecsElapsed();
+    }
+}
+
+void ProcessPipeline::slotReadyRead()
+{
+    const int index = indexOf(sender());
+
+    if (index >= 0)
+    {
+        readOutput(index);
+    }
+}
+
+void ProcessPipeline::slotProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    const int index = indexOf(sender());
+
+    if (index < 0)
+    {
+        return;
+    }
+
+    // The last bytes of an output read by us are delivered before the end.
+
+    if      (index == (m_stages.size() - 1))
+    {
+        readOutput(index);
+    }
+    else if (m_stages.at(index).ring && (m_stages.at(index).teeReadFd < 0))
+    {
+        readOutput(index);
+        m_stages[index + 1].process->closeWriteChannel();
+    }
+
+    Stage& stage          = m_stages[index];
+    stage.info.exitCode   = exitCode;
+    stage.info.exitStatus = exitStatus;
+    stage.info.finishedNs = m_timer.nsecsElapsed();
+
+    if (++m_finished == m_stages.size())
+    {
+        emit signalFinished();
+    }
+}
+
+void ProcessPipeline::slotTeePump()
+{
+    for (int i = 0 ; i < m_stages.size() ; ++i)
+    {
+        Stage& stage = m_stages[i];
+
+        if ((sender() == stage.readNotifier) || (sender() == stage.writeNotifier))
+        {
+            pumpTee(stage);
+            break;
+        }
+    }
+}
+
+int ProcessPipeline::indexOf(QObject* const process) const
+{
+    for (int i = 0 ; i < m_stages.size() ; ++i)
+    {
+        if (m_stages.at(i).process == process)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void ProcessPipeline::readOutput(int index)
+{
+    Stage&           stage = m_stages[index];
+    const QByteArray data  = stage.process->readAllStandardOutput();
+
+    if (data.isEmpty())
+    {
+        return;
+    }
+
+    if (stage.ring)
+    {
+        stage.ring->append(data.constData(), data.size());
+    }
+
+    if (index == (m_stages.size() - 1))
+    {
+        emit signalOutput(data);
+    }
+    else
+    {
+        m_stages[index + 1].process->write(data);
+    }
+}
+
+void ProcessPipeline::prepareTee(int index)
+{
+
+#ifdef Q_OS_LINUX
+
+    Stage& stage = m_stages[index];
+    int    out[2];
+    int    in[2];
+
+    if (pipe2(out, O_CLOEXEC) != 0)
+    {
+        return;
+    }
+
+    if (pipe2(in, O_CLOEXEC) != 0)
+    {
+        close(out[0]);
+        close(out[1]);
+
+        return;
+    }
+
+    // QProcess opens the ends of the children again in start(), as files.
+
+    stage.teeReadFd  = out[0];
+    stage.teeOutFd   = out[1];
+    stage.nextInFd   = in[0];
+    stage.teeWriteFd = in[1];
+
+    stage.process->setStandardOutputFile(QString::fromLatin1("/proc/self/fd/%1").arg(stage.teeOutFd));
+    m_stages[index + 1].process->setStandardInputFile(QString::fromLatin1("/proc/self/fd/%1").arg(stage.nextInFd));
+
+    ProcessInput::ignoreSigpipe();
+    fcntl(stage.teeReadFd,  F_SETFL, fcntl(stage.teeReadFd,  F_GETFL) | O_NONBLOCK);
+    fcntl(stage.teeWriteFd, F_SETFL, fcntl(stage.teeWriteFd, F_GETFL) | O_NONBLOCK);
+
+    stage.readNotifier  = new QSocketNotifier(stage.teeReadFd,  QSocketNotifier::Read,  this);
+    stage.writeNotifier = new QSocketNotifier(stage.teeWriteFd, QSocketNotifier::Write, this);
+    stage.writeNotifier->setEnabled(false);
+
+    connect(stage.readNotifier, SIGNAL(activated(int)),
+            this, SLOT(slotTeePump()));
+
+    connect(stage.writeNotifier, SIGNAL(activated(int)),
+            this, SLOT(slotTeePump()));
+
+#else
+
+    Q_UNUSED(index);
+
+#endif
+
+}
+
+void ProcessPipeline::pumpTee(Stage& stage)
+{
+
+#ifdef Q_OS_LINUX
+
+    while (stage.teeReadFd >= 0)
+    {
+        // Duplicate what is pending to the next stage, then consume the same bytes for the ring.
+
+        const ssize_t size = tee(stage.teeReadFd, stage.teeWriteFd, size_t(m_buffer.size()), SPLICE_F_NONBLOCK);
+
+        if      (size > 0)
+        {
+            const ssize_t count = read(stage.teeReadFd, m_buffer.data(), size_t(size));
+
+            if (count > 0)
+            {
+                stage.ring->append(m_buffer.constData(), count);
+            }
+        }
+        else if (size == 0)
+        {
+            // The stage has exited and its output is drained: EOF for the next one.
+
+            closeTee(stage);
+        }
+        else if (errno == EAGAIN)
+        {
+            // Wait for the side which blocks: no output pending, or the next stage not reading.
+
+            int pending = 0;
+            ioctl(stage.teeReadFd, FIONREAD, &pending);
+
+            stage.readNotifier->setEnabled(pending == 0);
+            stage.writeNotifier->setEnabled(pending > 0);
+
+            break;
+        }
+        else if (errno != EINTR)
+        {
+            // The next stage has exited: the stage gets EPIPE, as in a shell.
+
+            closeTee(stage);
+        }
+    }
+
+#else
+
+    Q_UNUSED(stage);
+
+#endif
+
+}
+
+void ProcessPipeline::closeTee(Stage& stage)
+{
+    if (stage.readNotifier)
+    {
+        stage.readNotifier->setEnabled(false);
+        stage.readNotifier->deleteLater();
+        stage.readNotifier = nullptr;
+    }
+
+    if (stage.writeNotifier)
+    {
+        stage.writeNotifier->setEnabled(false);
+        stage.writeNotifier->deleteLater();
+        stage.writeNotifier = nullptr;
+    }
+
+    closeFd(stage.teeReadFd);
+    closeFd(stage.teeWriteFd);
+}
+
+void ProcessPipeline::closeFd(int& fd)
+{
+    if (fd >= 0)
+    {
+
+#ifdef Q_OS_LINUX
+        close(fd);
+#endif
+
+        fd = -1;
+    }
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,168 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Chain of processes, the output of each stage piped
+ *               to the input of the next one, with optional tee.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_PIPELINE_H
+#define PROCESS_PIPELINE_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QProcess>
+#include <QStringList>
+#include <QVector>
+
+// Local includes
+
+#include "processring.h"
+
+#define PROCESS_PIPELINE_CHUNK_SIZE 65536       // Bytes moved by a tee at once
+
+class QSocketNotifier;
+
+namespace QtSampleCodes
+{
+
+/**
+ * One command of a pipeline and its outcome. Times are from ProcessPipeline::start(), in ns,
+ * -1 if not reached.
+ */
+struct ProcessPipelineStage
+{
+    ProcessPipelineStage();
+
+    QString              program;
+    QStringList          arguments;
+    int                  teeSize;           ///< Bytes of output kept, 0 for no tee.
+    bool                 started;
+    int                  exitCode;
+    QProcess::ExitStatus exitStatus;
+    qint64               startedNs;
+    qint64               finishedNs;
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Run "stage1 | stage2 | ..." as a shell would. Stages are chained with
+ * QProcess::setStandardOutputProcess(): data goes from one child to the next through a pipe,
+ * never through this process. The stderr of the stages is forwarded to ours.
+ *
+ * A stage with a tee keeps the last bytes of its output in a ring:
+ *
+ *  - On Linux, the stage writes to a pipe of ours and the next stage reads from another one,
+ *    given to the children through /proc/self/fd. Data is duplicated from the first pipe to the
+ *    second with tee(), without copy in user space, then read from the first one into the ring.
+ *  - Elsewhere, the output is read by this process, kept, and written to the next stage.
+ *
+ * The input of the first stage is left to the caller: a ProcessInput set on process(0) before
+ * start(), or closeWriteChannel() after. The output of the last stage is read by this object and
+ * emitted with signalOutput().
+ *
+ * Needs the event loop.
+ */
+class ProcessPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit ProcessPipeline(QObject* const parent = nullptr);
+    ~ProcessPipeline();
+
+    /**
+     * Append a stage, before start(). Return its index.
+     */
+    int                  addStage(const QString& program, const QStringList& arguments, int teeSize = 0);
+
+    int                  stageCount()                                   const;
+    QProcess*            process(int index)                             const;
+    ProcessPipelineStage stage(int index)                               const;
+
+    /**
+     * Last output bytes of a stage with a tee, oldest first.
+     */
+    QByteArray           tee(int index)                                 const;
+    qint64               teeTotalBytes(int index)                       const;
+
+    /**
+     * Start all stages, from the first one. Return false if one cannot be started: the others
+     * are killed.
+     */
+    bool                 start();
+    void                 kill();
+
+    bool                 isFinished()                                   const;
+
+Q_SIGNALS:
+
+    void signalOutput(const QByteArray& data);
+
+    /**
+     * All stages have exited.
+     */
+    void signalFinished();
+
+private Q_SLOTS:
+
+    void slotStarted();
+    void slotReadyRead();
+    void slotProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void slotTeePump();
+
+private:
+
+    struct Stage;
+
+    int  indexOf(QObject* const process)                                const;
+    void readOutput(int index);
+    void prepareTee(int index);
+    void pumpTee(Stage& stage);
+    void closeTee(Stage& stage);
+    void closeFd(int& fd);
+
+private:
+
+    struct Stage
+    {
+        Stage();
+
+        ProcessPipelineStage info;
+        QProcess*            process;
+        ProcessRing*         ring;
+        int                  teeOutFd;          ///< Write end the stage outputs to, closed once started.
+        int                  teeReadFd;         ///< Read end of the stage output, ours.
+        int                  teeWriteFd;        ///< Write end to the next stage, ours.
+        int                  nextInFd;          ///< Read end the next stage inputs from, closed once started.
+        QSocketNotifier*     readNotifier;
+        QSocketNotifier*     writeNotifier;
+    };
+
+    QVector<Stage>           m_stages;
+    QElapsedTimer            m_timer;
+    QByteArray               m_buffer;
+    int                      m_finished;
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_PIPELINE_H
@@ -0,0 +1,549 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Run a queue of commands with a bounded number of
+ *               child processes in flight.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processpool.h"
+
+// C++ includes
+
+#include <climits>
+
+// Qt includes
+
+#include <QDebug>
+#include <QThread>
+#include <QTimer>
+
+// Local includes
+
+#ifdef Q_OS_LINUX
+#   include "processlauncher.h"
+#endif
+
+namespace QtSampleCodes
+{
+
+/**
+ * Accessors of a child of the pool, a QProcess or a LauncherProcess.
+ */
+qint64 s_poolRead(QObject* const process, ProcessCapture* const capture)
+{
+    if (QProcess* const child = qobject_cast<QProcess*>(process))
+    {
+        return capture->readFrom(child);
+    }
+
+#ifdef Q_OS_LINUX
+
+    if (LauncherProcess* const child = qobject_cast<LauncherProcess*>(process))
+    {
+        const QByteArray data = child->readAllStandardOutput();
+        capture->append(data);
+
+        return data.size();
+    }
+
+#endif
+
+    return 0;
+}
+
+bool s_poolIsRunning(QObject* const process)
+{
+    if (QProcess* const child = qobject_cast<QProcess*>(process))
+    {
+        return (child->state() == QProcess::Running);
+    }
+
+#ifdef Q_OS_LINUX
+
+    if (LauncherProcess* const child = qobject_cast<LauncherProcess*>(process))
+    {
+        return (child->state() == QProcess::Running);
+    }
+
+#endif
+
+    return false;
+}
+
+qint64 s_poolProcessId(QObject* const process)
+{
+    if (QProcess* const child = qobject_cast<QProcess*>(process))
+    {
+        return child->processId();
+    }
+
+#ifdef Q_OS_LINUX
+
+    if (LauncherProcess* const child = qobject_cast<LauncherProcess*>(process))
+    {
+        return child->processId();
+    }
+
+#endif
+
+    return 0;
+}
+
+void s_poolKill(QObject* const process)
+{
+    if (QProcess* const child = qobject_cast<QProcess*>(process))
+    {
+        child->kill();
+    }
+
+#ifdef Q_OS_LINUX
+
+    else if (LauncherProcess* const child = qobject_cast<LauncherProcess*>(process))
+    {
+        child->kill();
+    }
+
+#endif
+
+}
+
+void s_poolExit(QObject* const process, int* const exitCode, QProcess::ExitStatus* const exitStatus)
+{
+    if (QProcess* const child = qobject_cast<QProcess*>(process))
+    {
+        *exitCode   = child->exitCode();
+        *exitStatus = child->exitStatus();
+    }
+
+#ifdef Q_OS_LINUX
+
+    else if (LauncherProcess* const child = qobject_cast<LauncherProcess*>(process))
+    {
+        *exitCode   = child->exitCode();
+        *exitStatus = child->exitStatus();
+    }
+
+#endif
+
+}
+
+// ---------------------------------------------------------------------
+
+ProcessJob::ProcessJob(const QString& program_, const QStringList& arguments_, qint64 timeout_)
+    : program(program_),
+      arguments(arguments_),
+      timeout(timeout_)
+{
+}
+
+ProcessResult::ProcessResult()
+    : started(false),
+      timedOut(false),
+      cancelled(false),
+      exitCode(-1),
+      exitStatus(QProcess::NormalExit),
+      elapsed(0)
+{
+}
+
+// ---------------------------------------------------------------------
+
+ProcessPool::ProcessPool(QObject* const parent)
+    : QObject(parent),
+      m_maxJobs(qMax(1, QThread::idealThreadCount())),
+      m_timeout(PROCESS_POOL_TIMEOUT),
+      m_budget(PROCESS_CAPTURE_BUDGET),
+      m_launcher(nullptr),
+      m_running(false),
+      m_usageTimer(new QTimer(this))
+{
+    m_usageTimer->setInterval(PROCESS_USAGE_INTERVAL);
+
+    connect(m_usageTimer, SIGNAL(timeout()),
+            this, SLOT(slotSampleUsage()));
+}
+
+ProcessPool::~ProcessPool()
+{
+    cancel();
+}
+
+void ProcessPool::setMaxJobs(int count)
+{
+    m_maxJobs = qMax(1, count);
+
+    if (m_running)
+    {
+        launch();
+    }
+}
+
+int ProcessPool::maxJobs() const
+{
+    return m_maxJobs;
+}
+
+void ProcessPool::setTimeout(qint64 ms)
+{
+    m_timeout = ms;
+}
+
+qint64 ProcessPool::timeout() const
+{
+    return m_timeout;
+}
+
+void ProcessPool::setScheduling(const ProcessScheduling& scheduling)
+{
+    m_scheduling = scheduling;
+}
+
+ProcessScheduling ProcessPool::scheduling() const
+{
+    return m_scheduling;
+}
+
+void ProcessPool::setLauncher(ProcessLauncher* const launcher)
+{
+    m_launcher = launcher;
+}
+
+void ProcessPool::setMemoryBudget(qint64 budget)
+{
+    m_budget = budget;
+}
+
+qint64 ProcessPool::memoryBudget() const
+{
+    return m_budget;
+}
+
+int ProcessPool::addJob(const ProcessJob& job)
+{
+    ProcessResult result;
+    result.job    = job;
+    result.output = QSharedPointer<ProcessCapture>(new ProcessCapture(m_budget));
+
+    m_results.append(result);
+    m_pending.enqueue(m_results.size() - 1);
+
+    if (m_running)
+    {
+        launch();
+    }
+
+    return (m_results.size() - 1);
+}
+
+void ProcessPool::start()
+{
+    m_running = true;
+    launch();
+}
+
+void ProcessPool::cancel()
+{
+    m_running = false;
+
+    while (!m_pending.isEmpty())
+    {
+        m_results[m_pending.dequeue()].cancelled = true;
+    }
+
+    foreach (QObject* const process, m_processes.keys())
+    {
+        ProcessResult& result = m_results[m_processes.value(process).id];
+        result.started        = s_poolIsRunning(process);
+        result.cancelled      = true;
+
+        process->disconnect(this);
+        s_poolKill(process);
+        complete(process);
+    }
+
+    m_usageTimer->stop();
+}
+
+bool ProcessPool::isRunning() const
+{
+    return m_running;
+}
+
+int ProcessPool::pendingCount() const
+{
+    return m_pending.size();
+}
+
+int ProcessPool::runningCount() const
+{
+    return m_processes.size();
+}
+
+QVector<ProcessResult> ProcessPool::results() const
+{
+    return m_results;
+}
+
+ProcessResult ProcessPool::result(int id) const
+{
+    return m_results.value(id);
+}
+
+void ProcessPool::launch()
+{
+    while (m_running && !m_pending.isEmpty() && (m_processes.size() < m_maxJobs))
+    {
+        const int               id         = m_pending.dequeue();
+        const ProcessJob&       job        = m_results.at(id).job;
+        const ProcessScheduling scheduling = job.scheduling.isDefault() ? m_scheduling : job.scheduling;
+        ScheduledProcess*       scheduled  = nullptr;
+        QObject*                process    = nullptr;
+
+#ifdef Q_OS_LINUX
+
+        LauncherProcess*        launched   = nullptr;
+
+        if (m_launcher && scheduling.isDefault())
+        {
+            launched = new LauncherProcess(m_launcher, this);
+            launched->setProgram(job.program);
+            launched->setArguments(job.arguments);
+            launched->setProcessChannelMode(QProcess::MergedChannels);
+            process  = launched;
+        }
+
+#endif
+
+        if (!process)
+        {
+            scheduled = new ScheduledProcess(this);
+
+#ifdef Q_OS_WIN
+
+            scheduled->setProgram(QLatin1String("cmd"));
+            scheduled->setArguments(QStringList() << QLatin1String("/c") << job.program << job.arguments);
+
+#else   // Linux
+
+            scheduled->setProgram(job.program);
+            scheduled->setArguments(job.arguments);
+
+#endif
+
+            scheduled->setProcessChannelMode(QProcess::MergedChannels);
+            scheduled->setScheduling(scheduling);
+            process   = scheduled;
+        }
+
+        // Same signatures for both classes: connected by name. Merged output comes on stdout.
+
+        connect(process, SIGNAL(started()),
+                this, SLOT(slotStarted()));
+
+        connect(process, SIGNAL(readyReadStandardOutput()),
+                this, SLOT(slotReadyRead()));
+
+        connect(process, SIGNAL(finished(int,QProcess::ExitStatus)),
+                this, SLOT(slotProcessFinished(int,QProcess::ExitStatus)));
+
+        connect(process, SIGNAL(error(QProcess::ProcessError)),
+                this, SLOT(slotProcessError(QProcess::ProcessError)));
+
+        // The timer is owned by the process, and deleted with it.
+
+        Running running;
+        running.id    = id;
+        running.timer = new QTimer(process);
+        running.timer->setSingleShot(true);
+
+        connect(running.timer, SIGNAL(timeout()),
+                this, SLOT(slotTimeout()));
+
+        running.elapsed.start();
+        running.timer->start(int(qMin(qint64(INT_MAX), (job.timeout > 0) ? job.timeout : m_timeout)));
+        m_processes.insert(process, running);
+
+        // The launcher emits started() or error() from start(): registered before.
+
+        if (scheduled)
+        {
+            scheduled->start();
+        }
+
+#ifdef Q_OS_LINUX
+
+        else
+        {
+            launched->start();
+        }
+
+#endif
+
+    }
+
+    if      (!m_processes.isEmpty() && !m_usageTimer->isActive())
+    {
+        m_usageTimer->start();
+    }
+    else if (m_processes.isEmpty())
+    {
+        m_usageTimer->stop();
+    }
+
+    if (m_running && m_pending.isEmpty() && m_processes.isEmpty())
+    {
+        m_running = false;
+
+        emit signalFinished();
+    }
+}
+
+void ProcessPool::complete(QObject* const process)
+{
+    if (!m_processes.contains(process))
+    {
+        return;
+    }
+
+    const Running  running = m_processes.take(process);
+    ProcessResult& result  = m_results[running.id];
+
+    s_poolRead(process, result.output.data());
+    result.elapsed     = running.elapsed.elapsed();
+    result.outputError = result.output->errorString();
+
+    if (!result.outputError.isEmpty())
+    {
+        qWarning() << "ProcessPool: job output lost:" << result.job.program << result.job.arguments << ":" << result.outputError;
+    }
+
+    if (result.cancelled)
+    {
+        // Not reaped yet: the QProcess state is the one before the kill.
+
+        result.exitCode   = -1;
+        result.exitStatus = QProcess::CrashExit;
+    }
+    else
+    {
+        s_poolExit(process, &result.exitCode, &result.exitStatus);
+
+        if (!result.started)
+        {
+            result.exitCode = -1;
+        }
+    }
+
+#ifdef Q_OS_LINUX
+
+    // The helper reaps its children with wait4(): their usage is exact, samples are replaced.
+
+    LauncherProcess* const launched = qobject_cast<LauncherProcess*>(process);
+
+    if (launched && launched->usage().isValid())
+    {
+        result.usage = launched->usage();
+    }
+
+#endif
+
+    process->disconnect(this);
+    process->deleteLater();
+
+    emit signalJobFinished(running.id);
+}
+
+void ProcessPool::slotStarted()
+{
+    QObject* const process = sender();
+
+    // A job shorter than PROCESS_USAGE_INTERVAL has at least this sample.
+
+    if (process && m_processes.contains(process))
+    {
+        m_results[m_processes.value(process).id].usage.sample(s_poolProcessId(process));
+    }
+}
+
+void ProcessPool::slotReadyRead()
+{
+    QObject* const process = sender();
+
+    if (process && m_processes.contains(process))
+    {
+        s_poolRead(process, m_results[m_processes.value(process).id].output.data());
+    }
+}
+
+void ProcessPool::slotProcessFinished(int, QProcess::ExitStatus)
+{
+    QObject* const process = sender();
+
+    if (process && m_processes.contains(process))
+    {
+        m_results[m_processes.value(process).id].started = true;
+        complete(process);
+        launch();
+    }
+}
+
+void ProcessPool::slotProcessError(QProcess::ProcessError error)
+{
+    QObject* const process = sender();
+
+    // Other errors are followed by finished().
+
+    if (process && m_processes.contains(process) && (error == QProcess::FailedToStart))
+    {
+        complete(process);
+        launch();
+    }
+}
+
+void ProcessPool::slotSampleUsage()
+{
+    // QProcess reaps its children: their usage is read from /proc while they run. The launcher
+    // children are sampled too, until their exact usage arrives.
+
+    for (QHash<QObject*, Running>::const_iterator it = m_processes.constBegin() ; it != m_processes.constEnd() ; ++it)
+    {
+        if (s_poolIsRunning(it.key()))
+        {
+            m_results[it.value().id].usage.sample(s_poolProcessId(it.key()));
+        }
+    }
+}
+
+void ProcessPool::slotTimeout()
+{
+    QTimer* const  timer   = qobject_cast<QTimer*>(sender());
+    QObject* const process = timer ? timer->parent() : nullptr;
+
+    if (process && m_processes.contains(process))
+    {
+        ProcessResult& result = m_results[m_processes.value(process).id];
+
+        qWarning() << "ProcessPool: job timed-out:" << result.job.program << result.job.arguments;
+
+        // finished() follows the kill.
+
+        result.timedOut = true;
+        s_poolKill(process);
+    }
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,202 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Run a queue of commands with a bounded number of
+ *               child processes in flight.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_POOL_H
+#define PROCESS_POOL_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QProcess>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+// Local includes
+
+#include "processcapture.h"
+#include "processscheduling.h"
+#include "processusage.h"
+
+#define PROCESS_POOL_TIMEOUT        30000       // Default time limit of a job, in ms
+
+class QTimer;
+
+namespace QtSampleCodes
+{
+
+class ProcessLauncher;
+
+/**
+ * Command to run. A timeout of 0 uses the pool timeout, a default scheduling the pool one.
+ */
+struct ProcessJob
+{
+    explicit ProcessJob(const QString& program = QString(), const QStringList& arguments = QStringList(), qint64 timeout = 0);
+
+    QString           program;
+    QStringList       arguments;
+    qint64            timeout;
+    ProcessScheduling scheduling;
+};
+
+/**
+ * Outcome of a job. Output holds stdout and stderr merged, shared by the copies of the result.
+ * A cancelled job is a crash with exit code -1, whatever the state of its process.
+ */
+struct ProcessResult
+{
+    ProcessResult();
+
+    ProcessJob                     job;
+    bool                           started;
+    bool                           timedOut;
+    bool                           cancelled;         ///< Killed or dropped by ProcessPool::cancel().
+    int                            exitCode;
+    QProcess::ExitStatus           exitStatus;
+    qint64                         elapsed;           ///< Wall time from start to end, in ms.
+    QSharedPointer<ProcessCapture> output;
+    QString                        outputError;       ///< Why output was lost, empty if captured whole.
+    ProcessUsage                   usage;             ///< Exact with a launcher, else sampled at start and every PROCESS_USAGE_INTERVAL ms.
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * Run queued jobs with at most maxJobs() children at a time, driven by the process signals
+ * in the event loop of the calling thread: nothing blocks in waitFor*(). A job still running
+ * after its timeout is killed.
+ *
+ * Children are QProcess instances, or LauncherProcess ones with a launcher: both have the same
+ * signals, connected by name, and their accessors are dispatched with qobject_cast().
+ */
+class ProcessPool : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit ProcessPool(QObject* const parent = nullptr);
+    ~ProcessPool();
+
+    /**
+     * Children in flight, the number of cores by default.
+     */
+    void                   setMaxJobs(int count);
+    int                    maxJobs()                    const;
+
+    /**
+     * Time limit of the jobs without their own, in ms. PROCESS_POOL_TIMEOUT by default.
+     */
+    void                   setTimeout(qint64 ms);
+    qint64                 timeout()                    const;
+
+    /**
+     * Scheduling of the jobs without their own. Inherited from this process by default.
+     */
+    void                   setScheduling(const ProcessScheduling& scheduling);
+    ProcessScheduling      scheduling()                 const;
+
+    /**
+     * Helper spawning the jobs, started by the caller, Linux only. The helper applies no
+     * scheduling: the jobs with one are still started with QProcess. nullptr, the default,
+     * starts all jobs with QProcess.
+     */
+    void                   setLauncher(ProcessLauncher* const launcher);
+
+    /**
+     * Output bytes of each job kept in memory before spilling to disk, PROCESS_CAPTURE_BUDGET by default.
+     * Applies to the jobs added after.
+     */
+    void                   setMemoryBudget(qint64 budget);
+    qint64                 memoryBudget()               const;
+
+    /**
+     * Queue a job, started as soon as a slot is free if the pool is started. Return its identifier:
+     * the index of its result.
+     */
+    int                    addJob(const ProcessJob& job);
+
+    void                   start();
+
+    /**
+     * Kill the running children and drop the queued jobs, all recorded as cancelled.
+     */
+    void                   cancel();
+
+    bool                   isRunning()                  const;
+    int                    pendingCount()               const;
+    int                    runningCount()               const;
+
+    QVector<ProcessResult> results()                    const;
+    ProcessResult          result(int id)               const;
+
+Q_SIGNALS:
+
+    void signalJobFinished(int id);
+
+    /**
+     * All queued jobs are done.
+     */
+    void signalFinished();
+
+private Q_SLOTS:
+
+    void slotStarted();
+    void slotReadyRead();
+    void slotProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void slotProcessError(QProcess::ProcessError error);
+    void slotTimeout();
+    void slotSampleUsage();
+
+private:
+
+    void                   launch();
+    void                   complete(QObject* const process);
+
+private:
+
+    struct Running
+    {
+        int           id;
+        QElapsedTimer elapsed;
+        QTimer*       timer;
+    };
+
+    int                       m_maxJobs;
+    qint64                    m_timeout;
+    qint64                    m_budget;
+    ProcessScheduling         m_scheduling;
+    ProcessLauncher*          m_launcher;
+    bool                      m_running;
+    QTimer*                   m_usageTimer;
+    QQueue<int>               m_pending;
+    QHash<QObject*, Running>  m_processes;
+    QVector<ProcessResult>    m_results;
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_POOL_H
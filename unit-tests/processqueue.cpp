@@ -0,0 +1,133 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Lock-free queue of output chunks, from one producer
+ *               thread to one consumer thread.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processqueue.h"
+
+namespace QtSampleCodes
+{
+
+ProcessChunkQueue::ProcessChunkQueue(int capacity)
+    : m_slots(nullptr),
+      m_capacity(qMax(capacity, 1)),
+      m_head(0),
+      m_tail(0)
+{
+    m_slots = new Slot[m_capacity];
+
+    for (int i = 0 ; i < m_capacity ; ++i)
+    {
+        m_slots[i].state.store(SlotEmpty);
+        m_slots[i].position = 0;
+    }
+}
+
+ProcessChunkQueue::~ProcessChunkQueue()
+{
+    delete [] m_slots;
+}
+
+int ProcessChunkQueue::capacity() const
+{
+    return m_capacity;
+}
+
+bool ProcessChunkQueue::tryPush(const QByteArray& data)
+{
+    Slot& slot = m_slots[m_head % m_capacity];
+
+    if (slot.state.load(std::memory_order_acquire) != SlotEmpty)
+    {
+        return false;
+    }
+
+    slot.data     = data;
+    slot.position = m_head;
+    slot.state.store(SlotFull, std::memory_order_release);
+    ++m_head;
+
+    return true;
+}
+
+bool ProcessChunkQueue::pushDroppingOldest(const QByteArray& data, qint64* const droppedSize)
+{
+    *droppedSize = 0;
+
+    if (tryPush(data))
+    {
+        return true;
+    }
+
+    // Full: the slot of the next position holds the oldest chunk.
+
+    Slot& slot     = m_slots[m_head % m_capacity];
+    int   expected = SlotFull;
+
+    if (!slot.state.compare_exchange_strong(expected, SlotWriting, std::memory_order_acquire))
+    {
+        // Emptied meanwhile, or being popped.
+
+        return ((expected == SlotEmpty) && tryPush(data));
+    }
+
+    *droppedSize  = slot.data.size();
+    slot.data     = data;
+    slot.position = m_head;
+    slot.state.store(SlotFull, std::memory_order_release);
+    ++m_head;
+
+    return true;
+}
+
+bool ProcessChunkQueue::tryPop(QByteArray& data)
+{
+    while (true)
+    {
+        Slot& slot     = m_slots[m_tail % m_capacity];
+        int   expected = SlotFull;
+
+        if (!slot.state.compare_exchange_strong(expected, SlotReading, std::memory_order_acquire))
+        {
+            // Empty, or being replaced by the producer.
+
+            return false;
+        }
+
+        if (slot.position != m_tail)
+        {
+            // Replaced by a newer chunk: the oldest one left is the next position.
+
+            const quint64 position = slot.position;
+            slot.state.store(SlotFull, std::memory_order_release);
+            m_tail                 = position - quint64(m_capacity) + 1;
+
+            continue;
+        }
+
+        data      = slot.data;
+        slot.data = QByteArray();
+        slot.state.store(SlotEmpty, std::memory_order_release);
+        ++m_tail;
+
+        return true;
+    }
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,102 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Lock-free queue of output chunks, from one producer
+ *               thread to one consumer thread.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_QUEUE_H
+#define PROCESS_QUEUE_H
+
+// C++ includes
+
+#include <atomic>
+
+// Qt includes
+
+#include <QByteArray>
+
+#define PROCESS_QUEUE_SLOTS         1024        // Chunks queued by default
+
+namespace QtSampleCodes
+{
+
+/**
+ * Bounded single-producer single-consumer queue of chunks, allocated once. Each slot has an
+ * atomic state owning its chunk: push and pop never lock nor wait, a chunk changes hands by
+ * reference count, without copy.
+ *
+ * When full, the producer may take back the oldest slot for a new chunk. Slots carry their
+ * position in the stream: the consumer skips the positions lost this way, and chunks keep
+ * their order.
+ */
+class ProcessChunkQueue
+{
+
+public:
+
+    explicit ProcessChunkQueue(int capacity = PROCESS_QUEUE_SLOTS);
+    ~ProcessChunkQueue();
+
+    int  capacity()                                     const;
+
+    /**
+     * Producer. Return false if the queue is full.
+     */
+    bool tryPush(const QByteArray& data);
+
+    /**
+     * Producer. Push, in place of the oldest chunk if the queue is full, whose size is set in
+     * droppedSize, else 0. Return false if the oldest chunk is being popped: nothing is pushed.
+     */
+    bool pushDroppingOldest(const QByteArray& data, qint64* const droppedSize);
+
+    /**
+     * Consumer. Return false if the queue is empty.
+     */
+    bool tryPop(QByteArray& data);
+
+private:
+
+    enum SlotState
+    {
+        SlotEmpty = 0,
+        SlotWriting,
+        SlotFull,
+        SlotReading
+    };
+
+    struct Slot
+    {
+        std::atomic<int> state;
+        quint64          position;
+        QByteArray       data;
+    };
+
+    Slot*   m_slots;
+    int     m_capacity;
+    quint64 m_head;         ///< Position of the next push, producer only.
+    quint64 m_tail;         ///< Position of the next pop, consumer only.
+
+private:
+
+    Q_DISABLE_COPY(ProcessChunkQueue)
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_QUEUE_H
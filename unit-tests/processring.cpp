@@ -0,0 +1,106 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Fixed-size ring keeping the last bytes of a stream.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processring.h"
+
+// C++ includes
+
+#include <cstring>
+
+namespace QtSampleCodes
+{
+
+ProcessRing::ProcessRing(int capacity)
+    : m_buffer(qMax(capacity, 1), '\0'),
+      m_start(0),
+      m_size(0),
+      m_total(0)
+{
+}
+
+ProcessRing::~ProcessRing()
+{
+}
+
+void ProcessRing::append(const char* data, qint64 size)
+{
+    if (size <= 0)
+    {
+        return;
+    }
+
+    const int capacity = m_buffer.size();
+    m_total           += size;
+
+    // Only the end of a block larger than the ring would be kept.
+
+    if (size >= capacity)
+    {
+        memcpy(m_buffer.data(), data + size - capacity, size_t(capacity));
+        m_start = 0;
+        m_size  = capacity;
+
+        return;
+    }
+
+    const int count = int(size);
+    const int end   = (m_start + m_size) % capacity;
+    const int first = qMin(count, capacity - end);
+
+    memcpy(m_buffer.data() + end, data, size_t(first));
+    memcpy(m_buffer.data(), data + first, size_t(count - first));
+
+    const int overwritten = qMax(0, m_size + count - capacity);
+    m_start               = (m_start + overwritten) % capacity;
+    m_size                = qMin(capacity, m_size + count);
+}
+
+void ProcessRing::clear()
+{
+    m_start = 0;
+    m_size  = 0;
+    m_total = 0;
+}
+
+int ProcessRing::capacity() const
+{
+    return m_buffer.size();
+}
+
+int ProcessRing::size() const
+{
+    return m_size;
+}
+
+qint64 ProcessRing::totalBytes() const
+{
+    return m_total;
+}
+
+QByteArray ProcessRing::toByteArray() const
+{
+    const int  first = qMin(m_size, m_buffer.size() - m_start);
+    QByteArray data(m_buffer.constData() + m_start, first);
+    data.append(m_buffer.constData(), m_size - first);
+
+    return data;
+}
+
+} // namespace QtSampleCodes
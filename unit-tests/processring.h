@@ -0,0 +1,75 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Fixed-size ring keeping the last bytes of a stream.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_RING_H
+#define PROCESS_RING_H
+
+// Qt includes
+
+#include <QByteArray>
+
+#define PROCESS_RING_SIZE           65536       // Bytes kept by default
+
+namespace QtSampleCodes
+{
+
+/**
+ * Last capacity() bytes appended, older ones are overwritten. The memory is allocated once, at
+ * construction: appending never allocates.
+ */
+class ProcessRing
+{
+
+public:
+
+    explicit ProcessRing(int capacity = PROCESS_RING_SIZE);
+    ~ProcessRing();
+
+    void       append(const char* data, qint64 size);
+    void       clear();
+
+    int        capacity()                               const;
+
+    /**
+     * Bytes kept, at most capacity().
+     */
+    int        size()                                   const;
+
+    /**
+     * Bytes appended since the construction or the last clear, kept or not.
+     */
+    qint64     totalBytes()                             const;
+
+    /**
+     * Bytes kept, oldest first.
+     */
+    QByteArray toByteArray()                            const;
+
+private:
+
+    QByteArray m_buffer;
+    int        m_start;
+    int        m_size;
+    qint64     m_total;
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_RING_H
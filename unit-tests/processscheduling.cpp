@@ -0,0 +1,310 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : CPU affinity, scheduling policy, nice value and I/O
+ *               priority of child processes.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processscheduling.h"
+
+// C++ includes
+
+#include <cstring>
+
+// Qt includes
+
+#include <QStringList>
+
+#ifdef Q_OS_LINUX
+
+// Linux includes
+
+#   include <sched.h>
+#   include <sys/resource.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+
+#endif
+
+#define PROCESS_SCHED_IOPRIO_SHIFT  13          // Class position in an I/O priority value
+#define PROCESS_SCHED_IOPRIO_WHO    1           // IOPRIO_WHO_PROCESS
+
+namespace QtSampleCodes
+{
+
+/**
+ * Report a failure from the child, with async-signal-safe calls only.
+ */
+void s_schedulingFailed(const char* const message)
+{
+
+#ifdef Q_OS_LINUX
+
+    const char prefix[] = "scheduling: cannot set ";
+    ssize_t    written  = write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+    written             = write(STDERR_FILENO, message, strlen(message));
+    written             = write(STDERR_FILENO, "\n", 1);
+    Q_UNUSED(written);
+
+#else
+
+    Q_UNUSED(message);
+
+#endif
+
+}
+
+// ---------------------------------------------------------------------
+
+ProcessScheduling::ProcessScheduling()
+    : policy(PolicyInherit),
+      priority(0),
+      nice(PROCESS_SCHED_NICE_INHERIT),
+      ioClass(IoInherit),
+      ioLevel(4)
+{
+}
+
+bool ProcessScheduling::isDefault() const
+{
+    return (cpus.isEmpty()                          &&
+            (policy  == PolicyInherit)              &&
+            (nice    == PROCESS_SCHED_NICE_INHERIT) &&
+            (ioClass == IoInherit));
+}
+
+bool ProcessScheduling::setCpus(const QString& list)
+{
+    QList<int> parsed;
+
+    foreach (const QString& item, list.split(QLatin1Char(','), QString::SkipEmptyParts))
+    {
+        const QStringList bounds = item.split(QLatin1Char('-'));
+        bool              ok1    = false;
+        bool              ok2    = false;
+        const int         first  = bounds.first().toInt(&ok1);
+        const int         last   = bounds.last().toInt(&ok2);
+
+        if ((bounds.size() > 2) || !ok1 || !ok2 || (first < 0) || (last < first))
+        {
+            return false;
+        }
+
+        for (int cpu = first ; cpu <= last ; ++cpu)
+        {
+            parsed << cpu;
+        }
+    }
+
+    cpus = parsed;
+
+    return true;
+}
+
+bool ProcessScheduling::setPolicy(const QString& spec)
+{
+    const QStringList value    = spec.split(QLatin1Char(':'));
+    const Policy      parsed   = policyFromName(value.first());
+    const bool        realtime = (parsed == PolicyFifo) || (parsed == PolicyRoundRobin);
+    bool              ok       = true;
+    const int         level    = value.value(1).toInt(&ok);
+
+    if ((value.size() > 2) || (parsed == PolicyInherit))
+    {
+        return false;
+    }
+
+    if (realtime ? (!ok || (level < 1) || (level > 99)) : (value.size() > 1))
+    {
+        return false;
+    }
+
+    policy   = parsed;
+    priority = realtime ? level : 0;
+
+    return true;
+}
+
+bool ProcessScheduling::setNice(const QString& value)
+{
+    bool      ok     = false;
+    const int parsed = value.toInt(&ok);
+
+    if (!ok || (parsed < -20) || (parsed > 19))
+    {
+        return false;
+    }
+
+    nice = parsed;
+
+    return true;
+}
+
+bool ProcessScheduling::setIoPriority(const QString& spec)
+{
+    const QStringList value  = spec.split(QLatin1Char(':'));
+    const IoClass     parsed = ioClassFromName(value.first());
+    bool              ok     = true;
+    const int         level  = value.value(1, QLatin1String("4")).toInt(&ok);
+
+    if ((value.size() > 2) || (parsed == IoInherit))
+    {
+        return false;
+    }
+
+    // The idle class has no level.
+
+    if ((parsed == IoIdle) ? (value.size() > 1) : (!ok || (level < 0) || (level > 7)))
+    {
+        return false;
+    }
+
+    ioClass = parsed;
+    ioLevel = (parsed == IoIdle) ? 0 : level;
+
+    return true;
+}
+
+ProcessScheduling::Policy ProcessScheduling::policyFromName(const QString& name)
+{
+    // In the order of Policy values.
+
+    static const char* const names[] = { "other", "batch", "idle", "fifo", "rr" };
+
+    for (int i = 0 ; i < int(sizeof(names) / sizeof(names[0])) ; ++i)
+    {
+        if (name == QLatin1String(names[i]))
+        {
+            return Policy(i);
+        }
+    }
+
+    return PolicyInherit;
+}
+
+ProcessScheduling::IoClass ProcessScheduling::ioClassFromName(const QString& name)
+{
+    // In the order of IoClass values, from 1.
+
+    static const char* const names[] = { "realtime", "besteffort", "idle" };
+
+    for (int i = 0 ; i < int(sizeof(names) / sizeof(names[0])) ; ++i)
+    {
+        if (name == QLatin1String(names[i]))
+        {
+            return IoClass(i + 1);
+        }
+    }
+
+    return IoInherit;
+}
+
+// ---------------------------------------------------------------------
+
+ScheduledProcess::ScheduledProcess(QObject* const parent)
+    : QProcess(parent)
+{
+}
+
+ScheduledProcess::~ScheduledProcess()
+{
+}
+
+void ScheduledProcess::setScheduling(const ProcessScheduling& scheduling)
+{
+    m_scheduling = scheduling;
+    m_cpuMask.clear();
+
+#ifdef Q_OS_LINUX
+
+    if (!scheduling.cpus.isEmpty())
+    {
+        int maxCpu = 0;
+
+        foreach (int cpu, scheduling.cpus)
+        {
+            maxCpu = qMax(maxCpu, cpu);
+        }
+
+        const size_t size = CPU_ALLOC_SIZE(maxCpu + 1);
+        m_cpuMask         = QByteArray(int(size), '\0');
+        cpu_set_t* mask   = reinterpret_cast<cpu_set_t*>(m_cpuMask.data());
+
+        foreach (int cpu, scheduling.cpus)
+        {
+            CPU_SET_S(cpu, size, mask);
+        }
+    }
+
+#endif
+
+}
+
+ProcessScheduling ScheduledProcess::scheduling() const
+{
+    return m_scheduling;
+}
+
+void ScheduledProcess::setupChildProcess()
+{
+
+#ifdef Q_OS_LINUX
+
+    // Between fork and exec: system calls only, no allocation and no lock.
+
+    if (m_scheduling.policy != ProcessScheduling::PolicyInherit)
+    {
+        static const int policies[] = { SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO, SCHED_RR };
+
+        const int   policy   = policies[m_scheduling.policy];
+        sched_param param;
+        param.sched_priority = ((policy == SCHED_FIFO) || (policy == SCHED_RR)) ? m_scheduling.priority : 0;
+
+        if (sched_setscheduler(0, policy, &param) != 0)
+        {
+            s_schedulingFailed("scheduling policy");
+        }
+    }
+
+    if ((m_scheduling.nice != PROCESS_SCHED_NICE_INHERIT) && (setpriority(PRIO_PROCESS, 0, m_scheduling.nice) != 0))
+    {
+        s_schedulingFailed("nice value");
+    }
+
+    if (!m_cpuMask.isEmpty() &&
+        (sched_setaffinity(0, size_t(m_cpuMask.size()), reinterpret_cast<const cpu_set_t*>(m_cpuMask.constData())) != 0))
+    {
+        s_schedulingFailed("cpu affinity");
+    }
+
+    if (m_scheduling.ioClass != ProcessScheduling::IoInherit)
+    {
+        const int level = (m_scheduling.ioClass == ProcessScheduling::IoIdle) ? 0 : m_scheduling.ioLevel;
+        const int value = (int(m_scheduling.ioClass) << PROCESS_SCHED_IOPRIO_SHIFT) | level;
+
+        if (syscall(SYS_ioprio_set, PROCESS_SCHED_IOPRIO_WHO, 0, value) != 0)
+        {
+            s_schedulingFailed("I/O priority");
+        }
+    }
+
+#endif
+
+    QProcess::setupChildProcess();
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,130 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : CPU affinity, scheduling policy, nice value and I/O
+ *               priority of child processes.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_SCHEDULING_H
+#define PROCESS_SCHEDULING_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QList>
+#include <QProcess>
+#include <QString>
+
+#define PROCESS_SCHED_NICE_INHERIT  (-1000)     // Nice value of the parent kept
+
+namespace QtSampleCodes
+{
+
+/**
+ * Scheduling of a child, applied between fork and exec. Each setting left to its default is
+ * inherited from the parent.
+ */
+struct ProcessScheduling
+{
+    enum Policy
+    {
+        PolicyInherit = -1,
+        PolicyOther   = 0,      ///< Default time-sharing.
+        PolicyBatch,            ///< CPU-bound, never preempts on wakeup.
+        PolicyIdle,             ///< Only when nothing else runs.
+        PolicyFifo,             ///< Real-time, needs privileges.
+        PolicyRoundRobin        ///< Real-time, needs privileges.
+    };
+
+    enum IoClass
+    {
+        IoInherit    = -1,
+        IoRealtime   = 1,
+        IoBestEffort = 2,
+        IoIdle       = 3
+    };
+
+    ProcessScheduling();
+
+    bool           isDefault()                          const;
+
+    /**
+     * Parse a list of cpus and ranges, as "0,2-3". Return false on syntax error.
+     */
+    bool           setCpus(const QString& list);
+
+    /**
+     * Parse "name[:priority]", with a priority from 1 to 99 required by the fifo and rr policies
+     * only. Return false on an unknown name or a priority out of range: nothing is changed.
+     */
+    bool           setPolicy(const QString& spec);
+
+    /**
+     * Parse a nice value, from -20 to 19. Return false otherwise.
+     */
+    bool           setNice(const QString& value);
+
+    /**
+     * Parse "class[:level]", with a level from 0 to 7 for the realtime and besteffort classes
+     * only, 4 by default. Return false on an unknown class or a level out of range.
+     */
+    bool           setIoPriority(const QString& spec);
+
+    static Policy  policyFromName(const QString& name);
+    static IoClass ioClassFromName(const QString& name);
+
+    QList<int>     cpus;                ///< Allowed cpus, empty for all the parent ones.
+    Policy         policy;
+    int            priority;            ///< Real-time priority, 1 to 99, for the Fifo and RoundRobin policies.
+    int            nice;                ///< -20 to 19, or PROCESS_SCHED_NICE_INHERIT.
+    IoClass        ioClass;
+    int            ioLevel;             ///< 0 (highest) to 7, for the Realtime and BestEffort classes.
+};
+
+// ---------------------------------------------------------------------
+
+/**
+ * QProcess applying a ProcessScheduling in setupChildProcess(), in the child before exec. The
+ * cpu mask is built in the parent: the child only makes system calls. A setting which cannot be
+ * applied is reported on the child stderr, and the command is run anyway. Linux only, elsewhere
+ * it is a plain QProcess.
+ */
+class ScheduledProcess : public QProcess
+{
+    Q_OBJECT
+
+public:
+
+    explicit ScheduledProcess(QObject* const parent = nullptr);
+    ~ScheduledProcess();
+
+    void              setScheduling(const ProcessScheduling& scheduling);
+    ProcessScheduling scheduling()                      const;
+
+protected:
+
+    void setupChildProcess() Q_DECL_OVERRIDE;
+
+private:
+
+    ProcessScheduling m_scheduling;
+    QByteArray        m_cpuMask;
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_SCHEDULING_H
@@ -0,0 +1,237 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Resources used by a child process: CPU time, peak
+ *               memory, faults, context switches and I/O.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "processusage.h"
+
+// Qt includes
+
+#include <QFile>
+#include <QList>
+
+#ifdef Q_OS_UNIX
+
+// Linux includes
+
+#   include <sys/resource.h>
+#   include <unistd.h>
+
+#endif
+
+namespace QtSampleCodes
+{
+
+/**
+ * Value of the "key: value" line of a /proc file, -1 if absent.
+ */
+qint64 s_usageField(const QByteArray& data, const char* const key)
+{
+    const QByteArray prefix = QByteArray(key) + ':';
+    int              index  = data.startsWith(prefix) ? 0 : data.indexOf('\n' + prefix);
+
+    if (index < 0)
+    {
+        return -1;
+    }
+
+    index += (index == 0) ? prefix.size() : prefix.size() + 1;
+
+    const int  end   = data.indexOf('\n', index);
+    QByteArray value = data.mid(index, (end < 0) ? -1 : end - index).trimmed();
+
+    // Drop a unit, as " kB".
+
+    const int space = value.indexOf(' ');
+
+    if (space > 0)
+    {
+        value.truncate(space);
+    }
+
+    bool         ok     = false;
+    const qint64 number = value.toLongLong(&ok);
+
+    return (ok ? number : -1);
+}
+
+QByteArray s_usageReadFile(qint64 pid, const char* const name)
+{
+    QFile file(QString::fromLatin1("/proc/%1/%2").arg(pid).arg(QLatin1String(name)));
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return QByteArray();
+    }
+
+    return file.readAll();
+}
+
+// ---------------------------------------------------------------------
+
+ProcessUsage::ProcessUsage()
+    : userTimeUs(0),
+      systemTimeUs(0),
+      maxRssKb(0),
+      majorFaults(0),
+      minorFaults(0),
+      voluntarySwitches(0),
+      involuntarySwitches(0),
+      readBytes(0),
+      writeBytes(0),
+      valid(false),
+      exact(false)
+{
+}
+
+void ProcessUsage::setRusage(const struct rusage& usage)
+{
+
+#ifdef Q_OS_UNIX
+
+    userTimeUs          = qint64(usage.ru_utime.tv_sec) * 1000000 + usage.ru_utime.tv_usec;
+    systemTimeUs        = qint64(usage.ru_stime.tv_sec) * 1000000 + usage.ru_stime.tv_usec;
+    maxRssKb            = usage.ru_maxrss;
+    majorFaults         = usage.ru_majflt;
+    minorFaults         = usage.ru_minflt;
+    voluntarySwitches   = usage.ru_nvcsw;
+    involuntarySwitches = usage.ru_nivcsw;
+
+    // Blocks of 512 bytes, as /proc/<pid>/io counts them.
+
+    readBytes           = qint64(usage.ru_inblock) * 512;
+    writeBytes          = qint64(usage.ru_oublock) * 512;
+    valid               = true;
+    exact               = true;
+
+#else
+
+    Q_UNUSED(usage);
+
+#endif
+
+}
+
+bool ProcessUsage::sample(qint64 pid)
+{
+
+#ifdef Q_OS_LINUX
+
+    if (pid <= 0)
+    {
+        return false;
+    }
+
+    // Fields after the command name, which can hold spaces: the third field is the first one.
+
+    const QByteArray stat  = s_usageReadFile(pid, "stat");
+    const int        paren = stat.lastIndexOf(')');
+
+    if (paren < 0)
+    {
+        return false;
+    }
+
+    const QList<QByteArray> fields = stat.mid(paren + 2).split(' ');
+
+    if (fields.size() < 13)
+    {
+        return false;
+    }
+
+    const qint64 ticks = qMax(1L, sysconf(_SC_CLK_TCK));
+
+    minorFaults  = qMax(minorFaults,  fields.at(7).toLongLong());
+    majorFaults  = qMax(majorFaults,  fields.at(9).toLongLong());
+    userTimeUs   = qMax(userTimeUs,   fields.at(11).toLongLong() * 1000000 / ticks);
+    systemTimeUs = qMax(systemTimeUs, fields.at(12).toLongLong() * 1000000 / ticks);
+
+    const QByteArray status = s_usageReadFile(pid, "status");
+
+    maxRssKb            = qMax(maxRssKb,            s_usageField(status, "VmHWM"));
+    voluntarySwitches   = qMax(voluntarySwitches,   s_usageField(status, "voluntary_ctxt_switches"));
+    involuntarySwitches = qMax(involuntarySwitches, s_usageField(status, "nonvoluntary_ctxt_switches"));
+
+    // Only readable by the owner of the process.
+
+    const QByteArray io = s_usageReadFile(pid, "io");
+
+    readBytes  = qMax(readBytes,  s_usageField(io, "read_bytes"));
+    writeBytes = qMax(writeBytes, s_usageField(io, "write_bytes"));
+    valid      = true;
+
+    return true;
+
+#else
+
+    Q_UNUSED(pid);
+
+    return false;
+
+#endif
+
+}
+
+bool ProcessUsage::isValid() const
+{
+    return valid;
+}
+
+QString ProcessUsage::summary() const
+{
+    if (!valid)
+    {
+        return QLatin1String("no usage");
+    }
+
+    return QString::fromLatin1("user %1 ms, system %2 ms, max rss %3 kB, faults %4 major %5 minor, "
+                               "switches %6 voluntary %7 involuntary, read %8 B, written %9 B%10")
+           .arg(userTimeUs / 1000.0, 0, 'f', 1)
+           .arg(systemTimeUs / 1000.0, 0, 'f', 1)
+           .arg(maxRssKb)
+           .arg(majorFaults)
+           .arg(minorFaults)
+           .arg(voluntarySwitches)
+           .arg(involuntarySwitches)
+           .arg(readBytes)
+           .arg(writeBytes)
+           .arg(exact ? QLatin1String("") : QLatin1String(" (sampled)"));
+}
+
+QByteArray ProcessUsage::toCsv() const
+{
+    return QByteArray::number(userTimeUs)          + ',' +
+           QByteArray::number(systemTimeUs)        + ',' +
+           QByteArray::number(maxRssKb)            + ',' +
+           QByteArray::number(majorFaults)         + ',' +
+           QByteArray::number(minorFaults)         + ',' +
+           QByteArray::number(voluntarySwitches)   + ',' +
+           QByteArray::number(involuntarySwitches) + ',' +
+           QByteArray::number(readBytes)           + ',' +
+           QByteArray::number(writeBytes)          + ',' +
+           QByteArray::number(exact ? 1 : 0);
+}
+
+QByteArray ProcessUsage::csvHeader()
+{
+    return QByteArray("user_us,system_us,max_rss_kb,major_faults,minor_faults,"
+                      "voluntary_switches,involuntary_switches,read_bytes,write_bytes,exact");
+}
+
+} // namespace QtSampleCodes
@@ -0,0 +1,83 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Resources used by a child process: CPU time, peak
+ *               memory, faults, context switches and I/O.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef PROCESS_USAGE_H
+#define PROCESS_USAGE_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QString>
+
+#define PROCESS_USAGE_INTERVAL      100         // Period of /proc sampling of running children, in ms
+
+struct rusage;
+
+namespace QtSampleCodes
+{
+
+/**
+ * Resources used by a child. Exact when taken from wait4() at its exit, as the launcher helper
+ * does. QProcess reaps its children itself: the usage is then sampled from /proc/<pid> while
+ * the child runs (stat, status and io), and misses the end after the last sample.
+ *
+ * I/O counts the bytes read from and written to storage, not to pipes.
+ */
+struct ProcessUsage
+{
+    ProcessUsage();
+
+    /**
+     * Take the usage of a child reaped with wait4().
+     */
+    void              setRusage(const struct rusage& usage);
+
+    /**
+     * Update from /proc/<pid>, Linux only. The counters and the peak only grow. Return false if
+     * the process is gone.
+     */
+    bool              sample(qint64 pid);
+
+    bool              isValid()                 const;
+
+    /**
+     * One line for logs, and the same fields for a CSV file.
+     */
+    QString           summary()                 const;
+    QByteArray        toCsv()                   const;
+    static QByteArray csvHeader();
+
+    qint64            userTimeUs;
+    qint64            systemTimeUs;
+    qint64            maxRssKb;
+    qint64            majorFaults;
+    qint64            minorFaults;
+    qint64            voluntarySwitches;        ///< Blocked on I/O or a lock.
+    qint64            involuntarySwitches;      ///< Preempted: CPU starved.
+    qint64            readBytes;
+    qint64            writeBytes;
+    bool              valid;
+    bool              exact;
+};
+
+} // namespace QtSampleCodes
+
+#endif // PROCESS_USAGE_H
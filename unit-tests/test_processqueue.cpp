@@ -0,0 +1,180 @@
+/* ============================================================
+ *
+ * Date        : 2020-11-20
+ * Description : Stress of the writer of process output, with one
+ *               producer thread and a slow sink.
+ *
+ * Copyright (C) 2019-2020 by Gilles Caulier <caulier dot gilles at gmail dot com>
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// Qt includes
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+
+// Local includes
+
+#include "processoutput.h"
+
+#define QUEUE_TEST_SLOTS            8           // Small queue: the producer overflows it often
+#define QUEUE_TEST_CHUNKS           100000      // Chunks pushed by policy by default
+#define QUEUE_TEST_CHUNK_SIZE       12          // Chunks are their number, zero padded
+#define QUEUE_TEST_SINK_PAUSE       256         // The sink sleeps after each batch of this many chunks
+
+using namespace QtSampleCodes;
+
+int s_failed = 0;
+
+void s_check(const char* const scenario, bool passed, quint64 pushed, quint64 written, quint64 dropped, quint64 misordered)
+{
+    qInfo().noquote() << (passed ? "> PASS" : "> FAIL") << scenario
+                      << ": pushed" << pushed << ", written" << written << ", dropped" << dropped
+                      << ", out of order" << misordered;
+
+    if (!passed)
+    {
+        s_failed++;
+    }
+}
+
+/**
+ * Slow sink counting the chunks written. Each chunk holds its number in the stream:
+ * they must come strictly increasing, which also excludes duplicates.
+ */
+class CountingSink : public ProcessSink
+{
+
+public:
+
+    CountingSink()
+        : m_chunks(0),
+          m_bytes(0),
+          m_misordered(0),
+          m_last(-1),
+          m_closed(false)
+    {
+    }
+
+    void write(const char* data, qint64 size) Q_DECL_OVERRIDE
+    {
+        const qint64 number = QByteArray::fromRawData(data, int(size)).toLongLong();
+
+        if ((size != QUEUE_TEST_CHUNK_SIZE) || (number <= m_last))
+        {
+            m_misordered++;
+        }
+
+        m_last   = number;
+        m_bytes += quint64(size);
+        m_chunks++;
+
+        // Let the queue fill up: the producer must wait or drop.
+
+        if ((m_chunks % QUEUE_TEST_SINK_PAUSE) == 0)
+        {
+            QThread::usleep(50);
+        }
+    }
+
+    void close() Q_DECL_OVERRIDE
+    {
+        m_closed = true;
+    }
+
+    quint64 chunks()     const
+    {
+        return m_chunks;
+    }
+
+    quint64 bytes()      const
+    {
+        return m_bytes;
+    }
+
+    quint64 misordered() const
+    {
+        return m_misordered;
+    }
+
+    bool    closed()     const
+    {
+        return m_closed;
+    }
+
+private:
+
+    quint64 m_chunks;
+    quint64 m_bytes;
+    quint64 m_misordered;
+    qint64  m_last;
+    bool    m_closed;
+};
+
+/**
+ * Push count chunks to a writer thread with policy, then stop it: every byte pushed is
+ * either written, in order, or counted as dropped.
+ */
+void s_stress(ProcessOutputWriter::OverflowPolicy policy, const char* const scenario, quint64 count)
+{
+    ProcessOutputWriter writer(policy, QUEUE_TEST_SLOTS);
+    CountingSink* const sink = new CountingSink;
+    quint64             lost = 0;
+
+    writer.addSink(sink);
+    writer.start();
+
+    for (quint64 i = 0 ; i < count ; ++i)
+    {
+        if (!writer.push(QByteArray::number(i).rightJustified(QUEUE_TEST_CHUNK_SIZE, '0')))
+        {
+            lost++;
+        }
+    }
+
+    writer.stop();
+
+    // The sink is owned by the writer and only read after the thread ended.
+
+    const quint64 pushed   = count * QUEUE_TEST_CHUNK_SIZE;
+    const bool    lossless = (policy != ProcessOutputWriter::Block) || (writer.droppedBytes() == 0);
+    const bool    counted  = (writer.writtenBytes() + writer.droppedBytes() == pushed) &&
+                             (writer.writtenBytes() == sink->bytes())                  &&
+                             (writer.droppedChunks() == lost);
+
+    s_check(scenario, lossless && counted && sink->closed() && (sink->misordered() == 0),
+            count, sink->chunks(), writer.droppedChunks(), sink->misordered());
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    const quint64 count = (app.arguments().size() > 1) ? app.arguments().at(1).toULongLong()
+                                                       : QUEUE_TEST_CHUNKS;
+
+    QElapsedTimer cpu;
+    cpu.start();
+
+    s_stress(ProcessOutputWriter::Block,        "block",       count);
+    s_stress(ProcessOutputWriter::DropOldest,   "drop-oldest", count);
+    s_stress(ProcessOutputWriter::CountAndDrop, "drop",        count);
+
+    qInfo().noquote() << "=== Stressed a writer of" << QUEUE_TEST_SLOTS << "slots with" << count << "chunks by policy in" << cpu.elapsed() << "ms";
+
+    return ((s_failed == 0) ? 0 : -1);
+}
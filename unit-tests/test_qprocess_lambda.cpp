@@ -28,22 +28,740 @@
 #include <QStringList>
 #include <QDebug>
 #include <QElapsedTimer>
+#include <QEventLoop>
+#include <QDateTime>
+#include <QFile>
+#include <QScopedPointer>
+#include <QThread>
+#include <QTimer>
+
+// Local includes
+
+#include "ntptimestamp.h"
+#include "processbench.h"
+#include "processinput.h"
+#include "processlinereader.h"
+#include "processlinestamper.h"
+#include "processoutput.h"
+#include "processpipeline.h"
+#include "processpool.h"
+#include "processscheduling.h"
+
+#ifdef Q_OS_LINUX
+#   include "processlauncher.h"
+#endif
+
+using namespace QtSampleCodes;
+
+/**
+ * Write one CSV line by job, with the resources it used.
+ */
+bool writeRecords(const QString& path, const QVector<ProcessResult>& results)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Cannot write records file" << path;
+
+        return false;
+    }
+
+    file.write("id,program,exit_code,timed_out,cancelled,elapsed_ms,output_bytes,output_lost," + ProcessUsage::csvHeader() + '\n');
+
+    for (int id = 0 ; id < results.size() ; ++id)
+    {
+        const ProcessResult& result = results.at(id);
+
+        file.write(QByteArray::number(id)                                   + ',' +
+                   result.job.program.toLocal8Bit()                         + ',' +
+                   QByteArray::number(result.exitCode)                      + ',' +
+                   QByteArray::number(result.timedOut ? 1 : 0)              + ',' +
+                   QByteArray::number(result.cancelled ? 1 : 0)             + ',' +
+                   QByteArray::number(result.elapsed)                       + ',' +
+                   QByteArray::number(result.output->size())                + ',' +
+                   QByteArray::number(result.outputError.isEmpty() ? 0 : 1) + ',' +
+                   result.usage.toCsv()                                     + '\n');
+    }
+
+    return true;
+}
+
+/**
+ * Run each line of the file as a command, with jobs children at a time. The children are spawned
+ * by launcher if not nullptr.
+ */
+int runBatch(const QString& path, int jobs, qint64 timeout, const QString& records, const ProcessScheduling& scheduling,
+             ProcessLauncher* const launcher)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qWarning() << "Cannot open commands file" << path;
+
+        return -1;
+    }
+
+    ProcessPool pool;
+    pool.setTimeout(timeout);
+    pool.setScheduling(scheduling);
+    pool.setLauncher(launcher);
+
+    if (jobs > 0)
+    {
+        pool.setMaxJobs(jobs);
+    }
+
+    while (!file.atEnd())
+    {
+        const QStringList command = QString::fromLocal8Bit(file.readLine()).simplified().split(QLatin1Char(' '), QString::SkipEmptyParts);
+
+        if (!command.isEmpty())
+        {
+            pool.addJob(ProcessJob(command.first(), command.mid(1)));
+        }
+    }
+
+    qInfo() << "=== Starting" << pool.pendingCount() << "processes," << pool.maxJobs() << "at a time";
+
+    QObject::connect(&pool, &ProcessPool::signalJobFinished,
+                     [&pool](int id)
+        {
+            const ProcessResult result = pool.result(id);
+            QString             storage;
+
+            if      (!result.outputError.isEmpty())
+            {
+                storage = QLatin1String(" (lost: ") + result.outputError + QLatin1String(")");
+            }
+            else if (result.output->isSpilled())
+            {
+                storage = QLatin1String(" (spilled to disk)");
+            }
+
+            qInfo().noquote() << QString::fromLatin1("> [%1] exit code: %2, timed-out: %3, elapsed time (ms): %4, output bytes: %5%6 :")
+                                 .arg(id).arg(result.exitCode).arg(result.timedOut).arg(result.elapsed).arg(result.output->size())
+                                 .arg(storage)
+                              << result.job.program << result.job.arguments.join(QLatin1Char(' '));
+            qInfo().noquote() << "     " << result.usage.summary();
+        }
+    );
+
+    QObject::connect(&pool, SIGNAL(signalFinished()),
+                     qApp, SLOT(quit()));
+
+    QElapsedTimer etimer;
+    etimer.start();
+
+    pool.start();
+
+    if (pool.isRunning())
+    {
+        qApp->exec();
+    }
+
+    int failed = 0;
+
+    foreach (const ProcessResult& result, pool.results())
+    {
+        failed += ((result.exitCode != 0) || (result.exitStatus != QProcess::NormalExit) || result.timedOut || result.cancelled ||
+                   !result.outputError.isEmpty()) ? 1 : 0;
+    }
+
+    qInfo() << "=== Batch execution is complete!";
+    qInfo() << "> Processes failed         :" << failed << "of" << pool.results().size();
+    qInfo() << "> Batch elasped time (ms)  :" << etimer.elapsed();
+
+    if (!records.isEmpty())
+    {
+        writeRecords(records, pool.results());
+    }
+
+    return ((failed == 0) ? 0 : -1);
+}
+
+QString formatStats(const ProcessBenchStats& stats)
+{
+    if (stats.count == 0)
+    {
+        return QLatin1String("-");
+    }
+
+    return QString::fromLatin1("%1/%2/%3/%4").arg(stats.min / 1000).arg(stats.p50 / 1000).arg(stats.p99 / 1000).arg(stats.max / 1000);
+}
+
+/**
+ * Launch the command runs times, sequentially then parallel at a time, and print percentiles of
+ * the launch times. With compare, all the available launch methods are measured.
+ */
+int runBench(const QStringList& args, int runs, int parallel, bool compare, ProcessLauncher* const launcher)
+{
+    ProcessBench bench(args.value(0), args.mid(1));
+    bench.setLauncher(launcher);
+
+    qInfo() << "=== Benchmark of" << args.join(QLatin1Char(' ')) << ":" << runs << "runs, sequential and" << parallel << "in parallel";
+    qInfo().noquote() << QString::fromLatin1("%1 %2 %3 %4 %5")
+                         .arg(QLatin1String("method"),                             -16)
+                         .arg(QLatin1String("parallel"),                            8)
+                         .arg(QLatin1String("started min/p50/p99/max (us)"),      -30)
+                         .arg(QLatin1String("first byte min/p50/p99/max (us)"),   -33)
+                         .arg(QLatin1String("total min/p50/p99/max (us)"));
+
+    int failed = 0;
+
+    for (int method = 0 ; method < ProcessBench::MethodCount ; ++method)
+    {
+        if ((!compare && (method != ProcessBench::QProcessSeparate)) || !bench.isAvailable(ProcessBench::Method(method)))
+        {
+            continue;
+        }
+
+        QList<int> modes;
+        modes << 1;
+
+        if (parallel > 1)
+        {
+            modes << parallel;
+        }
+
+        foreach (int mode, modes)
+        {
+            const QVector<ProcessBenchSample> samples = bench.run(ProcessBench::Method(method), runs, mode);
+            const ProcessBenchStats           total   = ProcessBench::stats(samples, &ProcessBenchSample::totalNs);
+
+            failed += samples.size() - total.count;
+
+            qInfo().noquote() << QString::fromLatin1("%1 %2 %3 %4 %5")
+                                 .arg(ProcessBench::methodName(ProcessBench::Method(method)),                          -16)
+                                 .arg(mode,                                                                              8)
+                                 .arg(formatStats(ProcessBench::stats(samples, &ProcessBenchSample::startedNs)),       -30)
+                                 .arg(formatStats(ProcessBench::stats(samples, &ProcessBenchSample::firstByteNs)),     -33)
+                                 .arg(formatStats(total));
+        }
+    }
+
+    qInfo() << "> Runs failed              :" << failed;
+
+    return ((failed == 0) ? 0 : -1);
+}
+
+/**
+ * Run the command with stdout and stderr read separately, and print their lines in time order
+ * at the end, tagged with network time and offset from the process start.
+ */
+int runTimestamps(const QStringList& args, qint64 timeout)
+{
+    // Synchronization starts now, in background: the first lines may be tagged with system time.
+
+    NTPTimeStamp::instance();
+
+    QProcess* const proc = new QProcess(qApp);
+
+#ifdef Q_OS_WIN
+
+    proc->setProgram(QLatin1String("cmd"));
+    proc->setArguments(QStringList() << QLatin1String("/c") << args);
+
+#else   // Linux
+
+    proc->setProgram(args.value(0));
+    proc->setArguments(args.mid(1));
+
+#endif
+
+    qInfo() << "=== Starting process with timestamps:" << proc->program() << proc->arguments();
+
+    proc->setProcessChannelMode(QProcess::SeparateChannels);
+
+    ProcessLineStamper stamper;
+
+    QObject::connect(proc, &QProcess::readyReadStandardOutput,
+                     [proc, &stamper]()
+        {
+            stamper.readFrom(proc, QProcess::StandardOutput);
+        }
+    );
+
+    QObject::connect(proc, &QProcess::readyReadStandardError,
+                     [proc, &stamper]()
+        {
+            stamper.readFrom(proc, QProcess::StandardError);
+        }
+    );
+
+    QElapsedTimer etimer;
+    etimer.start();
+
+    stamper.start();
+    proc->start();
+
+    if (!proc->waitForStarted())
+    {
+        qWarning() << "=== Process execution failed!";
+        return (-1);
+    }
+
+    // The event loop runs the Ntp exchanges while the process runs.
+
+    bool timedOut = false;
+
+    QTimer::singleShot(int(timeout), proc,
+                       [proc, &timedOut]()
+        {
+            timedOut = true;
+            proc->kill();
+        }
+    );
+
+    QObject::connect(proc, SIGNAL(finished(int,QProcess::ExitStatus)),
+                     qApp, SLOT(quit()));
+
+    qApp->exec();
+
+    stamper.readFrom(proc, QProcess::StandardOutput);
+    stamper.readFrom(proc, QProcess::StandardError);
+    stamper.flush();
+
+    foreach (const ProcessLine& line, stamper.merged())
+    {
+        const QDateTime time = QDateTime::fromMSecsSinceEpoch(line.networkNs / 1000000);
+
+        qDebug().noquote() << QString::fromLatin1("%1%2 +%3 ms %4|")
+                              .arg(time.toString(QLatin1String("hh:mm:ss.zzz")))
+                              .arg(int((line.networkNs / 1000) % 1000), 3, 10, QLatin1Char('0'))
+                              .arg(line.offsetNs / 1000000.0, 0, 'f', 3)
+                              .arg((line.channel == QProcess::StandardOutput) ? QLatin1String("out") : QLatin1String("err"))
+                           << QString::fromLocal8Bit(stamper.text(line));
+    }
+
+    qInfo() << "=== Process execution is complete!";
+    qInfo() << "> Process timed-out        :" << timedOut;
+    qInfo() << "> Process exit code        :" << proc->exitCode();
+    qInfo() << "> Process elasped time (ms):" << etimer.elapsed();
+    qInfo() << "> Process stdout lines     :" << stamper.lines(QProcess::StandardOutput).size();
+    qInfo() << "> Process stderr lines     :" << stamper.lines(QProcess::StandardError).size();
+    qInfo() << "> Network time synchronized:" << stamper.isSynchronized();
+
+    return (0);
+}
+
+/**
+ * Run commands separated by "|" arguments as a pipeline. A stage followed by "|+" instead of "|",
+ * or by a final "|+", is teed: the last teeSize bytes of its output are kept and printed.
+ */
+int runPipeline(const QStringList& args, qint64 timeout, int teeSize)
+{
+    ProcessPipeline pipeline;
+    QStringList     command;
+
+    for (int i = 0 ; i <= args.size() ; ++i)
+    {
+        const QString arg = args.value(i, QLatin1String("|"));
+
+        if ((arg != QLatin1String("|")) && (arg != QLatin1String("|+")))
+        {
+            command << arg;
+            continue;
+        }
+
+        if (!command.isEmpty())
+        {
+            pipeline.addStage(command.first(), command.mid(1), (arg == QLatin1String("|+")) ? teeSize : 0);
+            qInfo() << "=== Pipeline stage:" << command;
+        }
+
+        command.clear();
+    }
+
+    ProcessLineReader reader(
+        [](const char* data, int size)
+        {
+            if (size > 0)
+            {
+                qDebug().noquote() << QString::fromLocal8Bit(data, size);
+            }
+        }
+    );
+
+    QObject::connect(&pipeline, &ProcessPipeline::signalOutput,
+                     [&reader](const QByteArray& data)
+        {
+            reader.feed(data.constData(), data.size());
+        }
+    );
+
+    QElapsedTimer etimer;
+    etimer.start();
+
+    if (!pipeline.start())
+    {
+        qWarning() << "=== Pipeline execution failed!";
+        return (-1);
+    }
+
+    pipeline.process(0)->closeWriteChannel();
+
+    bool timedOut = false;
+
+    QTimer::singleShot(int(timeout), &pipeline,
+                       [&pipeline, &timedOut]()
+        {
+            timedOut = true;
+            pipeline.kill();
+        }
+    );
+
+    QObject::connect(&pipeline, SIGNAL(signalFinished()),
+                     qApp, SLOT(quit()));
+
+    if (!pipeline.isFinished())
+    {
+        qApp->exec();
+    }
+
+    reader.flush();
+
+    qInfo() << "=== Pipeline execution is complete!";
+    qInfo() << "> Pipeline timed-out        :" << timedOut;
+    qInfo() << "> Pipeline elasped time (ms):" << etimer.elapsed();
+    qInfo() << "> Pipeline output lines     :" << reader.lineCount();
+
+    for (int i = 0 ; i < pipeline.stageCount() ; ++i)
+    {
+        const ProcessPipelineStage stage = pipeline.stage(i);
+
+        qInfo().noquote() << QString::fromLatin1("> Stage %1 %2: exit code %3%4, started at %5 ms, finished at %6 ms")
+                             .arg(i)
+                             .arg(stage.program)
+                             .arg(stage.exitCode)
+                             .arg((stage.exitStatus == QProcess::CrashExit) ? QLatin1String(" (crashed)") : QLatin1String(""))
+                             .arg(stage.startedNs  / 1000000.0, 0, 'f', 3)
+                             .arg(stage.finishedNs / 1000000.0, 0, 'f', 3);
+
+        if (stage.teeSize > 0)
+        {
+            const QByteArray tail = pipeline.tee(i);
+
+            qInfo() << "  Tee bytes total / kept   :" << pipeline.teeTotalBytes(i) << "/" << tail.size();
+            qDebug().noquote() << QString::fromLocal8Bit(tail);
+        }
+    }
+
+    return (0);
+}
+
+#ifdef Q_OS_LINUX
+
+/**
+ * Run the command from the launcher helper, with the same output handling as QProcess below.
+ */
+int runLauncher(ProcessLauncher* const launcher, const QStringList& args, qint64 timeout)
+{
+    LauncherProcess* const proc = new LauncherProcess(launcher, qApp);
+    proc->setProgram(args.value(0));
+    proc->setArguments(args.mid(1));
+    proc->setProcessChannelMode(QProcess::MergedChannels);
+
+    qInfo() << "=== Starting process from launcher:" << proc->program() << proc->arguments();
+
+    ProcessLineReader reader(
+        [](const char* data, int size)
+        {
+            if (size > 0)
+            {
+                qDebug().noquote() << QString::fromLocal8Bit(data, size);
+            }
+        }
+    );
+
+    QObject::connect(proc, &LauncherProcess::readyReadStandardOutput,
+                     [proc, &reader]()
+        {
+            const QByteArray data = proc->readAllStandardOutput();
+            reader.feed(data.constData(), data.size());
+        }
+    );
+
+    QElapsedTimer etimer;
+    etimer.start();
+
+    proc->start();
+
+    if (proc->state() != QProcess::Running)
+    {
+        qWarning() << "=== Process execution failed!" << proc->errorString();
+        return (-1);
+    }
+
+    bool timedOut = !proc->waitForFinished(int(timeout));
+
+    if (timedOut)
+    {
+        proc->kill();
+        proc->waitForFinished(-1);
+    }
+
+    reader.flush();
+
+    qInfo() << "=== Process execution is complete!";
+    qInfo() << "> Process timed-out        :" << timedOut;
+    qInfo() << "> Process exit code        :" << proc->exitCode();
+    qInfo() << "> Process elasped time (ms):" << etimer.elapsed();
+    qInfo() << "> Process output lines     :" << reader.lineCount();
+    qInfo().noquote() << "> Process usage            :" << proc->usage().summary();
+
+    return (0);
+}
+
+#endif
 
 int main(int argc, char** argv)
 {
     if (argc <= 1)
     {
         qDebug() << "Pass process name and arguments on CLI...";
+        qDebug() << "Options before the command: --timeout <ms>, --batch <file> [--jobs <count>] [--records <csv file>] to run each line of file,";
+        qDebug() << "--launcher to start the process, or the batch jobs, from a helper forked at startup (Linux), not with the options";
+        qDebug() << "of the output and input below, and a scheduled process is still started with QProcess,";
+        qDebug() << "--timestamps to tag stdout and stderr lines with network time,";
+        qDebug() << "--bench <runs> [--parallel <count>] [--compare] to measure launch latency, of all launch methods with --compare,";
+        qDebug() << "--cpus <list> --policy <other|batch|idle|fifo|rr>[:priority] --nice <value> --ioprio <realtime|besteffort|idle>[:level]";
+        qDebug() << "to schedule the processes (Linux).";
+        qDebug() << "--stdin <file>[:offset[:length]] or --stdin-bytes <count> to stream a file range or generated lines to the process input,";
+        qDebug() << "--pipeline [--tee <bytes>] to run commands separated by \"|\" arguments, \"|+\" keeping the output of the stage before,";
+        qDebug() << "--sink <stderr|ring[:bytes]|file:path|zfile:path> (repeatable) [--overflow <block|drop-oldest|drop>] to write the output from a thread.";
 
         return -1;
     }
 
+#ifdef Q_OS_LINUX
+
+    // The helper is forked first, while this process is small and has a single thread.
+
+    ProcessLauncher launcher;
+
+    for (int i = 1 ; (i < argc) && (qstrncmp(argv[i], "--", 2) == 0) && (qstrcmp(argv[i], "--") != 0) ; ++i)
+    {
+        if      (qstrcmp(argv[i], "--launcher") == 0)
+        {
+            launcher.start();
+            break;
+        }
+        else if ((qstrcmp(argv[i], "--batch") == 0) || (qstrcmp(argv[i], "--jobs") == 0) ||
+                 (qstrcmp(argv[i], "--timeout") == 0) || (qstrcmp(argv[i], "--records") == 0) ||
+                 (qstrcmp(argv[i], "--bench") == 0)   || (qstrcmp(argv[i], "--parallel") == 0) ||
+                 (qstrcmp(argv[i], "--cpus") == 0)    || (qstrcmp(argv[i], "--policy") == 0)   ||
+                 (qstrcmp(argv[i], "--nice") == 0)    || (qstrcmp(argv[i], "--ioprio") == 0)   ||
+                 (qstrcmp(argv[i], "--stdin") == 0)   || (qstrcmp(argv[i], "--stdin-bytes") == 0) ||
+                 (qstrcmp(argv[i], "--tee") == 0)     || (qstrcmp(argv[i], "--sink") == 0)     ||
+                 (qstrcmp(argv[i], "--overflow") == 0))
+        {
+            ++i;    // Option value.
+        }
+    }
+
+#endif
+
     QCoreApplication app(argc, argv);
-    QStringList args     = app.arguments().mid(1);
+    QStringList                         args       = app.arguments().mid(1);
+    QString                             batch;
+    QString                             records;
+    int                                 jobs       = 0;
+    qint64                              timeout    = 30000;
+    bool                                timestamps = false;
+    int                                 benchRuns  = 0;
+    int                                 parallel   = QThread::idealThreadCount();
+    bool                                compare    = false;
+    QString                             stdinFile;
+    qint64                              stdinBytes = -1;
+    bool                                pipeline   = false;
+    int                                 teeSize    = PROCESS_RING_SIZE;
+    QStringList                         sinks;
+    ProcessOutputWriter::OverflowPolicy overflow   = ProcessOutputWriter::CountAndDrop;
+    bool                                overflowed = false;
+    ProcessScheduling                   scheduling;
+
+    // Options end at the first argument which is not one of them, or at "--".
+
+    while (!args.isEmpty() && args.first().startsWith(QLatin1String("--")))
+    {
+        const QString option = args.takeFirst();
+
+        if      (option == QLatin1String("--"))
+        {
+            break;
+        }
+        else if ((option == QLatin1String("--batch")) && !args.isEmpty())
+        {
+            batch   = args.takeFirst();
+        }
+        else if ((option == QLatin1String("--records")) && !args.isEmpty())
+        {
+            records = args.takeFirst();
+        }
+        else if ((option == QLatin1String("--jobs")) && !args.isEmpty())
+        {
+            jobs    = args.takeFirst().toInt();
+        }
+        else if ((option == QLatin1String("--timeout")) && !args.isEmpty())
+        {
+            timeout = args.takeFirst().toLongLong();
+        }
+        else if ((option == QLatin1String("--bench")) && !args.isEmpty())
+        {
+            benchRuns = args.takeFirst().toInt();
+        }
+        else if ((option == QLatin1String("--parallel")) && !args.isEmpty())
+        {
+            parallel  = args.takeFirst().toInt();
+        }
+        else if (option == QLatin1String("--compare"))
+        {
+            compare = true;
+        }
+        else if ((option == QLatin1String("--cpus")) && !args.isEmpty())
+        {
+            if (!scheduling.setCpus(args.takeFirst()))
+            {
+                qWarning() << "Invalid cpu list for" << option;
+
+                return -1;
+            }
+        }
+        else if ((option == QLatin1String("--policy")) && !args.isEmpty())
+        {
+            if (!scheduling.setPolicy(args.takeFirst()))
+            {
+                qWarning() << "Invalid policy or priority (1 to 99, for fifo and rr only) for" << option;
+
+                return -1;
+            }
+        }
+        else if ((option == QLatin1String("--nice")) && !args.isEmpty())
+        {
+            if (!scheduling.setNice(args.takeFirst()))
+            {
+                qWarning() << "Invalid nice value (-20 to 19) for" << option;
+
+                return -1;
+            }
+        }
+        else if ((option == QLatin1String("--ioprio")) && !args.isEmpty())
+        {
+            if (!scheduling.setIoPriority(args.takeFirst()))
+            {
+                qWarning() << "Invalid I/O class or level (0 to 7, not for idle) for" << option;
+
+                return -1;
+            }
+        }
+        else if ((option == QLatin1String("--stdin")) && !args.isEmpty())
+        {
+            stdinFile  = args.takeFirst();
+        }
+        else if ((option == QLatin1String("--stdin-bytes")) && !args.isEmpty())
+        {
+            stdinBytes = args.takeFirst().toLongLong();
+        }
+        else if (option == QLatin1String("--pipeline"))
+        {
+            pipeline = true;
+        }
+        else if ((option == QLatin1String("--tee")) && !args.isEmpty())
+        {
+            teeSize  = args.takeFirst().toInt();
+        }
+        else if ((option == QLatin1String("--sink")) && !args.isEmpty())
+        {
+            sinks << args.takeFirst();
+        }
+        else if ((option == QLatin1String("--overflow")) && !args.isEmpty())
+        {
+            overflow   = ProcessOutputWriter::overflowPolicyFromName(args.takeFirst(), &overflowed);
+
+            if (!overflowed)
+            {
+                qWarning() << "Invalid overflow policy (block, drop-oldest or drop) for" << option;
+
+                return -1;
+            }
+        }
+        else if (option == QLatin1String("--timestamps"))
+        {
+            timestamps = true;
+        }
+        else if (option == QLatin1String("--launcher"))
+        {
+            // Started before the application.
+        }
+        else
+        {
+            qWarning() << "Unknown option" << option;
+
+            return -1;
+        }
+    }
+
+    if (!batch.isEmpty())
+    {
+
+#ifdef Q_OS_LINUX
+        return runBatch(batch, jobs, timeout, records, scheduling, launcher.isRunning() ? &launcher : nullptr);
+#else
+        return runBatch(batch, jobs, timeout, records, scheduling, nullptr);
+#endif
+
+    }
+
+    if (benchRuns > 0)
+    {
+
+#ifdef Q_OS_LINUX
+        return runBench(args, benchRuns, parallel, compare, &launcher);
+#else
+        return runBench(args, benchRuns, parallel, compare, nullptr);
+#endif
+
+    }
+
+#ifdef Q_OS_LINUX
+
+    if (launcher.isRunning())
+    {
+        // The launcher only runs the command and reads its output: the other modes need QProcess.
+
+        if (pipeline || timestamps || !stdinFile.isEmpty() || (stdinBytes >= 0) || !sinks.isEmpty() || overflowed)
+        {
+            qWarning() << "--launcher cannot be used with --pipeline, --timestamps, --stdin, --stdin-bytes, --sink or --overflow";
+
+            return -1;
+        }
+
+        // As in ProcessPool, a command with a scheduling is still started with QProcess.
+
+        if (scheduling.isDefault())
+        {
+            return runLauncher(&launcher, args, timeout);
+        }
+    }
+
+#endif
+
+    if (pipeline)
+    {
+        return runPipeline(args, timeout, teeSize);
+    }
+
+    if (timestamps)
+    {
+        return runTimestamps(args, timeout);
+    }
 
     // ---
 
-    QProcess* const proc = new QProcess(qApp);
+    ScheduledProcess* const proc = new ScheduledProcess(qApp);
+    proc->setScheduling(scheduling);
 
 #ifdef Q_OS_WIN
 
@@ -61,27 +779,121 @@ int main(int argc, char** argv)
 
     proc->setProcessChannelMode(QProcess::MergedChannels);
 
-    QObject::connect(proc, &QProcess::readyRead,
-                     [proc]()
+    // Lines are split in place in the reader buffer, a line cut between two reads is kept for the next one.
+
+    ProcessLineReader reader(
+        [](const char* data, int size)
+        {
+            if (size > 0)
+            {
+                qDebug().noquote() << QString::fromLocal8Bit(data, size);
+            }
+        }
+    );
+
+    // With sinks, the output is only handed to the writer thread here: a slow sink never delays reading.
+
+    QScopedPointer<ProcessOutputWriter> writer;
+    ProcessRingSink*                    ring = nullptr;
+
+    if (!sinks.isEmpty())
+    {
+        writer.reset(new ProcessOutputWriter(overflow));
+
+        foreach (const QString& sink, sinks)
         {
-            QByteArray data = proc->readAll();
+            const QString type  = sink.section(QLatin1Char(':'), 0, 0);
+            const QString value = sink.section(QLatin1Char(':'), 1);
 
-            if (!data.isEmpty())
+            if      (type == QLatin1String("stderr"))
             {
-                QString str       = QString::fromLocal8Bit(data.data(), data.size());
-                QStringList lines = str.split(QLatin1Char('\n'));
+                writer->addSink(new ProcessStderrSink);
+            }
+            else if (type == QLatin1String("ring"))
+            {
+                ring = new ProcessRingSink(value.isEmpty() ? PROCESS_RING_SIZE : value.toInt());
+                writer->addSink(ring);
+            }
+            else if ((type == QLatin1String("file")) || (type == QLatin1String("zfile")))
+            {
+                ProcessFileSink* const file = new ProcessFileSink(value, (type == QLatin1String("zfile")));
 
-                foreach (const QString& str, lines)
+                if (!file->open())
                 {
-                    if (!str.isEmpty())
-                    {
-                        qDebug().noquote() << str;
-                    }
+                    qWarning() << "Cannot write output file" << value << file->errorString();
+                    delete file;
+
+                    return -1;
                 }
+
+                writer->addSink(file);
+            }
+            else
+            {
+                qWarning() << "Unknown sink" << sink;
+
+                return -1;
+            }
+        }
+
+        writer->start();
+    }
+
+    QObject::connect(proc, &QProcess::readyRead,
+                     [proc, &reader, &writer]()
+        {
+            if (writer)
+            {
+                writer->readFrom(proc);
+            }
+            else
+            {
+                reader.readFrom(proc);
             }
         }
     );
 
+    // Input is written as the process reads it: the file path is "path[:offset[:length]]".
+
+    ProcessInput* input     = nullptr;
+    qint64        generated = 0;
+
+    if (!stdinFile.isEmpty())
+    {
+        const QStringList value = stdinFile.split(QLatin1Char(':'));
+        input                   = new ProcessInput(proc);
+
+        if (!input->setFile(value.first(), value.value(1, QLatin1String("0")).toLongLong(),
+                                           value.value(2, QLatin1String("-1")).toLongLong()))
+        {
+            qWarning() << "Cannot open input file" << value.first() << input->errorString();
+
+            return -1;
+        }
+    }
+    else if (stdinBytes >= 0)
+    {
+        input = new ProcessInput(proc);
+
+        input->setGenerator(
+            [&generated, stdinBytes](char* data, qint64 maxSize) -> qint64
+            {
+                static const char pattern[] = "The quick brown fox jumps over the lazy dog.\n";
+                const qint64      length    = qint64(sizeof(pattern) - 1);
+                const qint64      size      = qMin(maxSize, stdinBytes - generated);
+
+                for (qint64 i = 0 ; i < size ; ++i)
+                {
+                    data[i] = pattern[(generated + i) % length];
+                }
+
+                generated += size;
+
+                return size;
+            }
+        );
+    }
+
     QElapsedTimer etimer;
     etimer.start();
 
@@ -89,13 +901,67 @@ int main(int argc, char** argv)
 
     if (proc->waitForStarted())
     {
-        bool timedOut = !proc->waitForFinished(30000);
-        int  exitCode = proc->exitCode();
+        // An event loop rather than waitForFinished(): the input is written from it.
+
+        QEventLoop loop;
+        bool       timedOut = false;
+
+        QObject::connect(proc, SIGNAL(finished(int,QProcess::ExitStatus)),
+                         &loop, SLOT(quit()));
+
+        QTimer::singleShot(int(timeout), &loop,
+            [proc, &timedOut]()
+            {
+                timedOut = true;
+                proc->kill();
+            }
+        );
+
+        if (proc->state() != QProcess::NotRunning)
+        {
+            loop.exec();
+        }
+
+        int exitCode = proc->exitCode();
+
+        if (writer)
+        {
+            writer->readFrom(proc);
+            writer->stop();
+        }
+        else
+        {
+            reader.readFrom(proc);
+            reader.flush();
+        }
 
         qInfo() << "=== Process execution is complete!";
         qInfo() << "> Process timed-out        :" << timedOut;
         qInfo() << "> Process exit code        :" << exitCode;
         qInfo() << "> Process elasped time (ms):" << etimer.elapsed();
+
+        // With sinks, the output goes to the writer only: the reader splits no lines.
+
+        if (!writer)
+        {
+            qInfo() << "> Process output lines     :" << reader.lineCount();
+        }
+
+        if (input)
+        {
+            qInfo() << "> Process input bytes      :" << input->bytesSent() << input->errorString();
+        }
+
+        if (writer)
+        {
+            qInfo() << "> Output written bytes     :" << writer->writtenBytes();
+            qInfo() << "> Output dropped chunks    :" << writer->droppedChunks() << "," << writer->droppedBytes() << "bytes";
+        }
+
+        if (ring)
+        {
+            qInfo() << "> Output ring bytes        :" << ring->toByteArray().size() << "of" << ring->totalBytes();
+        }
     }
     else
     {